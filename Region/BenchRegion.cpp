@@ -0,0 +1,565 @@
+//Microbenchmarks for Region operations.  Prints the time and the number of heap allocations per operation for each workload.
+//Usage: BenchRegion [milliseconds per benchmark] [name filter]
+#include "Region.h"
+#include "RegionOpCache.h"
+#include "RegionSimd.h"
+#include "RegionThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Number of calls to operator new since the program started.  Counted relaxed, since the thread pool allocates too.
+static std::atomic<size_t> allocationCount(0);
+
+//Every form of operator new is replaced, so all allocations are counted and every delete matches its new.
+static void* CountedAllocate(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size != 0 ? size : 1);
+}
+void* operator new(size_t size)
+{
+	void* p = CountedAllocate(size);
+	if (p == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size);
+}
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size);
+}
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+#endif
+#ifdef __cpp_aligned_new
+static void* CountedAllocateAligned(size_t size, std::align_val_t alignment)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	size = size != 0 ? size : 1;
+#ifdef _WIN32
+	return _aligned_malloc(size, (size_t)alignment);
+#else
+	//posix_memalign needs at least pointer alignment
+	size_t minimumAlignment = (size_t)alignment > sizeof(void*) ? (size_t)alignment : sizeof(void*);
+	void* p = NULL;
+	return posix_memalign(&p, minimumAlignment, size) == 0 ? p : NULL;
+#endif
+}
+static void FreeAligned(void* p)
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* p = CountedAllocateAligned(size, alignment);
+	if (p == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return CountedAllocateAligned(size, alignment);
+}
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return CountedAllocateAligned(size, alignment);
+}
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	FreeAligned(p);
+}
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	FreeAligned(p);
+}
+void operator delete[](void* p, size_t, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+#endif
+
+//Results are written here so the compiler can't optimize the work away
+static volatile size_t sink;
+
+//Milliseconds each benchmark runs for
+static int minimumTime = 200;
+//Only benchmarks whose name contains this string are run
+static const char* nameFilter = NULL;
+
+//Runs body repeatedly for at least minimumTime milliseconds, then prints ns/op and allocs/op
+template <class Body>
+static void Run(const char* name, Body body)
+{
+	if (nameFilter != NULL && strstr(name, nameFilter) == NULL)
+	{
+		return;
+	}
+	typedef std::chrono::steady_clock Clock;
+	//Warm up, and find out roughly how long one call takes
+	body();
+	size_t iterations = 1;
+	double elapsed = 0;
+	size_t allocations = 0;
+	while (true)
+	{
+		size_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+		Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < iterations; i++)
+		{
+			body();
+		}
+		elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+		allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+		if (elapsed >= minimumTime * 1e6)
+		{
+			break;
+		}
+		//Aim for the minimum time on the next try
+		double scale = elapsed > 0 ? (minimumTime * 1e6 * 1.2) / elapsed : 100;
+		iterations = (size_t)(iterations * (scale < 100 ? (scale > 2 ? scale : 2) : 100));
+	}
+	printf("%-48s %14.1f %12.2f\n", name, elapsed / iterations, (double)allocations / iterations);
+}
+
+//Small deterministic random number generator, so every run uses the same workloads
+static unsigned int randomState = 12345;
+static int Random(int limit)
+{
+	randomState = randomState * 1103515245 + 12345;
+	return (int)((randomState >> 8) % (unsigned int)limit);
+}
+
+static RECT MakeRect(int x, int y, int w, int h)
+{
+	RECT rect = { x, y, x + w, y + h };
+	return rect;
+}
+
+//An L shaped region at (x, y)
+static Region MakeLShape(int x, int y)
+{
+	return Region(MakeRect(x, y, 200, 40), MakeRect(x, y + 40, 40, 160));
+}
+
+//Small dirty rectangles scattered over a 1920x1080 screen
+static void MakeDirtyRects(RECT* pRects, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		pRects[i] = MakeRect(Random(1900), Random(1060), 4 + Random(16), 4 + Random(16));
+	}
+}
+
+//A fragmented mask: rows of randomly placed runs, like a region built from an alpha mask
+static Region MakeFragmentedMask(int width, int height)
+{
+	vector<RECT> runs;
+	for (int y = 0; y < height; y += 2)
+	{
+		int x = Random(8);
+		while (x < width)
+		{
+			int w = 1 + Random(12);
+			runs.push_back(MakeRect(x, y, w, 2));
+			x += w + 1 + Random(12);
+		}
+	}
+	return Region(runs.data(), runs.size());
+}
+
+//A grid of cells with one pixel gaps between them
+static Region MakeGrid(int x, int y, int columns, int rows, int cellSize)
+{
+	vector<RECT> cells;
+	for (int row = 0; row < rows; row++)
+	{
+		for (int column = 0; column < columns; column++)
+		{
+			cells.push_back(MakeRect(x + column * (cellSize + 1), y + row * (cellSize + 1), cellSize, cellSize));
+		}
+	}
+	return Region(cells.data(), cells.size());
+}
+
+//An 8bpp alpha mask of an ellipse with a pattern of holes in it, like the shape of a window
+static vector<byte> MakeAlphaMask(int width, int height)
+{
+	vector<byte> alpha(width * height);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			double dx = (x - width / 2) / (width / 2.0);
+			double dy = (y - height / 2) / (height / 2.0);
+			bool hole = (x / 16 + y / 16) % 5 == 0 && x % 16 < 8;
+			alpha[y * width + x] = dx * dx + dy * dy < 1.0 && !hole ? 255 : 0;
+		}
+	}
+	return alpha;
+}
+
+//The same mask as 1bpp
+static vector<byte> MakeBitMask(const vector<byte>& alpha, int width, int height, int stride)
+{
+	vector<byte> bits(stride * height);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			if (alpha[y * width + x] != 0)
+			{
+				bits[y * stride + x / 8] |= 0x80 >> (x % 8);
+			}
+		}
+	}
+	return bits;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1)
+	{
+		minimumTime = atoi(argv[1]);
+	}
+	if (argc > 2)
+	{
+		nameFilter = argv[2];
+	}
+
+	//Workloads are built before timing starts
+	RECT rect1 = MakeRect(10, 10, 300, 200);
+	RECT rect2 = MakeRect(100, 50, 300, 200);
+	RECT rect3 = MakeRect(0, 0, 250, 150);
+	RECT rect4 = MakeRect(20, 20, 100, 100);
+	Region lShape1 = MakeLShape(0, 0);
+	Region lShape2 = MakeLShape(20, 20);
+	Region lShape3 = MakeLShape(0, 0);
+	const int dirtyCount = 256;
+	RECT dirtyRects[dirtyCount];
+	MakeDirtyRects(dirtyRects, dirtyCount);
+	Region dirty(dirtyRects, dirtyCount);
+	Region mask1 = MakeFragmentedMask(1024, 768);
+	Region mask2 = MakeFragmentedMask(1024, 768);
+	Region mask1Copy = mask1;
+	mask1Copy.OffsetBy(1, 0);
+	mask1Copy.OffsetBy(-1, 0);
+	RECT maskClip = MakeRect(100, 100, 600, 400);
+	Region grid1 = MakeGrid(0, 0, 100, 100, 8);
+	Region grid2 = MakeGrid(4, 4, 100, 100, 8);
+	Region grid3 = MakeGrid(0, 0, 100, 100, 8);
+	Region largeMask1 = MakeFragmentedMask(2048, 2048);
+	Region largeMask2 = MakeFragmentedMask(2048, 2048);
+	const int maskWidth = 3840;
+	const int maskHeight = 2160;
+	const int maskStride = maskWidth / 8;
+	vector<byte> alphaMask = MakeAlphaMask(maskWidth, maskHeight);
+	vector<byte> bitMask = MakeBitMask(alphaMask, maskWidth, maskHeight, maskStride);
+	//Child windows of a window tree, each with a few holes
+	const int childCount = 64;
+	Region children[childCount];
+	const Region* pChildren[childCount];
+	for (int i = 0; i < childCount; i++)
+	{
+		int x = Random(1600);
+		int y = Random(900);
+		children[i] = Region(x, y, 100 + Random(300), 100 + Random(200));
+		for (int hole = 0; hole < 8; hole++)
+		{
+			children[i].SubtractWith(x + Random(300), y + Random(200), 10 + Random(20), 10 + Random(20));
+		}
+		pChildren[i] = &children[i];
+	}
+	//Tiles side by side which don't overlap, such as the windows of a tiling window manager, each with a hole
+	const int tileCount = 256;
+	Region tiles[tileCount];
+	const Region* pTiles[tileCount];
+	for (int i = 0; i < tileCount; i++)
+	{
+		tiles[i] = Region((i % 16) * 120, (i / 16) * 70, 110, 60);
+		tiles[i].SubtractWith((i % 16) * 120 + 10 + Random(50), (i / 16) * 70 + 10 + Random(30), 20, 10);
+		pTiles[i] = &tiles[i];
+	}
+	vector<RECT> rectsOut;
+
+	printf("%-48s %14s %12s\n", "benchmark", "ns/op", "allocs/op");
+	printf("(dirty region: %d rects, fragmented masks: %d and %d rects, grids: %d rects, large masks: %d and %d rects)\n",
+		(int)dirty.GetRegionRects().size(), (int)mask1.GetRegionRects().size(), (int)mask2.GetRegionRects().size(), (int)grid1.GetRegionRects().size(),
+		(int)largeMask1.GetRegionRects().size(), (int)largeMask2.GetRegionRects().size());
+
+	//Single rectangles that stay simple regions
+	Run("single rect: union", [&]() {
+		Region region(rect1);
+		region.UnionWith(rect2);
+		sink = region.GetRegionType();
+	});
+	Run("single rect: intersect", [&]() {
+		Region region(rect1);
+		region.IntersectWith(rect2);
+		sink = region.GetRegionType();
+	});
+	Run("single rect: union becomes complex", [&]() {
+		Region region(rect1);
+		region.UnionWith(rect2);
+		region.UnionWith(rect4);
+		region.UnionWith(MakeRect(400, 400, 10, 10));
+		sink = region.GetRegionType();
+	});
+	Run("single rect: equality", [&]() {
+		sink = Region(rect1) == Region(rect3);
+	});
+
+	//Two rectangle L shapes
+	Run("L-shape: union", [&]() {
+		sink = lShape1.Union(lShape2).GetRegionType();
+	});
+	Run("L-shape: intersect", [&]() {
+		sink = lShape1.Intersect(lShape2).GetRegionType();
+	});
+	Run("L-shape: intersect rect", [&]() {
+		sink = lShape1.Intersect(rect4).GetRegionType();
+	});
+	Run("L-shape: equality", [&]() {
+		sink = lShape1 == lShape3;
+	});
+	Run("L-shape: copy", [&]() {
+		Region copy(lShape1);
+		sink = copy.GetRegionType();
+	});
+
+	//Accumulating many small dirty rectangles
+	Run("dirty rects: union one at a time (256)", [&]() {
+		Region region;
+		for (int i = 0; i < dirtyCount; i++)
+		{
+			region.UnionWith(dirtyRects[i]);
+		}
+		sink = region.GetRegionType();
+	});
+	Run("dirty rects: bulk union (256)", [&]() {
+		Region region;
+		region.UnionWith(dirtyRects, dirtyCount);
+		sink = region.GetRegionType();
+	});
+	Run("dirty rects: GetRegionRects vector", [&]() {
+		dirty.GetRegionRects(rectsOut);
+		sink = rectsOut.size();
+	});
+	Run("dirty rects: GetRegionRects view", [&]() {
+		size_t count;
+		sink = (size_t)dirty.GetRegionRects(count) + count;
+	});
+	Run("dirty rects: simplify to 16", [&]() {
+		Region region(dirty);
+		region.Simplify(16, 100);
+		sink = region.GetRegionType();
+	});
+
+	//Fragmented masks with over 10000 rectangles
+	Run("fragmented mask: union", [&]() {
+		sink = mask1.Union(mask2).GetRegionType();
+	});
+	Run("fragmented mask: intersect", [&]() {
+		sink = mask1.Intersect(mask2).GetRegionType();
+	});
+	Run("fragmented mask: intersect rect", [&]() {
+		sink = mask1.Intersect(maskClip).GetRegionType();
+	});
+	//The same, with each instruction set the clip kernel can use on this CPU
+	RegionSimdLevel defaultLevel = RegionSimd::GetLevel();
+	for (int level = REGION_SIMD_NONE; level < REGION_SIMD_LEVEL_COUNT; level++)
+	{
+		if (RegionSimd::SetLevel((RegionSimdLevel)level))
+		{
+			char name[64];
+			snprintf(name, sizeof(name), "fragmented mask: intersect rect (%s)", RegionSimd::GetLevelName((RegionSimdLevel)level));
+			Run(name, [&]() {
+				sink = mask1.Intersect(maskClip).GetRegionType();
+			});
+		}
+	}
+	RegionSimd::SetLevel(defaultLevel);
+	Run("fragmented mask: subtract", [&]() {
+		sink = mask1.Subtract(mask2).GetRegionType();
+	});
+	//The same operands every time, so after the first run it's found in the cache
+	RegionOpCache opCache(1 << 20);
+	Run("fragmented mask: subtract (op cache)", [&]() {
+		sink = opCache.Subtract(mask1, mask2).GetRegionType();
+	});
+	Run("fragmented mask: equality (equal)", [&]() {
+		sink = mask1 == mask1Copy;
+	});
+	Run("fragmented mask: contains point", [&]() {
+		sink = mask1.ContainsPoint(Random(1024), Random(768));
+	});
+	Run("fragmented mask: GetRegionRects vector", [&]() {
+		mask1.GetRegionRects(rectsOut);
+		sink = rectsOut.size();
+	});
+	Run("fragmented mask: GetRegionData view", [&]() {
+		size_t size;
+		sink = (size_t)mask1.GetRegionData(size) + size;
+	});
+	vector<byte> serialized;
+	mask1.Serialize(serialized);
+	vector<RECT> maskRects = mask1.GetRegionRects();
+	printf("(fragmented mask: %d bytes serialized, %d bytes as RGNDATA)\n", (int)serialized.size(), (int)mask1.GetRegionData().size());
+	Run("fragmented mask: serialize", [&]() {
+		mask1.Serialize(serialized);
+		sink = serialized.size();
+	});
+	Run("fragmented mask: deserialize", [&]() {
+		Region region;
+		region.Deserialize(serialized.data(), serialized.size());
+		sink = region.GetRegionType();
+	});
+	Run("fragmented mask: rebuild from rects", [&]() {
+		Region region(maskRects.data(), maskRects.size());
+		sink = region.GetRegionType();
+	});
+	Run("fragmented mask: spans of 100 scanlines", [&]() {
+		size_t total = 0;
+		for (const RegionSpan& span : mask1.GetSpans(300, 400))
+		{
+			total += span.right - span.left;
+		}
+		sink = total;
+	});
+
+	//Grids of cells
+	Run("grid: union", [&]() {
+		sink = grid1.Union(grid2).GetRegionType();
+	});
+	Run("grid: intersect", [&]() {
+		sink = grid1.Intersect(grid2).GetRegionType();
+	});
+	Run("grid: equality (equal)", [&]() {
+		sink = grid1 == grid3;
+	});
+	Run("grid: GetRegionRects vector", [&]() {
+		grid1.GetRegionRects(rectsOut);
+		sink = rectsOut.size();
+	});
+
+	//A 4K mask bitmap made into a region, with each instruction set the 8bpp conversion can use on this CPU
+	Run("4K mask: from 1bpp", [&]() {
+		sink = Region(bitMask.data(), maskWidth, maskHeight, maskStride, REGION_MASK_1BPP, 0).GetRegionType();
+	});
+	for (int level = REGION_SIMD_NONE; level < REGION_SIMD_LEVEL_COUNT; level++)
+	{
+		if (RegionSimd::SetLevel((RegionSimdLevel)level))
+		{
+			char name[64];
+			snprintf(name, sizeof(name), "4K mask: from 8bpp (%s)", RegionSimd::GetLevelName((RegionSimdLevel)level));
+			Run(name, [&]() {
+				sink = Region(alphaMask.data(), maskWidth, maskHeight, maskWidth, REGION_MASK_8BPP, 128).GetRegionType();
+			});
+		}
+	}
+	RegionSimd::SetLevel(defaultLevel);
+
+	//Union of the visible regions of child windows which overlap
+	Run("64 children: union one at a time", [&]() {
+		Region region;
+		for (int i = 0; i < childCount; i++)
+		{
+			region.UnionWith(children[i]);
+		}
+		sink = region.GetRegionType();
+	});
+	Run("64 children: UnionAll", [&]() {
+		sink = Region::UnionAll(pChildren, childCount).GetRegionType();
+	});
+
+	Run("256 tiles: union one at a time", [&]() {
+		Region region;
+		for (int i = 0; i < tileCount; i++)
+		{
+			region.UnionWith(tiles[i]);
+		}
+		sink = region.GetRegionType();
+	});
+	Run("256 tiles: UnionAll", [&]() {
+		sink = Region::UnionAll(pTiles, tileCount).GetRegionType();
+	});
+
+	//Masks large enough to be combined in stripes on several threads, with 1 thread and with every core
+	RegionThreadPool& pool = RegionThreadPool::GetShared();
+	int defaultWorkerCount = pool.GetThreadCount() - 1;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		pool.SetWorkerCount(pass == 0 ? 0 : defaultWorkerCount);
+		char name[64];
+		snprintf(name, sizeof(name), "large mask: union (%d threads)", pool.GetThreadCount());
+		Run(name, [&]() {
+			sink = largeMask1.Union(largeMask2).GetRegionType();
+		});
+		snprintf(name, sizeof(name), "large mask: subtract (%d threads)", pool.GetThreadCount());
+		Run(name, [&]() {
+			sink = largeMask1.Subtract(largeMask2).GetRegionType();
+		});
+		if (defaultWorkerCount == 0)
+		{
+			break;
+		}
+	}
+	return 0;
+}
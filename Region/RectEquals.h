@@ -1,7 +1,6 @@
 #pragma once
-struct IUnknown;
-#define NOMINMAX
-#include <Windows.h>
+#include "Region.h"
+#include <string.h>
 
 static inline bool operator==(const RECT& rect1, const RECT& rect2)
 {
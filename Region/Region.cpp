@@ -1,761 +1,3877 @@
 #include "Region.h"
+#include "RegionArena.h"
+#include "RegionSimd.h"
+#include "RegionStats.h"
+#include "RegionTrace.h"
+#if REGION_USE_THREADS
+#include "RegionThreadPool.h"
+#endif
 #include <algorithm>
+#include <atomic>
 #include <assert.h>
+#include <functional>
+#include <limits.h>
+#include <limits>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 using std::min;
 using std::max;
 
-#if REGION_USE_GLOBAL_TEMP_REGION
-#if REGION_USE_VALID_FLAG
-//Initializes fields of Region class (All constructors must call this)
-#define Region_Initialize() {boundingBox={}; regionType = NULLREGION; hrgn = NULL; hrgnValid = false;}
-#else
-//Initializes fields of Region class (All constructors must call this)
-#define Region_Initialize() {boundingBox={}; regionType = NULLREGION; hrgn = NULL; }
-#endif
-#else
-#if REGION_USE_VALID_FLAG
-//Initializes fields of Region class (All constructors must call this)
-#define Region_Initialize() {boundingBox={}; regionType = NULLREGION; hrgn = NULL; hrgnTemp = NULL; hrgnValid = false;}
-#else
-//Initializes fields of Region class (All constructors must call this)
-#define Region_Initialize() {boundingBox={}; regionType = NULLREGION; hrgn = NULL; hrgnTemp = NULL; }
-#endif
-#endif
-
+//Smallest and largest coordinates, used as sentinels by the band sweep
+static const LONG CoordinateMin = std::numeric_limits<LONG>::min();
+static const LONG CoordinateMax = std::numeric_limits<LONG>::max();
 
-#if REGION_USE_GLOBAL_TEMP_REGION
-//Note that this variable is probably not going to be used by any thread other than the main thread.
-//But just in case it is, it must be thread-local.
+//Coordinate type of a rectangle type: RECT (used by Region), or the BasicRect of a coordinate policy (used by BasicRegion).
+//The band sweep below is written for any of them, so each coordinate type gets its own compiled copy.
+template <class Rect>
+struct RectTraits;
+template <>
+struct RectTraits<RECT>
+{
+	typedef LONG Coordinate;
+};
+template <class T>
+struct RectTraits<BasicRect<T> >
+{
+	typedef T Coordinate;
+};
 
-//Thread Local storage index for the global variable (temporary region)
-DWORD _hrgnTls = TLS_OUT_OF_INDEXES;
+//Returns the rectangle at x, y with width w and height h.  Edges are worked out with 64-bit math and cut off at the largest
+//(or smallest) coordinate, so a rectangle reaching past the end of the coordinate range doesn't wrap around.
+static RECT RectFromSize(int x, int y, int w, int h)
+{
+	RECT rect;
+	rect.left = x;
+	rect.top = y;
+	rect.right = (LONG)max<int64_t>(CoordinateMin, min<int64_t>(CoordinateMax, (int64_t)x + w));
+	rect.bottom = (LONG)max<int64_t>(CoordinateMin, min<int64_t>(CoordinateMax, (int64_t)y + h));
+	return rect;
+}
 
-//Sets the Temp Region (a global variable) to a rectangle so Win32 Region API functions can be used with the rectangle
-HRGN SetTempRegion(const RECT& rect)
+//Moves a coordinate by delta, cutting it off at the ends of the coordinate range instead of wrapping around
+static inline LONG OffsetCoordinate(LONG value, int delta)
 {
-	//Use a TLS slot for the global variable
-	if (_hrgnTls == TLS_OUT_OF_INDEXES)
-	{
-		_hrgnTls = TlsAlloc();
-	}
-	HRGN hrgnTemp = (HRGN)TlsGetValue(_hrgnTls);
-	if (hrgnTemp == NULL)
-	{
-		//If temp region doesn't exist, create it
-		hrgnTemp = CreateRectRgnIndirect(&rect);
-		TlsSetValue(_hrgnTls, (LPVOID)hrgnTemp);
-	}
-	else
+	return (LONG)max<int64_t>(CoordinateMin, min<int64_t>(CoordinateMax, (int64_t)value + delta));
+}
+
+//Largest area a region reports (the whole coordinate range is about 2^64 pixels, which doesn't fit)
+static const int64_t AreaMax = std::numeric_limits<int64_t>::max();
+//Returns the area of a rectangle, or AreaMax if it's larger than that
+template <class Rect>
+static inline int64_t RectArea(const Rect& rect)
+{
+	//(the width and height of any coordinate type fit in a uint64_t, but their product may not)
+	uint64_t width = (uint64_t)rect.right - (uint64_t)rect.left;
+	uint64_t height = (uint64_t)rect.bottom - (uint64_t)rect.top;
+	if (height != 0 && width > (uint64_t)AreaMax / height)
 	{
-		//Assign the rectangle to the temp region
-		SetRectRgn(hrgnTemp, rect.left, rect.top, rect.right, rect.bottom);
+		return AreaMax;
 	}
-	return hrgnTemp;
+	return (int64_t)(width * height);
 }
 
-//Frees the temp region
-void FreeTempRegion()
+//Hash of a region without rectangles (see Region::GetHash)
+static const uint64_t HashSeed = 0xCBF29CE484222325ull;
+//Adds a rectangle to a region hash
+static inline uint64_t HashRect(uint64_t hash, const RECT& rect)
 {
-	HRGN hrgnTemp = (HRGN)TlsGetValue(_hrgnTls);
-	if (hrgnTemp != NULL)
-	{
-		DeleteObject(hrgnTemp);
-		hrgnTemp = NULL;
-		TlsSetValue(_hrgnTls, (LPVOID)hrgnTemp);
-	}
+	uint64_t topLeft = (uint32_t)rect.left | ((uint64_t)(uint32_t)rect.top << 32);
+	uint64_t bottomRight = (uint32_t)rect.right | ((uint64_t)(uint32_t)rect.bottom << 32);
+	hash = (hash ^ topLeft) * 0x9E3779B97F4A7C15ull;
+	hash = (hash ^ (hash >> 29) ^ bottomRight) * 0xBF58476D1CE4E5B9ull;
+	return hash ^ (hash >> 32);
 }
+
+//Initializes fields of Region class (All constructors must call this)
+#if REGION_USE_TRACE
+#define Region_Initialize() {boundingBox={}; regionType = NULLREGION; area = 0; bandCount = 0; hash = 0; traceId = 0; traceGeneration = 0; UpdateDataHeader(); }
+#else
+#define Region_Initialize() {boundingBox={}; regionType = NULLREGION; area = 0; bandCount = 0; hash = 0; UpdateDataHeader(); }
 #endif
 
-Region::Region()
+//Boolean operations performed by the band sweep
+enum CombineOperation
+{
+	//Area inside of either region
+	COMBINE_OR,
+	//Area inside of both regions
+	COMBINE_AND,
+	//Area inside of the first region but not the second region
+	COMBINE_DIFF,
+	//Area inside of exactly one of the regions
+	COMBINE_XOR,
+};
+
+//Returns whether a point is inside the result of the operation, given whether it is inside of each operand
+template <int operation>
+static inline bool CombineInside(bool insideA, bool insideB)
 {
-	Region_Initialize();
+	switch (operation)
+	{
+	case COMBINE_OR:
+		return insideA || insideB;
+	case COMBINE_AND:
+		return insideA && insideB;
+	case COMBINE_DIFF:
+		return insideA && !insideB;
+	case COMBINE_XOR:
+		return insideA != insideB;
+	}
+	return false;
 }
 
-Region::~Region()
+//Returns the end of the band which starts at pRect (rectangles in the same band share the same top)
+template <class Rect>
+static inline const Rect* BandEnd(const Rect* pRect, const Rect* pEnd)
 {
-	if (this->hrgn != NULL)
+	typename RectTraits<Rect>::Coordinate top = pRect->top;
+	while (pRect != pEnd && pRect->top == top)
 	{
-		DeleteObject(this->hrgn);
+		pRect++;
 	}
-#if !REGION_USE_GLOBAL_TEMP_REGION
-	if (this->hrgnTemp != NULL)
+	return pRect;
+}
+
+//Returns true if two bands with the same number of rectangles have the same left and right edges
+template <class Rect>
+static inline bool SameSpans(const Rect* pBand1, const Rect* pBand2, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
 	{
-		DeleteObject(this->hrgnTemp);
+		if (pBand1[i].left != pBand2[i].left || pBand1[i].right != pBand2[i].right)
+		{
+			return false;
+		}
 	}
-#endif
+	return true;
 }
 
-DWORD Region::GetRegionType() const
+//Comparisons for binary searching a banded rectangle list with std::upper_bound
+template <class Rect>
+static inline bool CoordinateAboveBottom(typename RectTraits<Rect>::Coordinate y, const Rect& rect)
 {
-	return this->regionType;
+	return y < rect.bottom;
 }
-
-const RECT& Region::GetBoundingBox() const
+template <class Rect>
+static inline bool CoordinateAboveTop(typename RectTraits<Rect>::Coordinate y, const Rect& rect)
 {
-	return boundingBox;
+	return y < rect.top;
 }
-void Region::GetBoundingBox(RECT* pRect) const
+template <class Rect>
+static inline bool CoordinateLeftOfRight(typename RectTraits<Rect>::Coordinate x, const Rect& rect)
 {
-	*pRect = boundingBox;
+	return x < rect.right;
 }
-void Region::GetBoundingBox(RECT& rect) const
+template <class Rect>
+static inline bool CoordinateLeftOfLeft(typename RectTraits<Rect>::Coordinate x, const Rect& rect)
 {
-	rect = boundingBox;
+	return x < rect.left;
 }
-void Region::GetBoundingBox(int& x, int& y, int& w, int& h) const
+//Returns the first rectangle of the first band whose bottom is below y (the band containing y, or the next band after y)
+template <class Rect>
+static inline const Rect* FindBand(const Rect* pRects, const Rect* pEnd, typename RectTraits<Rect>::Coordinate y)
 {
-	x = boundingBox.left;
-	y = boundingBox.top;
-	w = boundingBox.right - boundingBox.left;
-	h = boundingBox.bottom - boundingBox.top;
+	//bottoms never decrease from one band to the next, and all rectangles in a band share the same bottom
+	return std::upper_bound(pRects, pEnd, y, CoordinateAboveBottom<Rect>);
 }
-
-HRGN Region::GetHrgn()
+//Returns the end of the band which starts at pBand, using a binary search
+template <class Rect>
+static inline const Rect* FindBandEnd(const Rect* pBand, const Rect* pEnd)
 {
-	if (this->hrgn == NULL)
+	return std::upper_bound(pBand, pEnd, pBand->top, CoordinateAboveTop<Rect>);
+}
+//Returns the first span in the band whose right edge is right of x (the span containing x, or the next span after x)
+template <class Rect>
+static inline const Rect* FindSpan(const Rect* pBand, const Rect* pBandEnd, typename RectTraits<Rect>::Coordinate x)
+{
+	return std::upper_bound(pBand, pBandEnd, x, CoordinateLeftOfRight<Rect>);
+}
+
+//Appends bands of spans to a banded rectangle list (a RegionRectList, FixedRectList or VectorRectList), and tracks the bounding box of everything appended.
+//If a finished band has the same spans as the band directly above it, the band above is extended downwards instead.
+template <class List>
+class BasicBandBuilder
+{
+public:
+	typedef typename List::Rect Rect;
+	typedef typename RectTraits<Rect>::Coordinate Coordinate;
+private:
+	List& result;
+	//Bounding box of all bands appended so far (only valid if something was appended)
+	Rect& bounds;
+	//Index of the first rectangle of the previous band, or SIZE_MAX if there is no previous band
+	size_t previousBand;
+	//Index of the first rectangle of the band being built
+	size_t currentBand;
+	Coordinate top;
+	Coordinate bottom;
+public:
+	BasicBandBuilder(List& result, Rect& bounds) : result(result), bounds(bounds)
 	{
-		//No HRGN?  Create it
-		this->hrgn = CreateRectRgnIndirect(&this->boundingBox);
-		SetHrgnValid();
+		//Checked once here instead of for every rectangle added
+		result.MakeWritable();
+		previousBand = SIZE_MAX;
+		currentBand = result.Count();
+		top = 0;
+		bottom = 0;
+		bounds.left = std::numeric_limits<Coordinate>::max();
+		bounds.top = std::numeric_limits<Coordinate>::max();
+		bounds.right = std::numeric_limits<Coordinate>::min();
+		bounds.bottom = std::numeric_limits<Coordinate>::min();
 	}
-	else if (!HrgnIsValid())
+	//Starts a new band
+	void BeginBand(Coordinate top, Coordinate bottom)
 	{
-		//Set our HRGN to the current bounding box
-		if (this->regionType == SIMPLEREGION)
+		this->currentBand = result.Count();
+		this->top = top;
+		this->bottom = bottom;
+	}
+	//Adds a span to the current band, spans must be added from left to right and must not touch
+	void AddSpan(Coordinate left, Coordinate right)
+	{
+		Rect rect = { left, top, right, bottom };
+		result.AddWritable(rect);
+		bounds.left = min(bounds.left, left);
+		bounds.right = max(bounds.right, right);
+	}
+	//Finishes the current band, merging it with the previous band if possible
+	void EndBand()
+	{
+		size_t count = result.Count() - currentBand;
+		if (count == 0)
 		{
-			SetRectRgn(this->hrgn, boundingBox.left, boundingBox.top, boundingBox.right, boundingBox.bottom);
-			SetHrgnValid();
+			return;
 		}
-		else if (this->regionType == NULLREGION)
+		bounds.top = min(bounds.top, top);
+		bounds.bottom = bottom;
+		if (previousBand != SIZE_MAX && currentBand - previousBand == count && result.WritableData()[previousBand].bottom == top)
 		{
-			SetRectRgn(this->hrgn, 0, 0, 0, 0);
-			SetHrgnValid();
+			Rect* pResult = result.WritableData();
+			if (SameSpans(pResult + previousBand, pResult + currentBand, count))
+			{
+				for (size_t i = previousBand; i < currentBand; i++)
+				{
+					pResult[i].bottom = bottom;
+				}
+				result.TruncateWritable(currentBand);
+				return;
+			}
 		}
+		previousBand = currentBand;
 	}
-	return this->hrgn;
-}
-void Region::Clear()
-{
-	boundingBox = {};
-	this->regionType = NULLREGION;
-	SetHrgnInvalid();
-}
-void Region::SetHrgnInvalid()
-{
-#if REGION_USE_VALID_FLAG
-	this->hrgnValid = false;
-#else
-	if (hrgn != NULL)
+};
+typedef BasicBandBuilder<RegionRectList> BandBuilder;
+
+//Rectangle list with a fixed capacity, in memory owned by the caller (used to build the results of FixedRegion operations).
+//Rectangles added once it is full are dropped, and the list remembers that it overflowed.
+class FixedRectList
+{
+private:
+	RECT* pRects;
+	size_t capacity;
+	size_t count;
+	bool overflowed;
+public:
+	typedef RECT Rect;
+	FixedRectList(RECT* pRects, size_t capacity) : pRects(pRects), capacity(capacity)
 	{
-		DeleteObject(hrgn);
-		hrgn = NULL;
+		count = 0;
+		overflowed = false;
 	}
-#endif
-}
-void Region::SetHrgnValid()
-{
-#if REGION_USE_VALID_FLAG
-	this->hrgnValid = true;
-#endif
-}
-bool Region::HrgnIsValid() const
-{
-#if REGION_USE_VALID_FLAG
-	return this->hrgnValid;
-#else
-	return hrgn != NULL;
-#endif
-}
-
-#if !REGION_USE_GLOBAL_TEMP_REGION
-void Region::SetTempRegion(const RECT& rect)
-{
-	if (hrgnTemp == NULL)
+	size_t Count() const
 	{
-		hrgnTemp = CreateRectRgnIndirect(&rect);
+		return count;
 	}
-	else
+	void MakeWritable()
 	{
-		SetRectRgn(hrgnTemp, rect.left, rect.top, rect.right, rect.bottom);
 	}
-}
-#endif
-
-void Region::BecomeRectangle(int left, int top, int right, int bottom)
-{
-	boundingBox.left = left;
-	boundingBox.top = top;
-	boundingBox.right = right;
-	boundingBox.bottom = bottom;
-	this->regionType = SIMPLEREGION;
-	SetHrgnInvalid();
-}
-void Region::BecomeRectangle(const RECT& rect)
-{
-	BecomeRectangle(rect.left, rect.top, rect.right, rect.bottom);
-}
-void Region::UnionBoundingBox(const RECT& rect)
-{
-	boundingBox.left = min(boundingBox.left, rect.left);
-	boundingBox.top = min(boundingBox.top, rect.top);
-	boundingBox.right = max(boundingBox.right, rect.right);
-	boundingBox.bottom = max(boundingBox.bottom, rect.bottom);
-}
-void Region::IntersectBoundingbox(const RECT& rect)
-{
-	boundingBox.left = max(boundingBox.left, rect.left);
-	boundingBox.top = max(boundingBox.top, rect.top);
-	boundingBox.right = min(boundingBox.right, rect.right);
-	boundingBox.bottom = min(boundingBox.bottom, rect.bottom);
-}
-
-void Region::UnionRectWithRect(const RECT& other)
-{
-	//only called when we know that this region is currently a rectangle
-	const RECT& me = this->boundingBox;
+	RECT* WritableData()
+	{
+		return pRects;
+	}
+	void AddWritable(const RECT& rect)
+	{
+		if (count == capacity)
+		{
+			overflowed = true;
+			return;
+		}
+		pRects[count++] = rect;
+	}
+	void TruncateWritable(size_t newCount)
+	{
+		count = newCount;
+	}
+	//True if rectangles were dropped because the list was full
+	bool Overflowed() const
+	{
+		return overflowed;
+	}
+};
 
-	//Do we cover up the other?
-	if (RectCoversUpOther(me, other))
+//Rectangle list kept in a vector (used to build the results of BasicRegion operations)
+template <class RectType>
+class VectorRectList
+{
+private:
+	vector<RectType>& rects;
+public:
+	typedef RectType Rect;
+	explicit VectorRectList(vector<Rect>& rects) : rects(rects)
 	{
-		//no assignments needed, can preserve the HRGN
-		return;
 	}
+	size_t Count() const
+	{
+		return rects.size();
+	}
+	void Clear()
+	{
+		rects.clear();
+	}
+	void Reserve(size_t capacity)
+	{
+		rects.reserve(capacity);
+	}
+	void MakeWritable()
+	{
+	}
+	Rect* WritableData()
+	{
+		return rects.data();
+	}
+	void AddWritable(const Rect& rect)
+	{
+		rects.push_back(rect);
+	}
+	void TruncateWritable(size_t newCount)
+	{
+		rects.erase(rects.begin() + newCount, rects.end());
+	}
+};
 
-	//Does the other cover up us?
-	if (RectCoversUpOther(other, me))
+//Combines two lists of spans (sorted, not overlapping) from the same band, adds the resulting spans to the band builder
+template <int operation, class Builder>
+static void CombineSpans(const typename Builder::Rect* a, const typename Builder::Rect* aEnd, const typename Builder::Rect* b, const typename Builder::Rect* bEnd, Builder& builder)
+{
+	typedef typename Builder::Coordinate Coordinate;
+	//Only one side has spans, result is either that side or nothing
+	if (a == aEnd || b == bEnd)
 	{
-		BecomeRectangle(other);
+		if (operation == COMBINE_AND)
+		{
+			return;
+		}
+		if (a == aEnd)
+		{
+			if (operation == COMBINE_DIFF)
+			{
+				return;
+			}
+			a = b;
+			aEnd = bEnd;
+		}
+		for (; a != aEnd; a++)
+		{
+			builder.AddSpan(a->left, a->right);
+		}
 		return;
 	}
 
-	//Check if we are aligned vertically and overlapping
-	if (me.top == other.top && me.bottom == other.bottom)
+	//Walk the left and right edges of both lists in order, and emit a span whenever the result changes from outside to inside and back
+	bool insideA = false;
+	bool insideB = false;
+	bool inside = false;
+	Coordinate start = 0;
+	while (a != aEnd || b != bEnd)
 	{
-		if (me.left > other.right || other.left > me.right)
+		Coordinate xa = a != aEnd ? (insideA ? a->right : a->left) : std::numeric_limits<Coordinate>::max();
+		Coordinate xb = b != bEnd ? (insideB ? b->right : b->left) : std::numeric_limits<Coordinate>::max();
+		Coordinate x = min(xa, xb);
+		if (a != aEnd && xa == x)
 		{
-			//reject
+			if (insideA) a++;
+			insideA = !insideA;
 		}
-		else
+		if (b != bEnd && xb == x)
 		{
-			BecomeRectangle(min(me.left, other.left), me.top, max(me.right, other.right), me.bottom);
-			return;
+			if (insideB) b++;
+			insideB = !insideB;
+		}
+		bool nowInside = CombineInside<operation>(insideA, insideB);
+		if (nowInside != inside)
+		{
+			if (nowInside)
+			{
+				start = x;
+			}
+			else
+			{
+				builder.AddSpan(start, x);
+			}
+			inside = nowInside;
 		}
 	}
-	//check if we are aligned horizontally and overlapping
-	else if (me.left == other.left && me.right == other.right)
+}
+
+//Combines two banded rectangle lists, appends the banded result to the vector.
+//Only the part from yStart to yEnd is combined, bands which cross those lines are cut off at them.
+template <int operation, class List>
+static void CombineBands(const typename List::Rect* a, const typename List::Rect* aEnd, const typename List::Rect* b, const typename List::Rect* bEnd,
+	typename BasicBandBuilder<List>::Coordinate yStart, typename BasicBandBuilder<List>::Coordinate yEnd, List& result, typename List::Rect& bounds)
+{
+	typedef typename List::Rect Rect;
+	typedef typename BasicBandBuilder<List>::Coordinate Coordinate;
+	const Coordinate coordinateMax = std::numeric_limits<Coordinate>::max();
+	BasicBandBuilder<List> builder(result, bounds);
+	const Rect* aBandEnd = a != aEnd ? BandEnd(a, aEnd) : a;
+	const Rect* bBandEnd = b != bEnd ? BandEnd(b, bEnd) : b;
+	//Everything above y has already been processed
+	Coordinate y = yStart;
+	while ((a != aEnd || b != bEnd) && y < yEnd)
 	{
-		if (me.top > other.bottom || other.top > me.bottom)
+		if (operation == COMBINE_AND && (a == aEnd || b == bEnd))
 		{
-			//reject
+			break;
 		}
-		else
+		if (operation == COMBINE_DIFF && a == aEnd)
 		{
-			BecomeRectangle(me.left, min(me.top, other.top), me.right, max(me.bottom, other.bottom));
-			return;
+			break;
+		}
+		//Find the next horizontal strip where neither region changes its band
+		Coordinate aTop = a != aEnd ? max(a->top, y) : coordinateMax;
+		Coordinate bTop = b != bEnd ? max(b->top, y) : coordinateMax;
+		Coordinate top = min(aTop, bTop);
+		bool insideA = a != aEnd && aTop == top;
+		bool insideB = b != bEnd && bTop == top;
+		Coordinate bottom = coordinateMax;
+		if (a != aEnd) bottom = min(bottom, insideA ? a->bottom : a->top);
+		if (b != bEnd) bottom = min(bottom, insideB ? b->bottom : b->top);
+		if (top >= yEnd)
+		{
+			break;
+		}
+		bottom = min(bottom, yEnd);
+
+		builder.BeginBand(top, bottom);
+		CombineSpans<operation>(insideA ? a : aBandEnd, aBandEnd, insideB ? b : bBandEnd, bBandEnd, builder);
+		builder.EndBand();
+
+		//Move past bands which are now finished
+		y = bottom;
+		if (a != aEnd && a->bottom <= y)
+		{
+			a = aBandEnd;
+			aBandEnd = a != aEnd ? BandEnd(a, aEnd) : a;
+		}
+		if (b != bEnd && b->bottom <= y)
+		{
+			b = bBandEnd;
+			bBandEnd = b != bEnd ? BandEnd(b, bEnd) : b;
 		}
 	}
-	UnionRectWithRectBecomeComplex(other);
 }
 
-void Region::UnionRectWithRectBecomeComplex(const RECT& other)
+//Combines the part of two banded rectangle lists from yStart to yEnd, and appends the banded result to the vector
+template <class List>
+static void CombineBands(const typename List::Rect* a, const typename List::Rect* aEnd, const typename List::Rect* b, const typename List::Rect* bEnd, int operation,
+	typename BasicBandBuilder<List>::Coordinate yStart, typename BasicBandBuilder<List>::Coordinate yEnd, List& result, typename List::Rect& bounds)
 {
-	GetHrgn();
-	HRGN hrgnTemp = SetTempRegion(other);
-	this->regionType = CombineRgn(this->hrgn, this->hrgn, hrgnTemp, RGN_OR);
-	SetHrgnValid();
-	UnionBoundingBox(other);
+	switch (operation)
+	{
+	case COMBINE_OR:
+		CombineBands<COMBINE_OR>(a, aEnd, b, bEnd, yStart, yEnd, result, bounds);
+		break;
+	case COMBINE_AND:
+		CombineBands<COMBINE_AND>(a, aEnd, b, bEnd, yStart, yEnd, result, bounds);
+		break;
+	case COMBINE_DIFF:
+		CombineBands<COMBINE_DIFF>(a, aEnd, b, bEnd, yStart, yEnd, result, bounds);
+		break;
+	case COMBINE_XOR:
+		CombineBands<COMBINE_XOR>(a, aEnd, b, bEnd, yStart, yEnd, result, bounds);
+		break;
+	}
 }
 
-void Region::UnionWith(const RECT& other)
+#if REGION_USE_THREADS
+//Joins the results of the stripes of a parallel combine into one banded list.  Where the last band of a stripe touches
+//the first band of the next stripe and has the same spans, they are merged (a band that crossed the line between the stripes).
+static void JoinStripes(const RegionRectList* pStripes, const RECT* pStripeBounds, size_t stripeCount, RegionRectList& result, RECT& bounds)
 {
-	if (regionType == NULLREGION)
+	size_t total = 0;
+	for (size_t i = 0; i < stripeCount; i++)
 	{
-		//We are a null region, become the other rectangle
-		BecomeRectangle(other);
+		total += pStripes[i].Count();
 	}
-	else if (regionType == SIMPLEREGION)
+	result.Clear();
+	RECT* pResult = result.Resize(total);
+	size_t count = 0;
+	//Index of the first rectangle of the last band in the result
+	size_t lastBand = 0;
+	bounds.left = CoordinateMax;
+	bounds.top = CoordinateMax;
+	bounds.right = CoordinateMin;
+	bounds.bottom = CoordinateMin;
+	for (size_t i = 0; i < stripeCount; i++)
 	{
-		//We are a rectangle
-		UnionRectWithRect(other);
+		const RegionRectList& stripe = pStripes[i];
+		const RECT* pRects = stripe.Data();
+		const RECT* pEnd = pRects + stripe.Count();
+		if (pRects == pEnd)
+		{
+			continue;
+		}
+		const RECT& stripeBounds = pStripeBounds[i];
+		bounds.left = min(bounds.left, stripeBounds.left);
+		bounds.top = min(bounds.top, stripeBounds.top);
+		bounds.right = max(bounds.right, stripeBounds.right);
+		bounds.bottom = max(bounds.bottom, stripeBounds.bottom);
+		if (count != 0)
+		{
+			const RECT* pFirstBandEnd = BandEnd(pRects, pEnd);
+			size_t firstBandCount = pFirstBandEnd - pRects;
+			if (pResult[lastBand].bottom == pRects->top && count - lastBand == firstBandCount && SameSpans(pResult + lastBand, pRects, firstBandCount))
+			{
+				for (size_t j = lastBand; j < count; j++)
+				{
+					pResult[j].bottom = pRects->bottom;
+				}
+				pRects = pFirstBandEnd;
+				if (pRects == pEnd)
+				{
+					continue;
+				}
+			}
+		}
+		memcpy(pResult + count, pRects, (pEnd - pRects) * sizeof(RECT));
+		count += pEnd - pRects;
+		const RECT* pLastBand = pEnd - 1;
+		while (pLastBand != pRects && pLastBand[-1].top == pLastBand->top)
+		{
+			pLastBand--;
+		}
+		lastBand = count - (pEnd - pLastBand);
 	}
-	else if (regionType == COMPLEXREGION)
+	result.Truncate(count);
+}
+
+//Combines two large banded rectangle lists by cutting them into horizontal stripes, combining the stripes on the
+//threads of the shared thread pool, then joining the stripes together
+static void CombineRectsParallel(const RECT* a, size_t aCount, const RECT* b, size_t bCount, int operation, size_t stripeCount, RegionRectList& result, RECT& bounds)
+{
+	//Cut at the tops of bands of the longer list, so the stripes have about the same number of rectangles
+	const RECT* pCutRects = aCount >= bCount ? a : b;
+	size_t cutCount = max(aCount, bCount);
+	vector<LONG> cuts;
+	cuts.push_back(CoordinateMin);
+	for (size_t i = 1; i < stripeCount; i++)
 	{
-		//Does the other cover up us?
-		if (RectCoversUpOther(other, this->boundingBox))
+		LONG y = pCutRects[cutCount * i / stripeCount].top;
+		if (y > cuts.back())
 		{
-			BecomeRectangle(other);
+			cuts.push_back(y);
+		}
+	}
+	cuts.push_back(CoordinateMax);
+	stripeCount = cuts.size() - 1;
+
+	//Stripes are combined on other threads, so they allocate from the heap instead of the caller's arena
+	//(constructed in place: a copy would take the current arena)
+	vector<RegionRectList> stripes;
+	stripes.reserve(stripeCount);
+	vector<RECT> stripeBounds(stripeCount);
+	for (size_t i = 0; i < stripeCount; i++)
+	{
+		stripes.emplace_back((RegionArena*)NULL);
+	}
+	const RECT* aEnd = a + aCount;
+	const RECT* bEnd = b + bCount;
+	RegionThreadPool::GetShared().ParallelFor(stripeCount, [&](size_t i) {
+		LONG top = cuts[i];
+		LONG bottom = cuts[i + 1];
+		//Bands which overlap the stripe
+		const RECT* aStripe = FindBand(a, aEnd, top);
+		const RECT* aStripeEnd = std::upper_bound(aStripe, aEnd, bottom - 1, CoordinateAboveTop<RECT>);
+		const RECT* bStripe = FindBand(b, bEnd, top);
+		const RECT* bStripeEnd = std::upper_bound(bStripe, bEnd, bottom - 1, CoordinateAboveTop<RECT>);
+		stripes[i].Reserve((aStripeEnd - aStripe) + (bStripeEnd - bStripe));
+		CombineBands(aStripe, aStripeEnd, bStripe, bStripeEnd, operation, top, bottom, stripes[i], stripeBounds[i]);
+	});
+	JoinStripes(&stripes[0], &stripeBounds[0], stripeCount, result, bounds);
+}
+#endif
+
+//Combines two banded rectangle lists, result vector receives the banded result, and bounds receives its bounding box
+static void CombineRects(const RECT* a, size_t aCount, const RECT* b, size_t bCount, int operation, RegionRectList& result, RECT& bounds)
+{
+#if REGION_USE_THREADS
+	if (aCount + bCount >= REGION_PARALLEL_MIN_RECTS)
+	{
+		size_t threadCount = RegionThreadPool::GetShared().GetThreadCount();
+		//A few stripes per thread, so a thread which finishes early can take another stripe
+		size_t stripeCount = min(threadCount * 4, (aCount + bCount) / REGION_PARALLEL_STRIPE_MIN_RECTS);
+		if (threadCount > 1 && stripeCount > 1)
+		{
+			CombineRectsParallel(a, aCount, b, bCount, operation, stripeCount, result, bounds);
 			return;
 		}
-		UnionRectWithRectBecomeComplex(other);
 	}
+#endif
+	result.Clear();
+	result.Reserve(aCount + bCount);
+	CombineBands(a, a + aCount, b, b + bCount, operation, CoordinateMin, CoordinateMax, result, bounds);
 }
-void Region::UnionWith(const RECT* pRect)
+
+//Orders rectangles by their top edge, then by their left edge
+template <class Rect>
+static inline bool RectTopLeftLess(const Rect& rect1, const Rect& rect2)
 {
-	UnionWith(*pRect);
+	return rect1.top < rect2.top || (rect1.top == rect2.top && rect1.left < rect2.left);
 }
-/*static*/ bool Region::RectCoversUpOther(const RECT& rect1, const RECT& rect2)
+//Orders rectangles by their left edge
+template <class Rect>
+static inline bool RectLeftLess(const Rect& rect1, const Rect& rect2)
 {
-	return rect2.left >= rect1.left && rect2.right <= rect1.right &&
-		rect2.top >= rect1.top && rect2.bottom <= rect1.bottom;
+	return rect1.left < rect2.left;
 }
-/*static*/ bool Region::RectOverlaps(const RECT& rect1, const RECT& rect2)
+//Returns true if the rectangle's bottom edge is at or above y
+template <class Rect>
+struct RectEndsBy
+{
+	typename RectTraits<Rect>::Coordinate y;
+	RectEndsBy(typename RectTraits<Rect>::Coordinate y) : y(y) {}
+	bool operator()(const Rect& rect) const { return rect.bottom <= y; }
+};
+
+//A banded rectangle list being walked by CombineLists
+struct ListCursor
+{
+	//Current band, end of the current band, and end of the list
+	const RECT* pBand;
+	const RECT* pBandEnd;
+	const RECT* pEnd;
+	//True while the sweep is inside of the current band
+	bool active;
+};
+
+//Next edge of each list (coordinate, index), smallest coordinate at the front
+typedef std::pair<LONG, size_t> Edge;
+typedef vector<Edge> EdgeHeap;
+static inline void PushEdge(EdgeHeap& heap, LONG coordinate, size_t index)
 {
-	return !(rect1.right <= rect2.left || rect2.right <= rect1.left || rect1.bottom <= rect2.top || rect2.bottom <= rect1.top);
+	heap.push_back(Edge(coordinate, index));
+	std::push_heap(heap.begin(), heap.end(), std::greater<Edge>());
 }
-/*static*/ bool Region::RectEquals(const RECT& rect1, const RECT& rect2)
+static inline size_t PopEdge(EdgeHeap& heap)
 {
-	return rect1.left == rect2.left && rect1.top == rect2.top && rect1.right == rect2.right && rect1.bottom == rect2.bottom;
+	std::pop_heap(heap.begin(), heap.end(), std::greater<Edge>());
+	size_t index = heap.back().second;
+	heap.pop_back();
+	return index;
 }
 
-void Region::BecomeRegion(const Region& region)
+//Orders spans by their left edge
+static inline bool SpanLeftLess(const RECT& a, const RECT& b)
 {
-	if (region.regionType == SIMPLEREGION)
+	return a.left < b.left;
+}
+
+//Adds the union of the spans of several bands to the band builder.  The spans are gathered and sorted (there are usually only a few),
+//then spans which overlap or touch are joined.
+static void UnionListSpans(const vector<ListCursor>& lists, const vector<size_t>& activeLists, vector<RECT>& spans, BandBuilder& builder)
+{
+	spans.clear();
+	for (size_t i = 0; i < activeLists.size(); i++)
 	{
-		BecomeRectangle(region.boundingBox);
+		const ListCursor& list = lists[activeLists[i]];
+		spans.insert(spans.end(), list.pBand, list.pBandEnd);
 	}
-	else if (region.regionType == COMPLEXREGION)
+	std::sort(spans.begin(), spans.end(), SpanLeftLess);
+	LONG left = spans[0].left;
+	LONG right = spans[0].right;
+	for (size_t i = 1; i < spans.size(); i++)
 	{
-		Clear();
-		GetHrgn();
-		this->regionType = CombineRgn(this->hrgn, this->hrgn, region.hrgn, RGN_OR);
-		this->boundingBox = region.boundingBox;
+		if (spans[i].left > right)
+		{
+			builder.AddSpan(left, right);
+			left = spans[i].left;
+		}
+		right = max(right, spans[i].right);
 	}
-	else if (region.regionType == NULLREGION)
+	builder.AddSpan(left, right);
+}
+
+//Adds the intersection of the spans of several bands to the band builder, intersecting one band at a time and stopping once nothing is left
+static void IntersectListSpans(const vector<ListCursor>& lists, const vector<size_t>& activeLists, vector<RECT>& spans, vector<RECT>& nextSpans, BandBuilder& builder)
+{
+	const ListCursor& first = lists[activeLists[0]];
+	spans.assign(first.pBand, first.pBandEnd);
+	for (size_t i = 1; i < activeLists.size() && !spans.empty(); i++)
 	{
-		Clear();
+		const ListCursor& list = lists[activeLists[i]];
+		nextSpans.clear();
+		const RECT* a = &spans[0];
+		const RECT* aEnd = a + spans.size();
+		const RECT* b = list.pBand;
+		while (a != aEnd && b != list.pBandEnd)
+		{
+			RECT span = *a;
+			span.left = max(a->left, b->left);
+			span.right = min(a->right, b->right);
+			if (span.left < span.right)
+			{
+				nextSpans.push_back(span);
+			}
+			//Moves past whichever span ends first
+			if (a->right < b->right)
+			{
+				a++;
+			}
+			else
+			{
+				b++;
+			}
+		}
+		spans.swap(nextSpans);
+	}
+	for (size_t i = 0; i < spans.size(); i++)
+	{
+		builder.AddSpan(spans[i].left, spans[i].right);
 	}
 }
 
-void Region::UnionWith(const Region& region)
-{
-	if (region.regionType == SIMPLEREGION)
+//Combines several banded rectangle lists in one sweep from top to bottom, which visits the tops and bottoms of the bands of all lists
+//in order using a heap.  operation is COMBINE_OR for the union of the lists, or COMBINE_AND for their intersection.
+static void CombineLists(vector<ListCursor>& lists, int operation, RegionRectList& result, RECT& bounds)
+{
+	BandBuilder builder(result, bounds);
+	//Number of lists which must be inside of a band for the result to have a band there
+	size_t minimumCount = operation == COMBINE_AND ? lists.size() : 1;
+	EdgeHeap bandEdges;
+	//Lists which are inside of a band at the current y
+	vector<size_t> activeLists;
+	vector<RECT> spans;
+	vector<RECT> nextSpans;
+	for (size_t i = 0; i < lists.size(); i++)
 	{
-		UnionWith(region.boundingBox);
+		lists[i].active = false;
+		if (lists[i].pBand != lists[i].pEnd)
+		{
+			PushEdge(bandEdges, lists[i].pBand->top, i);
+		}
 	}
-	else if (region.regionType == COMPLEXREGION)
+	while (!bandEdges.empty())
 	{
-		//if we cover up the other region, nothing to do for union operation
-		if (this->regionType == SIMPLEREGION && RectCoversUpOther(boundingBox, region.boundingBox))
+		LONG y = bandEdges.front().first;
+		while (!bandEdges.empty() && bandEdges.front().first == y)
 		{
-			return;
+			size_t index = PopEdge(bandEdges);
+			ListCursor& list = lists[index];
+			if (list.active)
+			{
+				//Band ends at y
+				list.active = false;
+				activeLists.erase(std::find(activeLists.begin(), activeLists.end(), index));
+				list.pBand = list.pBandEnd;
+				if (list.pBand == list.pEnd)
+				{
+					continue;
+				}
+				if (list.pBand->top != y)
+				{
+					PushEdge(bandEdges, list.pBand->top, index);
+					continue;
+				}
+			}
+			//Band starts at y
+			list.active = true;
+			list.pBandEnd = BandEnd(list.pBand, list.pEnd);
+			activeLists.push_back(index);
+			PushEdge(bandEdges, list.pBand->bottom, index);
 		}
-		bool haveBoundingBox = this->regionType != NULLREGION;
-		GetHrgn();
-		this->regionType = CombineRgn(this->hrgn, this->hrgn, region.hrgn, RGN_OR);
-		if (haveBoundingBox)
+		//For an intersection, nothing is left once a list has run out
+		if (bandEdges.empty() || (operation == COMBINE_AND && bandEdges.size() < lists.size()))
 		{
-			UnionBoundingBox(region.boundingBox);
+			break;
 		}
-		else
+		if (activeLists.size() >= minimumCount)
 		{
-			this->boundingBox = region.boundingBox;
+			builder.BeginBand(y, bandEdges.front().first);
+			if (activeLists.size() == 1)
+			{
+				const ListCursor& list = lists[activeLists[0]];
+				for (const RECT* pSpan = list.pBand; pSpan != list.pBandEnd; pSpan++)
+				{
+					builder.AddSpan(pSpan->left, pSpan->right);
+				}
+			}
+			else if (operation == COMBINE_OR)
+			{
+				UnionListSpans(lists, activeLists, spans, builder);
+			}
+			else
+			{
+				IntersectListSpans(lists, activeLists, spans, nextSpans, builder);
+			}
+			builder.EndBand();
 		}
 	}
 }
-void Region::UnionWith(HRGN hrgn)
-{
-	GetHrgn();
-	this->regionType = CombineRgn(this->hrgn, this->hrgn, hrgn, RGN_OR);
-	//Check if provided HRGN was invalid
-	if (this->regionType == 0)
+
+//Builds the union of an unsorted array of rectangles (which may overlap, and may be empty) in a single top to bottom sweep.
+//Result vector receives the banded result, and bounds receives its bounding box.
+template <class List>
+static void BuildRectsUnion(const typename List::Rect* pRects, size_t count, List& result, typename List::Rect& bounds)
+{
+	typedef typename List::Rect Rect;
+	typedef typename BasicBandBuilder<List>::Coordinate Coordinate;
+	result.Clear();
+	//Sort the non-empty rectangles by top edge
+	vector<Rect> sorted;
+	sorted.reserve(count);
+	for (size_t i = 0; i < count; i++)
 	{
-		Clear();
-		return;
+		if (pRects[i].left < pRects[i].right && pRects[i].top < pRects[i].bottom)
+		{
+			sorted.push_back(pRects[i]);
+		}
 	}
-	this->regionType = GetRgnBox(this->hrgn, &this->boundingBox);
-}
-void Region::UnionWith(int x, int y, int w, int h)
-{
-	RECT rect{ x, y, x + w, y + h };
+	std::sort(sorted.begin(), sorted.end(), RectTopLeftLess<Rect>);
+	result.Reserve(sorted.size());
+
+	BasicBandBuilder<List> builder(result, bounds);
+	//Rectangles which cross the current y position, sorted by left edge
+	vector<Rect> active;
+	size_t next = 0;
+	Coordinate y = std::numeric_limits<Coordinate>::min();
+	while (next < sorted.size() || !active.empty())
+	{
+		if (active.empty())
+		{
+			y = sorted[next].top;
+		}
+		//Add rectangles which start here (already sorted by left edge, so merge them in)
+		size_t activeCount = active.size();
+		while (next < sorted.size() && sorted[next].top == y)
+		{
+			active.push_back(sorted[next]);
+			next++;
+		}
+		if (activeCount != 0 && activeCount != active.size())
+		{
+			std::inplace_merge(active.begin(), active.begin() + activeCount, active.end(), RectLeftLess<Rect>);
+		}
+		//This band ends where the next rectangle starts or an active rectangle ends
+		Coordinate bottom = next < sorted.size() ? sorted[next].top : std::numeric_limits<Coordinate>::max();
+		for (size_t i = 0; i < active.size(); i++)
+		{
+			bottom = min(bottom, active[i].bottom);
+		}
+		//Merge the overlapping and touching spans
+		builder.BeginBand(y, bottom);
+		Coordinate left = active[0].left;
+		Coordinate right = active[0].right;
+		for (size_t i = 1; i < active.size(); i++)
+		{
+			if (active[i].left > right)
+			{
+				builder.AddSpan(left, right);
+				left = active[i].left;
+			}
+			right = max(right, active[i].right);
+		}
+		builder.AddSpan(left, right);
+		builder.EndBand();
+
+		active.erase(std::remove_if(active.begin(), active.end(), RectEndsBy<Rect>(bottom)), active.end());
+		y = bottom;
+	}
+}
+
+//Returns true if a list of rectangles follows all of the rules for a y-x banded rectangle list (see Region::rects)
+template <class Rect>
+static bool IsBanded(const Rect* pRects, size_t count)
+{
+	const Rect* pEnd = pRects + count;
+	const Rect* pPreviousBand = NULL;
+	const Rect* pBand = pRects;
+	while (pBand != pEnd)
+	{
+		const Rect* pBandEnd = BandEnd(pBand, pEnd);
+		for (const Rect* pRect = pBand; pRect != pBandEnd; pRect++)
+		{
+			if (pRect->left >= pRect->right || pRect->bottom != pBand->bottom || pRect->top >= pRect->bottom)
+			{
+				return false;
+			}
+			if (pRect != pBand && pRect[-1].right >= pRect->left)
+			{
+				return false;
+			}
+		}
+		if (pPreviousBand != NULL)
+		{
+			if (pPreviousBand->bottom > pBand->top)
+			{
+				return false;
+			}
+			//touching bands with the same spans should have been merged
+			if (pPreviousBand->bottom == pBand->top && pBand - pPreviousBand == pBandEnd - pBand)
+			{
+				bool same = true;
+				for (ptrdiff_t i = 0; i < pBandEnd - pBand; i++)
+				{
+					if (pPreviousBand[i].left != pBand[i].left || pPreviousBand[i].right != pBand[i].right)
+					{
+						same = false;
+						break;
+					}
+				}
+				if (same)
+				{
+					return false;
+				}
+			}
+		}
+		pPreviousBand = pBand;
+		pBand = pBandEnd;
+	}
+	return true;
+}
+
+//Merges touching bands which have the same spans (clipping can make bands the same which were different before),
+//and returns the new number of rectangles.  This is the only rule of a banded list that clipping the rectangles can break.
+template <class Rect>
+static size_t CoalesceBands(Rect* pRects, size_t count)
+{
+	Rect* pEnd = pRects + count;
+	Rect* pOut = pRects;
+	//Start of the last band written to pOut
+	Rect* pPreviousBand = NULL;
+	Rect* pBand = pRects;
+	while (pBand != pEnd)
+	{
+		Rect* pBandEnd = pBand + (BandEnd<Rect>(pBand, pEnd) - pBand);
+		size_t bandCount = pBandEnd - pBand;
+		if (pPreviousBand != NULL && (size_t)(pOut - pPreviousBand) == bandCount && pPreviousBand->bottom == pBand->top && SameSpans(pPreviousBand, pBand, bandCount))
+		{
+			for (Rect* pRect = pPreviousBand; pRect != pOut; pRect++)
+			{
+				pRect->bottom = pBand->bottom;
+			}
+		}
+		else
+		{
+			pPreviousBand = pOut;
+			if (pOut != pBand)
+			{
+				memmove(pOut, pBand, bandCount * sizeof(Rect));
+			}
+			pOut += bandCount;
+		}
+		pBand = pBandEnd;
+	}
+	return pOut - pRects;
+}
+
+//Returns the index of the lowest set bit (bits must not be 0)
+static inline int LowestSetBit(uint64_t bits)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return (int)index;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanForward(&index, (unsigned long)bits))
+	{
+		return (int)index;
+	}
+	_BitScanForward(&index, (unsigned long)(bits >> 32));
+	return (int)index + 32;
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+//Converts a row of a 1bpp mask (leftmost pixel in the most significant bit) to a bit array with pixel i in bit i % 64 of pBits[i / 64],
+//clearing the bits past width
+static void MaskRowToBits(const byte* pRow, size_t width, uint64_t* pBits)
+{
+	//Each byte with its bits in the opposite order
+	static const struct ReversedBytes
+	{
+		byte values[256];
+		ReversedBytes()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				int reversed = 0;
+				for (int bit = 0; bit < 8; bit++)
+				{
+					reversed |= ((i >> bit) & 1) << (7 - bit);
+				}
+				values[i] = (byte)reversed;
+			}
+		}
+	} reversedBytes;
+	size_t byteCount = (width + 7) / 8;
+	size_t wordCount = (width + 63) / 64;
+	for (size_t i = 0; i < wordCount; i++)
+	{
+		uint64_t word = 0;
+		size_t end = min(byteCount, i * 8 + 8);
+		for (size_t j = i * 8; j < end; j++)
+		{
+			word |= (uint64_t)reversedBytes.values[pRow[j]] << ((j - i * 8) * 8);
+		}
+		pBits[i] = word;
+	}
+	if (width % 64 != 0)
+	{
+		pBits[wordCount - 1] &= ((uint64_t)1 << (width % 64)) - 1;
+	}
+}
+
+//Adds a span to the band builder for each run of set bits in a bit array of wordCount words
+static void AddBitRuns(const uint64_t* pBits, size_t wordCount, BandBuilder& builder)
+{
+	bool inside = false;
+	LONG start = 0;
+	for (size_t i = 0; i < wordCount; i++)
+	{
+		uint64_t word = pBits[i];
+		//Quickly skips words which don't end a run or start one
+		if (word == (inside ? ~(uint64_t)0 : 0))
+		{
+			continue;
+		}
+		//Bits which have been looked at are left out of the search for the next edge
+		uint64_t remaining = ~(uint64_t)0;
+		while (true)
+		{
+			uint64_t edges = (inside ? ~word : word) & remaining;
+			if (edges == 0)
+			{
+				break;
+			}
+			int bit = LowestSetBit(edges);
+			LONG x = (LONG)(i * 64 + bit);
+			if (inside)
+			{
+				builder.AddSpan(start, x);
+			}
+			else
+			{
+				start = x;
+			}
+			inside = !inside;
+			remaining = ~(uint64_t)0 << bit;
+		}
+	}
+	if (inside)
+	{
+		builder.AddSpan(start, (LONG)(wordCount * 64));
+	}
+}
+
+//Multiplies a coordinate by num / den (den must be positive), rounding down or up, and clamping to the coordinate range
+static inline LONG ScaleCoordinate(LONG value, int num, int den, bool roundUp)
+{
+	long long product = (long long)value * num;
+	long long quotient = product / den;
+	long long remainder = product % den;
+	if (roundUp && remainder > 0)
+	{
+		quotient++;
+	}
+	else if (!roundUp && remainder < 0)
+	{
+		quotient--;
+	}
+	return (LONG)max((long long)CoordinateMin, min((long long)CoordinateMax, quotient));
+}
+//Scales a rectangle by num / den, rounding its edges outward or inward
+static inline void ScaleRect(RECT& rect, int num, int den, bool outward)
+{
+	rect.left = ScaleCoordinate(rect.left, num, den, !outward);
+	rect.top = ScaleCoordinate(rect.top, num, den, !outward);
+	rect.right = ScaleCoordinate(rect.right, num, den, outward);
+	rect.bottom = ScaleCoordinate(rect.bottom, num, den, outward);
+}
+
+//A band used while simplifying a region
+struct SimplifyBand
+{
+	LONG top;
+	LONG bottom;
+	//Spans in the band, only left and right are used
+	vector<RECT> spans;
+	//Total width of the spans
+	double width;
+	//Indexes of the neighboring bands (bands joined into the band above them are skipped), or SIZE_MAX
+	size_t above;
+	size_t below;
+	//Changes whenever the band changes, or is joined into the band above it
+	size_t version;
+};
+
+//Returns the area added by joining two neighboring bands into one band covering both (and any gap between them),
+//and fills mergedSpans with the spans of the joined band
+static double MergeBandsCost(const SimplifyBand& above, const SimplifyBand& below, vector<RECT>& mergedSpans, double& mergedWidth)
+{
+	mergedSpans.clear();
+	mergedWidth = 0;
+	const RECT* a = above.spans.data();
+	const RECT* aEnd = a + above.spans.size();
+	const RECT* b = below.spans.data();
+	const RECT* bEnd = b + below.spans.size();
+	while (a != aEnd || b != bEnd)
+	{
+		const RECT* pNext = (b == bEnd || (a != aEnd && a->left <= b->left)) ? a++ : b++;
+		if (!mergedSpans.empty() && pNext->left <= mergedSpans.back().right)
+		{
+			mergedSpans.back().right = max(mergedSpans.back().right, pNext->right);
+		}
+		else
+		{
+			mergedSpans.push_back(*pNext);
+		}
+	}
+	for (size_t i = 0; i < mergedSpans.size(); i++)
+	{
+		mergedWidth += (double)mergedSpans[i].right - mergedSpans[i].left;
+	}
+	double mergedArea = mergedWidth * ((double)below.bottom - above.top);
+	return mergedArea - above.width * ((double)above.bottom - above.top) - below.width * ((double)below.bottom - below.top);
+}
+
+//Returns the index of the span followed by the narrowest gap (there must be at least two spans)
+static size_t FindNarrowestGap(const vector<RECT>& spans)
+{
+	size_t best = 0;
+	for (size_t i = 1; i + 1 < spans.size(); i++)
+	{
+		if ((double)spans[i + 1].left - spans[i].right < (double)spans[best + 1].left - spans[best].right)
+		{
+			best = i;
+		}
+	}
+	return best;
+}
+//Joins a span with the span after it, filling in the gap between them
+static void FillGap(SimplifyBand& band, size_t span)
+{
+	band.width += (double)band.spans[span + 1].left - band.spans[span].right;
+	band.spans[span].right = band.spans[span + 1].right;
+	band.spans.erase(band.spans.begin() + span + 1);
+}
+
+//A join SimplifyRects could make: filling the narrowest gap in a band, or joining a band with the band below it
+struct SimplifyJoin
+{
+	//Area added, and number of rectangles removed
+	double cost;
+	size_t removed;
+	size_t band;
+	//True for joining the band with the band below it
+	bool mergeBelow;
+	//Versions of the band (and the band below it) when the join was worked out.  The join is out of date if either one has changed.
+	size_t version;
+	size_t belowVersion;
+};
+//Orders joins by area added per rectangle removed, so the cheapest join is at the front of the heap.
+//Ties go to the join nearest the top (filling a gap before joining with the band below).
+struct SimplifyJoinWorse
+{
+	bool operator()(const SimplifyJoin& a, const SimplifyJoin& b) const
+	{
+		double aCost = a.cost * b.removed;
+		double bCost = b.cost * a.removed;
+		if (aCost != bCost)
+		{
+			return aCost > bCost;
+		}
+		if (a.band != b.band)
+		{
+			return a.band > b.band;
+		}
+		return a.mergeBelow && !b.mergeBelow;
+	}
+};
+typedef vector<SimplifyJoin> SimplifyJoinHeap;
+static inline void PushJoin(SimplifyJoinHeap& heap, const SimplifyJoin& join)
+{
+	heap.push_back(join);
+	std::push_heap(heap.begin(), heap.end(), SimplifyJoinWorse());
+}
+
+//Adds the join of a band with the band below it to the heap
+static void AddMergeJoin(const vector<SimplifyBand>& bands, size_t index, SimplifyJoinHeap& joins, vector<RECT>& mergedSpans)
+{
+	const SimplifyBand& band = bands[index];
+	if (band.below == SIZE_MAX)
+	{
+		return;
+	}
+	const SimplifyBand& below = bands[band.below];
+	double mergedWidth;
+	double cost = MergeBandsCost(band, below, mergedSpans, mergedWidth);
+	size_t removed = band.spans.size() + below.spans.size() - mergedSpans.size();
+	if (removed == 0)
+	{
+		//None of the spans overlap, so joining the bands only helps if a gap in the joined band is filled in too
+		size_t j = FindNarrowestGap(mergedSpans);
+		cost += ((double)mergedSpans[j + 1].left - mergedSpans[j].right) * ((double)below.bottom - band.top);
+		removed = 1;
+	}
+	SimplifyJoin join = { cost, removed, index, true, band.version, below.version };
+	PushJoin(joins, join);
+}
+//Adds the joins of a band to the heap: filling its narrowest gap, and joining it with the band below it
+static void AddBandJoins(const vector<SimplifyBand>& bands, size_t index, SimplifyJoinHeap& joins, vector<RECT>& mergedSpans)
+{
+	const SimplifyBand& band = bands[index];
+	if (band.spans.size() >= 2)
+	{
+		size_t j = FindNarrowestGap(band.spans);
+		double cost = ((double)band.spans[j + 1].left - band.spans[j].right) * ((double)band.bottom - band.top);
+		SimplifyJoin join = { cost, 1, index, false, band.version, 0 };
+		PushJoin(joins, join);
+	}
+	AddMergeJoin(bands, index, joins, mergedSpans);
+}
+
+//Greedily joins spans within a band (filling the gap between them) and neighboring bands (filling everything between them),
+//always picking the join which adds the least area per rectangle removed, until there are at most maxRects rectangles
+//or the next join would add more than maxWaste in total.  Result vector receives the banded result, a superset of the input.
+//The possible joins are kept in a heap, and only the joins of the bands next to a join are worked out again after it.
+static void SimplifyRects(const RECT* pRects, size_t count, size_t maxRects, double maxWaste, RegionRectList& result, RECT& bounds)
+{
+	vector<SimplifyBand> bands;
+	const RECT* pEnd = pRects + count;
+	for (const RECT* pBand = pRects; pBand != pEnd; )
+	{
+		const RECT* pBandEnd = BandEnd(pBand, pEnd);
+		SimplifyBand band;
+		band.top = pBand->top;
+		band.bottom = pBand->bottom;
+		band.spans.assign(pBand, pBandEnd);
+		band.width = 0;
+		for (const RECT* pRect = pBand; pRect != pBandEnd; pRect++)
+		{
+			band.width += (double)pRect->right - pRect->left;
+		}
+		band.above = bands.empty() ? SIZE_MAX : bands.size() - 1;
+		band.below = pBandEnd != pEnd ? bands.size() + 1 : SIZE_MAX;
+		band.version = 0;
+		bands.push_back(band);
+		pBand = pBandEnd;
+	}
+
+	vector<RECT> mergedSpans;
+	SimplifyJoinHeap joins;
+	joins.reserve(bands.size() * 2);
+	for (size_t i = 0; i < bands.size(); i++)
+	{
+		AddBandJoins(bands, i, joins, mergedSpans);
+	}
+	double waste = 0;
+	while (count > maxRects && !joins.empty())
+	{
+		SimplifyJoin join = joins.front();
+		std::pop_heap(joins.begin(), joins.end(), SimplifyJoinWorse());
+		joins.pop_back();
+		SimplifyBand& band = bands[join.band];
+		if (join.version != band.version || (join.mergeBelow && (band.below == SIZE_MAX || bands[band.below].version != join.belowVersion)))
+		{
+			//One of its bands changed since the join was worked out (a newer join was added then)
+			continue;
+		}
+		if (waste + join.cost > maxWaste)
+		{
+			break;
+		}
+		waste += join.cost;
+		count -= join.removed;
+		if (!join.mergeBelow)
+		{
+			FillGap(band, FindNarrowestGap(band.spans));
+		}
+		else
+		{
+			SimplifyBand& below = bands[band.below];
+			double mergedWidth;
+			MergeBandsCost(band, below, mergedSpans, mergedWidth);
+			size_t spanCount = band.spans.size() + below.spans.size();
+			band.bottom = below.bottom;
+			band.spans.swap(mergedSpans);
+			band.width = mergedWidth;
+			band.below = below.below;
+			if (band.below != SIZE_MAX)
+			{
+				bands[band.below].above = join.band;
+			}
+			below.version++;
+			vector<RECT>().swap(below.spans);
+			if (band.spans.size() == spanCount)
+			{
+				FillGap(band, FindNarrowestGap(band.spans));
+			}
+		}
+		band.version++;
+		AddBandJoins(bands, join.band, joins, mergedSpans);
+		if (band.above != SIZE_MAX)
+		{
+			AddMergeJoin(bands, band.above, joins, mergedSpans);
+		}
+	}
+
+	result.Clear();
+	result.Reserve(count);
+	BandBuilder builder(result, bounds);
+	for (size_t i = bands.empty() ? SIZE_MAX : 0; i != SIZE_MAX; i = bands[i].below)
+	{
+		builder.BeginBand(bands[i].top, bands[i].bottom);
+		for (size_t j = 0; j < bands[i].spans.size(); j++)
+		{
+			builder.AddSpan(bands[i].spans[j].left, bands[i].spans[j].right);
+		}
+		builder.EndBand();
+	}
+}
+
+//Header in front of the rectangles in allocated rectangle storage
+struct RegionRectBlock
+{
+	//Arena the block came from, or NULL if it came from the heap
+	RegionArena* pArena;
+	//Whether the header below is up to date (one of the HeaderState values)
+	std::atomic<int> headerState;
+	//Number of RegionRectList objects sharing the block (copies share storage until one of them is modified)
+	std::atomic<long> refCount;
+	//Region data header for the rectangles, the rectangles follow directly after it
+	RGNDATAHEADER header;
+};
+static_assert(sizeof(RegionRectBlock) == offsetof(RegionRectBlock, header) + sizeof(RGNDATAHEADER), "rectangles must directly follow the header");
+
+//States of RegionRectBlock::headerState
+enum HeaderState
+{
+	//Header needs to be written
+	HEADER_STALE,
+	//Another thread is writing the header
+	HEADER_WRITING,
+	//Header is up to date
+	HEADER_READY,
+};
+
+//Fills in a region data header for a list of rectangles
+static void FillDataHeader(RGNDATAHEADER& header, size_t count, const RECT& bounds)
+{
+	header.dwSize = sizeof(RGNDATAHEADER);
+	header.iType = RDH_RECTANGLES;
+	header.nCount = (DWORD)count;
+	header.nRgnSize = (DWORD)(sizeof(RECT) * count);
+	header.rcBound = bounds;
+}
+
+//Returns the header of allocated rectangle storage
+static inline RegionRectBlock* GetRectBlock(const RECT* pRects)
+{
+	return ((RegionRectBlock*)pRects) - 1;
+}
+//Allocates storage for rectangles from an arena, or from the heap if pArena is NULL
+static RECT* AllocateRects(RegionArena* pArena, size_t capacity)
+{
+	size_t size = sizeof(RegionRectBlock) + sizeof(RECT) * capacity;
+	void* pMemory = pArena != NULL ? pArena->Allocate(size) : ::operator new(size);
+	RegionRectBlock* pBlock = new (pMemory) RegionRectBlock;
+	pBlock->pArena = pArena;
+	pBlock->refCount.store(1, std::memory_order_relaxed);
+	pBlock->headerState.store(HEADER_STALE, std::memory_order_relaxed);
+	return (RECT*)(pBlock + 1);
+}
+//Releases one reference to storage from AllocateRects, and returns it to wherever it came from once nothing is using it
+static void FreeRects(RECT* pRects)
+{
+	RegionRectBlock* pBlock = GetRectBlock(pRects);
+	if (pBlock->refCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+	{
+		return;
+	}
+	RegionArena* pArena = pBlock->pArena;
+	pBlock->~RegionRectBlock();
+	if (pArena != NULL)
+	{
+		pArena->Free(pBlock);
+	}
+	else
+	{
+		::operator delete(pBlock);
+	}
+}
+
+RegionRectList::RegionRectList()
+{
+	pRects = inlineRects;
+	pArena = RegionArena::GetCurrent();
+	count = 0;
+	capacity = REGION_INLINE_RECT_COUNT;
+}
+RegionRectList::RegionRectList(RegionArena* pArena)
+{
+	pRects = inlineRects;
+	this->pArena = pArena;
+	count = 0;
+	capacity = REGION_INLINE_RECT_COUNT;
+}
+RegionRectList::RegionRectList(const RegionRectList& other)
+{
+	pRects = inlineRects;
+	pArena = RegionArena::GetCurrent();
+	count = 0;
+	capacity = REGION_INLINE_RECT_COUNT;
+	CopyFrom(other);
+}
+RegionRectList::~RegionRectList()
+{
+	FreeMemory();
+}
+RegionRectList& RegionRectList::operator=(const RegionRectList& other)
+{
+	if (this != &other)
+	{
+		CopyFrom(other);
+	}
+	return *this;
+}
+bool RegionRectList::CanUseMemoryOf(const RegionRectList& other) const
+{
+	if (other.IsInline())
+	{
+		return true;
+	}
+	RegionArena* pOtherArena = GetRectBlock(other.pRects)->pArena;
+	return pOtherArena == NULL || pOtherArena == this->pArena;
+}
+void RegionRectList::CopyFrom(const RegionRectList& other)
+{
+	if (!other.IsInline() && CanUseMemoryOf(other))
+	{
+		GetRectBlock(other.pRects)->refCount.fetch_add(1, std::memory_order_relaxed);
+		FreeMemory();
+		this->pRects = other.pRects;
+		this->count = other.count;
+		this->capacity = other.capacity;
+		return;
+	}
+	Assign(other.pRects, other.count);
+}
+RegionArena* RegionRectList::GetArena() const
+{
+	return pArena;
+}
+bool RegionRectList::IsInline() const
+{
+	return pRects == inlineRects;
+}
+bool RegionRectList::IsShared() const
+{
+	return !IsInline() && GetRectBlock(pRects)->refCount.load(std::memory_order_acquire) != 1;
+}
+void RegionRectList::MakeUnique()
+{
+	//Reserving storage makes a private copy of shared storage
+	Reserve(count);
+	//The caller is about to change the rectangles
+	if (!IsInline())
+	{
+		GetRectBlock(pRects)->headerState.store(HEADER_STALE, std::memory_order_relaxed);
+	}
+}
+void RegionRectList::FreeMemory()
+{
+	if (!IsInline())
+	{
+		FreeRects(pRects);
+		pRects = inlineRects;
+		capacity = REGION_INLINE_RECT_COUNT;
+	}
+}
+size_t RegionRectList::Count() const
+{
+	return count;
+}
+RECT* RegionRectList::Data()
+{
+	MakeUnique();
+	return pRects;
+}
+const RECT* RegionRectList::Data() const
+{
+	return pRects;
+}
+RECT& RegionRectList::operator[](size_t index)
+{
+	MakeUnique();
+	return pRects[index];
+}
+const RECT& RegionRectList::operator[](size_t index) const
+{
+	return pRects[index];
+}
+void RegionRectList::Reserve(size_t newCapacity)
+{
+	if (newCapacity <= capacity)
+	{
+		if (!IsShared())
+		{
+			return;
+		}
+		//Shared storage must be copied before it can be modified
+		newCapacity = capacity;
+	}
+	else
+	{
+		newCapacity = max(newCapacity, capacity * 2);
+	}
+	RECT* pNewRects = AllocateRects(pArena, newCapacity);
+	if (count > 0)
+	{
+		memcpy(pNewRects, pRects, sizeof(RECT) * count);
+	}
+	FreeMemory();
+	pRects = pNewRects;
+	capacity = newCapacity;
+}
+void RegionRectList::Add(const RECT& rect)
+{
+	if (count == capacity)
+	{
+		Reserve(count + 1);
+	}
+	MakeUnique();
+	pRects[count] = rect;
+	count++;
+}
+RECT* RegionRectList::Resize(size_t newCount)
+{
+	Reserve(newCount);
+	MakeUnique();
+	count = newCount;
+	return pRects;
+}
+void RegionRectList::Truncate(size_t newCount)
+{
+	if (newCount < count)
+	{
+		MakeUnique();
+		count = newCount;
+	}
+}
+void RegionRectList::MakeWritable()
+{
+	MakeUnique();
+}
+RECT* RegionRectList::WritableData()
+{
+	assert(!IsShared());
+	return pRects;
+}
+void RegionRectList::AddWritable(const RECT& rect)
+{
+	assert(!IsShared());
+	if (count == capacity)
+	{
+		//Growing moves the rectangles to new (unshared) storage
+		Reserve(count + 1);
+	}
+	pRects[count] = rect;
+	count++;
+}
+void RegionRectList::TruncateWritable(size_t newCount)
+{
+	assert(!IsShared());
+	if (newCount < count)
+	{
+		count = newCount;
+	}
+}
+void RegionRectList::Clear()
+{
+	//Let go of shared storage rather than keeping it for later
+	if (IsShared())
+	{
+		FreeMemory();
+	}
+	else if (!IsInline())
+	{
+		GetRectBlock(pRects)->headerState.store(HEADER_STALE, std::memory_order_relaxed);
+	}
+	count = 0;
+}
+void RegionRectList::Assign(const RECT* pOtherRects, size_t otherCount)
+{
+	//Clearing first means shared storage is let go of instead of copied
+	Clear();
+	Reserve(otherCount);
+	if (otherCount > 0)
+	{
+		memcpy(pRects, pOtherRects, sizeof(RECT) * otherCount);
+	}
+	count = otherCount;
+}
+void RegionRectList::Swap(RegionRectList& other)
+{
+	if (!this->CanUseMemoryOf(other) || !other.CanUseMemoryOf(*this))
+	{
+		//Copy the rectangles across instead (sharing memory where the arenas allow it), then swap lists which use the same arena
+		RegionRectList temp(other.pArena);
+		temp.CopyFrom(*this);
+		this->CopyFrom(other);
+		other.Swap(temp);
+		return;
+	}
+	if (!this->IsInline() && !other.IsInline())
+	{
+		std::swap(this->pRects, other.pRects);
+	}
+	else if (this->IsInline() && other.IsInline())
+	{
+		size_t swapCount = max(this->count, other.count);
+		for (size_t i = 0; i < swapCount; i++)
+		{
+			std::swap(this->inlineRects[i], other.inlineRects[i]);
+		}
+	}
+	else
+	{
+		//One list is inline and the other has allocated memory: the inline rectangles move to the other object's inline storage
+		RegionRectList& inlineList = this->IsInline() ? *this : other;
+		RegionRectList& allocatedList = this->IsInline() ? other : *this;
+		if (inlineList.count > 0)
+		{
+			memcpy(allocatedList.inlineRects, inlineList.inlineRects, sizeof(RECT) * inlineList.count);
+		}
+		inlineList.pRects = allocatedList.pRects;
+		allocatedList.pRects = allocatedList.inlineRects;
+	}
+	std::swap(this->count, other.count);
+	std::swap(this->capacity, other.capacity);
+}
+void RegionRectList::UpdateDataHeader(const RECT& bounds)
+{
+	static_assert(offsetof(RegionRectList, inlineRects) == offsetof(RegionRectList, inlineHeader) + sizeof(RGNDATAHEADER), "inlineRects must directly follow inlineHeader");
+	//Allocated storage can be shared with other lists, so its header is written by GetDataHeader instead
+	if (IsInline())
+	{
+		FillDataHeader(inlineHeader, count, bounds);
+	}
+}
+const RGNDATAHEADER* RegionRectList::GetDataHeader(const RECT& bounds) const
+{
+	if (IsInline())
+	{
+		//(written by UpdateDataHeader, so reading it from several threads is safe)
+		assert(inlineHeader.nCount == count && memcmp(&inlineHeader.rcBound, &bounds, sizeof(RECT)) == 0);
+		return &inlineHeader;
+	}
+	//Allocated storage can be shared with lists on other threads, so only one thread writes the header
+	RegionRectBlock* pBlock = GetRectBlock(pRects);
+	int state = pBlock->headerState.load(std::memory_order_acquire);
+	while (state != HEADER_READY)
+	{
+		if (state == HEADER_STALE && pBlock->headerState.compare_exchange_weak(state, HEADER_WRITING, std::memory_order_acquire))
+		{
+			FillDataHeader(pBlock->header, count, bounds);
+			pBlock->headerState.store(HEADER_READY, std::memory_order_release);
+			break;
+		}
+		state = pBlock->headerState.load(std::memory_order_acquire);
+	}
+	return &pBlock->header;
+}
+void RegionRectList::SetRectDataHeader(const RECT& rect, size_t rectCount)
+{
+	FillDataHeader(inlineHeader, rectCount, rect);
+	if (rectCount > 0)
+	{
+		inlineRects[0] = rect;
+	}
+}
+const RGNDATAHEADER* RegionRectList::GetRectDataHeader() const
+{
+	return &inlineHeader;
+}
+
+Region::Region()
+{
+	Region_Initialize();
+}
+
+Region::~Region()
+{
+	REGION_TRACE_DESTROY(*this);
+}
+
+DWORD Region::GetRegionType() const
+{
+	return this->regionType;
+}
+int64_t Region::GetArea() const
+{
+	if (this->regionType == SIMPLEREGION)
+	{
+		return RectArea(boundingBox);
+	}
+	return this->regionType == COMPLEXREGION ? area : 0;
+}
+size_t Region::GetRectCount() const
+{
+	if (this->regionType == SIMPLEREGION)
+	{
+		return 1;
+	}
+	return this->regionType == COMPLEXREGION ? rects.Count() : 0;
+}
+size_t Region::GetBandCount() const
+{
+	if (this->regionType == SIMPLEREGION)
+	{
+		return 1;
+	}
+	return this->regionType == COMPLEXREGION ? bandCount : 0;
+}
+uint64_t Region::GetHash() const
+{
+	if (this->regionType == SIMPLEREGION)
+	{
+		return HashRect(HashSeed, boundingBox);
+	}
+	return this->regionType == COMPLEXREGION ? hash : HashSeed;
+}
+
+const RECT& Region::GetBoundingBox() const
+{
+	return boundingBox;
+}
+void Region::GetBoundingBox(RECT* pRect) const
+{
+	*pRect = boundingBox;
+}
+void Region::GetBoundingBox(RECT& rect) const
+{
+	rect = boundingBox;
+}
+void Region::GetBoundingBox(int& x, int& y, int& w, int& h) const
+{
+	x = boundingBox.left;
+	y = boundingBox.top;
+	//Width and height which don't fit in an int are cut off at the largest int
+	w = (int)min<int64_t>(INT_MAX, (int64_t)boundingBox.right - boundingBox.left);
+	h = (int)min<int64_t>(INT_MAX, (int64_t)boundingBox.bottom - boundingBox.top);
+}
+
+void Region::Clear()
+{
+	REGION_TRACE(REGION_TRACE_CLEAR, *this);
+	boundingBox = {};
+	this->regionType = NULLREGION;
+	UpdateDataHeader();
+}
+
+void Region::BecomeRectangle(int left, int top, int right, int bottom)
+{
+	if (left >= right || top >= bottom)
+	{
+		Clear();
+		return;
+	}
+	boundingBox.left = left;
+	boundingBox.top = top;
+	boundingBox.right = right;
+	boundingBox.bottom = bottom;
+	this->regionType = SIMPLEREGION;
+	UpdateDataHeader();
+}
+void Region::BecomeRectangle(const RECT& rect)
+{
+	BecomeRectangle(rect.left, rect.top, rect.right, rect.bottom);
+}
+void Region::BecomeRects(RegionRectList& result, const RECT& bounds)
+{
+	size_t count = result.Count();
+	if (count == 0)
+	{
+		Clear();
+	}
+	else if (count == 1)
+	{
+		BecomeRectangle(result[0]);
+	}
+	else
+	{
+		if (this->regionType != COMPLEXREGION)
+		{
+			REGION_STATS_COUNT(REGION_STAT_BECAME_COMPLEX);
+		}
+		this->rects.Swap(result);
+		this->regionType = COMPLEXREGION;
+		this->boundingBox = bounds;
+		UpdateSummary();
+	}
+}
+void Region::UpdateSummary()
+{
+	//(reads through a const reference, so a list shared with another region isn't copied)
+	const RegionRectList& list = this->rects;
+	const RECT* pRects = list.Data();
+	size_t count = list.Count();
+	int64_t newArea = 0;
+	size_t newBandCount = 0;
+	uint64_t newHash = HashSeed;
+	for (size_t i = 0; i < count; i++)
+	{
+		const RECT& rect = pRects[i];
+		if (i == 0 || rect.top != pRects[i - 1].top)
+		{
+			newBandCount++;
+		}
+		int64_t rectArea = RectArea(rect);
+		newArea = rectArea > AreaMax - newArea ? AreaMax : newArea + rectArea;
+		newHash = HashRect(newHash, rect);
+	}
+	this->area = newArea;
+	this->bandCount = newBandCount;
+	this->hash = newHash;
+	UpdateDataHeader();
+}
+void Region::UpdateDataHeader()
+{
+	if (this->regionType == COMPLEXREGION)
+	{
+		rects.UpdateDataHeader(this->boundingBox);
+	}
+	else
+	{
+		//The list isn't in use, so the inline storage holds the header and the rectangle
+		rects.SetRectDataHeader(this->boundingBox, this->regionType == SIMPLEREGION ? 1 : 0);
+	}
+}
+void Region::UnionBoundingBox(const RECT& rect)
+{
+	boundingBox.left = min(boundingBox.left, rect.left);
+	boundingBox.top = min(boundingBox.top, rect.top);
+	boundingBox.right = max(boundingBox.right, rect.right);
+	boundingBox.bottom = max(boundingBox.bottom, rect.bottom);
+}
+void Region::IntersectBoundingbox(const RECT& rect)
+{
+	boundingBox.left = max(boundingBox.left, rect.left);
+	boundingBox.top = max(boundingBox.top, rect.top);
+	boundingBox.right = min(boundingBox.right, rect.right);
+	boundingBox.bottom = min(boundingBox.bottom, rect.bottom);
+}
+
+const RECT* Region::GetRectPointer(size_t& count) const
+{
+	if (this->regionType == COMPLEXREGION)
+	{
+		count = rects.Count();
+		return rects.Data();
+	}
+	count = this->regionType == SIMPLEREGION ? 1 : 0;
+	return &boundingBox;
+}
+
+void Region::CombineWith(const RECT* pOtherRects, size_t otherCount, int operation)
+{
+	size_t count;
+	const RECT* pRects = GetRectPointer(count);
+	RegionRectList result(rects.GetArena());
+	RECT bounds;
+	CombineRects(pRects, count, pOtherRects, otherCount, operation, result, bounds);
+	REGION_STATS_COUNT(REGION_STAT_COMPLEX_OP);
+	REGION_STATS_ADD(REGION_STAT_COMPLEX_OP_INPUT_RECTS, count + otherCount);
+	REGION_STATS_ADD(REGION_STAT_COMPLEX_OP_OUTPUT_RECTS, result.Count());
+	BecomeRects(result, bounds);
+}
+
+void Region::ClipToRect(const RECT& clip)
+{
+	size_t count;
+	const RECT* pRects = GetRectPointer(count);
+	const RECT* pEnd = pRects + count;
+	//Only bands which overlap the rectangle vertically are kept, the rest don't need to be looked at
+	const RECT* pFirst = FindBand(pRects, pEnd, clip.top);
+	const RECT* pLast = std::upper_bound(pFirst, pEnd, clip.bottom - 1, CoordinateAboveTop<RECT>);
+	RegionRectList result(rects.GetArena());
+	RECT* pResult = result.Resize(pLast - pFirst);
+	RECT bounds;
+	size_t resultCount = RegionSimd::ClipRects(pFirst, pLast - pFirst, clip, pResult, bounds);
+	result.Truncate(CoalesceBands(pResult, resultCount));
+	REGION_STATS_COUNT(REGION_STAT_CLIP);
+	REGION_STATS_ADD(REGION_STAT_CLIP_INPUT_RECTS, count);
+	BecomeRects(result, bounds);
+}
+
+void Region::UnionRectWithRect(const RECT& other)
+{
+	//only called when we know that this region is currently a rectangle
+	const RECT& me = this->boundingBox;
+
+	//Do we cover up the other?
+	if (RectCoversUpOther(me, other))
+	{
+		//no assignments needed
+		REGION_STATS_COUNT(REGION_STAT_COVERS_UP);
+		return;
+	}
+
+	//Does the other cover up us?
+	if (RectCoversUpOther(other, me))
+	{
+		REGION_STATS_COUNT(REGION_STAT_COVERS_UP);
+		BecomeRectangle(other);
+		return;
+	}
+
+	//Check if we are aligned vertically or horizontally and overlapping
+	if (RectUnionIsRect(me, other))
+	{
+		REGION_STATS_COUNT(REGION_STAT_ALIGNED_MERGE);
+		BecomeRectangle(RectUnion(me, other));
+		return;
+	}
+	UnionRectWithRectBecomeComplex(other);
+}
+
+void Region::UnionRectWithRectBecomeComplex(const RECT& other)
+{
+	CombineWith(&other, 1, COMBINE_OR);
+}
+
+void Region::UnionWith(const RECT& other)
+{
+	REGION_STATS_TIME(REGION_STAT_UNION_RECT);
+	REGION_TRACE(REGION_TRACE_UNION_RECT, *this, other);
+	if (RectIsEmpty(other))
+	{
+		//Adding nothing
+		REGION_STATS_COUNT(REGION_STAT_NULL_SHORTCUT);
+		return;
+	}
+	if (regionType == NULLREGION)
+	{
+		//We are a null region, become the other rectangle
+		REGION_STATS_COUNT(REGION_STAT_NULL_SHORTCUT);
+		BecomeRectangle(other);
+	}
+	else if (regionType == SIMPLEREGION)
+	{
+		//We are a rectangle
+		UnionRectWithRect(other);
+	}
+	else if (regionType == COMPLEXREGION)
+	{
+		//Does the other cover up us?
+		if (RectCoversUpOther(other, this->boundingBox))
+		{
+			REGION_STATS_COUNT(REGION_STAT_COVERS_UP);
+			BecomeRectangle(other);
+			return;
+		}
+		UnionRectWithRectBecomeComplex(other);
+	}
+}
+void Region::UnionWith(const RECT* pRect)
+{
+	UnionWith(*pRect);
+}
+void Region::UnionWith(const RECT* pRects, size_t count)
+{
+	REGION_STATS_TIME(REGION_STAT_UNION_RECTS);
+	REGION_TRACE(REGION_TRACE_UNION_RECTS, *this, pRects, count);
+	if (count == 1)
+	{
+		UnionWith(pRects[0]);
+		return;
+	}
+	RegionRectList result(rects.GetArena());
+	RECT bounds;
+	BuildRectsUnion(pRects, count, result, bounds);
+	REGION_STATS_COUNT(REGION_STAT_COMPLEX_OP);
+	REGION_STATS_ADD(REGION_STAT_COMPLEX_OP_INPUT_RECTS, count);
+	REGION_STATS_ADD(REGION_STAT_COMPLEX_OP_OUTPUT_RECTS, result.Count());
+	if (result.Count() <= 1)
+	{
+		//Nothing to add, or a single rectangle which can use the rectangle fast paths
+		if (result.Count() == 1) UnionWith(result[0]);
+		return;
+	}
+	if (this->regionType == NULLREGION)
+	{
+		BecomeRects(result, bounds);
+		return;
+	}
+	//if we cover up all the rectangles, nothing to do for union operation
+	if (this->regionType == SIMPLEREGION && RectCoversUpOther(boundingBox, bounds))
+	{
+		REGION_STATS_COUNT(REGION_STAT_COVERS_UP);
+		return;
+	}
+	CombineWith(result.Data(), result.Count(), COMBINE_OR);
+}
+
+void Region::BecomeRegion(const Region& region)
+{
+	if (region.regionType == SIMPLEREGION)
+	{
+		BecomeRectangle(region.boundingBox);
+	}
+	else if (region.regionType == COMPLEXREGION)
+	{
+		if (this->regionType != COMPLEXREGION)
+		{
+			REGION_STATS_COUNT(REGION_STAT_BECAME_COMPLEX);
+		}
+		this->rects = region.rects;
+		this->boundingBox = region.boundingBox;
+		this->regionType = COMPLEXREGION;
+		this->area = region.area;
+		this->bandCount = region.bandCount;
+		this->hash = region.hash;
+		UpdateDataHeader();
+	}
+	else if (region.regionType == NULLREGION)
+	{
+		Clear();
+	}
+}
+
+void Region::UnionWith(const Region& region)
+{
+	REGION_STATS_TIME(REGION_STAT_UNION_REGION);
+	REGION_TRACE(REGION_TRACE_UNION_REGION, *this, region);
+	if (region.regionType == SIMPLEREGION)
+	{
+		UnionWith(region.boundingBox);
+	}
+	else if (region.regionType == COMPLEXREGION)
+	{
+		//if we cover up the other region, nothing to do for union operation
+		if (this->regionType == SIMPLEREGION && RectCoversUpOther(boundingBox, region.boundingBox))
+		{
+			REGION_STATS_COUNT(REGION_STAT_COVERS_UP);
+			return;
+		}
+		if (this->regionType == NULLREGION)
+		{
+			REGION_STATS_COUNT(REGION_STAT_NULL_SHORTCUT);
+			BecomeRegion(region);
+			return;
+		}
+		CombineWith(region.rects.Data(), region.rects.Count(), COMBINE_OR);
+	}
+}
+#if REGION_USE_WIN32
+bool Region::BecomeHrgn(HRGN hrgn)
+{
+	REGION_STATS_COUNT(REGION_STAT_HRGN_CONVERSION);
+	DWORD size = ::GetRegionData(hrgn, 0, NULL);
+	if (size < sizeof(RGNDATAHEADER))
+	{
+		return false;
+	}
+	vector<byte> bytes(size);
+	if (!::GetRegionData(hrgn, size, (LPRGNDATA)&bytes[0]))
+	{
+		return false;
+	}
+	const RGNDATAHEADER& header = *((const RGNDATAHEADER*)(&bytes[0]));
+	if (header.iType != RDH_RECTANGLES || header.dwSize < sizeof(RGNDATAHEADER) || header.dwSize + (size_t)header.nCount * sizeof(RECT) > size)
+	{
+		return false;
+	}
+	//GDI regions are already y-x banded, running them through the sweep merges any bands that can be merged
+	const RECT* pRects = (const RECT*)(&bytes[0] + header.dwSize);
+	RegionRectList result(rects.GetArena());
+	RECT bounds;
+	CombineRects(pRects, header.nCount, NULL, 0, COMBINE_OR, result, bounds);
+	BecomeRects(result, bounds);
+	return true;
+}
+void Region::UnionWith(HRGN hrgn)
+{
+	Region other;
+	//Check if provided HRGN was invalid
+	if (!other.BecomeHrgn(hrgn))
+	{
+		Clear();
+		return;
+	}
+	UnionWith(other);
+}
+#endif
+void Region::UnionWith(int x, int y, int w, int h)
+{
+	RECT rect = RectFromSize(x, y, w, h);
 	UnionWith(rect);
 }
-void Region::IntersectWith(const RECT& other)
+void Region::IntersectWith(const RECT& other)
+{
+	REGION_STATS_TIME(REGION_STAT_INTERSECT_RECT);
+	REGION_TRACE(REGION_TRACE_INTERSECT_RECT, *this, other);
+	//are we a rectangle?
+	if (this->regionType == SIMPLEREGION)
+	{
+		const RECT& me = boundingBox;
+		//If other covers up us, no assignments needed
+		if (RectCoversUpOther(other, me))
+		{
+			REGION_STATS_COUNT(REGION_STAT_COVERS_UP);
+			return;
+		}
+		REGION_STATS_COUNT(REGION_STAT_RECT_INTERSECT);
+		IntersectBoundingbox(other);
+		//Compare the edges, the width or height of a huge rectangle may not fit in an int
+		if (RectIsEmpty(me)) Clear();
+		else UpdateDataHeader();
+	}
+	//are we complex?
+	else if (this->regionType == COMPLEXREGION)
+	{
+		if (RectCoversUpOther(other, boundingBox))
+		{
+			REGION_STATS_COUNT(REGION_STAT_COVERS_UP);
+			return;
+		}
+		if (RectIsEmpty(other) || !RectOverlaps(other, boundingBox))
+		{
+			REGION_STATS_COUNT(REGION_STAT_NULL_SHORTCUT);
+			Clear();
+			return;
+		}
+		ClipToRect(other);
+	}
+	//are we empty?
+	else if (this->regionType == NULLREGION)
+	{
+		//already null, intersection will be nothing
+		REGION_STATS_COUNT(REGION_STAT_NULL_SHORTCUT);
+	}
+}
+void Region::IntersectWith(const RECT* pRect)
+{
+	IntersectWith(*pRect);
+}
+void Region::IntersectWith(const Region& otherRegion)
+{
+	REGION_STATS_TIME(REGION_STAT_INTERSECT_REGION);
+	REGION_TRACE(REGION_TRACE_INTERSECT_REGION, *this, otherRegion);
+	if (otherRegion.regionType == SIMPLEREGION)
+	{
+		IntersectWith(otherRegion.boundingBox);
+	}
+	else if (otherRegion.regionType == COMPLEXREGION)
+	{
+		if (this->regionType == NULLREGION)
+		{
+			REGION_STATS_COUNT(REGION_STAT_NULL_SHORTCUT);
+			return;
+		}
+		if (!RectOverlaps(this->boundingBox, otherRegion.boundingBox))
+		{
+			REGION_STATS_COUNT(REGION_STAT_NULL_SHORTCUT);
+			Clear();
+			return;
+		}
+		//if we are a rectangle which covers up the other region, the intersection is the other region
+		if (this->regionType == SIMPLEREGION && RectCoversUpOther(this->boundingBox, otherRegion.boundingBox))
+		{
+			REGION_STATS_COUNT(REGION_STAT_COVERS_UP);
+			BecomeRegion(otherRegion);
+			return;
+		}
+		//a rectangle clips the other region
+		if (this->regionType == SIMPLEREGION)
+		{
+			RECT clip = this->boundingBox;
+			BecomeRegion(otherRegion);
+			ClipToRect(clip);
+			return;
+		}
+		CombineWith(otherRegion.rects.Data(), otherRegion.rects.Count(), COMBINE_AND);
+	}
+	else if (otherRegion.regionType == NULLREGION)
+	{
+		REGION_STATS_COUNT(REGION_STAT_NULL_SHORTCUT);
+		Clear();
+	}
+}
+#if REGION_USE_WIN32
+void Region::IntersectWith(HRGN other)
+{
+	if (this->regionType == NULLREGION)
+	{
+		return;
+	}
+	Region otherRegion;
+	//check if provided HRGN was invalid
+	if (!otherRegion.BecomeHrgn(other))
+	{
+		Clear();
+		return;
+	}
+	IntersectWith(otherRegion);
+}
+#endif
+void Region::IntersectWith(int x, int y, int w, int h)
+{
+	RECT rect = RectFromSize(x, y, w, h);
+	IntersectWith(rect);
+}
+
+void Region::SubtractRectFromRect(const RECT& other)
+{
+	//only called when we know that this region is currently a rectangle, and the other rectangle overlaps without covering us up
+	const RECT& me = this->boundingBox;
+
+	//Does the other cut across our entire width?  Then what remains is above and/or below it.
+	if (other.left <= me.left && other.right >= me.right)
+	{
+		if (other.top <= me.top)
+		{
+			REGION_STATS_COUNT(REGION_STAT_ALIGNED_CUT);
+			BecomeRectangle(me.left, other.bottom, me.right, me.bottom);
+			return;
+		}
+		if (other.bottom >= me.bottom)
+		{
+			REGION_STATS_COUNT(REGION_STAT_ALIGNED_CUT);
+			BecomeRectangle(me.left, me.top, me.right, other.top);
+			return;
+		}
+	}
+	//Does the other cut across our entire height?  Then what remains is left and/or right of it.
+	else if (other.top <= me.top && other.bottom >= me.bottom)
+	{
+		if (other.left <= me.left)
+		{
+			REGION_STATS_COUNT(REGION_STAT_ALIGNED_CUT);
+			BecomeRectangle(other.right, me.top, me.right, me.bottom);
+			return;
+		}
+		if (other.right >= me.right)
+		{
+			REGION_STATS_COUNT(REGION_STAT_ALIGNED_CUT);
+			BecomeRectangle(me.left, me.top, other.left, me.bottom);
+			return;
+		}
+	}
+	CombineWith(&other, 1, COMBINE_DIFF);
+}
+void Region::SubtractWith(const RECT& other)
+{
+	REGION_STATS_TIME(REGION_STAT_SUBTRACT_RECT);
+	REGION_TRACE(REGION_TRACE_SUBTRACT_RECT, *this, other);
+	if (this->regionType == NULLREGION || RectIsEmpty(other) || !RectOverlaps(other, boundingBox))
+	{
+		//Nothing to remove
+		REGION_STATS_COUNT(REGION_STAT_NULL_SHORTCUT);
+		return;
+	}
+	//Does the other cover up us?
+	if (RectCoversUpOther(other, boundingBox))
+	{
+		REGION_STATS_COUNT(REGION_STAT_COVERS_UP);
+		Clear();
+		return;
+	}
+	if (this->regionType == SIMPLEREGION)
+	{
+		SubtractRectFromRect(other);
+	}
+	else if (this->regionType == COMPLEXREGION)
+	{
+		CombineWith(&other, 1, COMBINE_DIFF);
+	}
+}
+void Region::SubtractWith(const RECT* pRect)
+{
+	SubtractWith(*pRect);
+}
+void Region::SubtractWith(const Region& otherRegion)
+{
+	REGION_STATS_TIME(REGION_STAT_SUBTRACT_REGION);
+	REGION_TRACE(REGION_TRACE_SUBTRACT_REGION, *this, otherRegion);
+	if (otherRegion.regionType == SIMPLEREGION)
+	{
+		SubtractWith(otherRegion.boundingBox);
+	}
+	else if (otherRegion.regionType == COMPLEXREGION)
+	{
+		if (this->regionType == NULLREGION || !RectOverlaps(this->boundingBox, otherRegion.boundingBox))
+		{
+			REGION_STATS_COUNT(REGION_STAT_NULL_SHORTCUT);
+			return;
+		}
+		if (this == &otherRegion)
+		{
+			Clear();
+			return;
+		}
+		CombineWith(otherRegion.rects.Data(), otherRegion.rects.Count(), COMBINE_DIFF);
+	}
+	else if (otherRegion.regionType == NULLREGION)
+	{
+		//Nothing to remove
+		REGION_STATS_COUNT(REGION_STAT_NULL_SHORTCUT);
+	}
+}
+#if REGION_USE_WIN32
+void Region::SubtractWith(HRGN other)
+{
+	Region otherRegion;
+	//check if provided HRGN was invalid
+	if (!otherRegion.BecomeHrgn(other))
+	{
+		Clear();
+		return;
+	}
+	SubtractWith(otherRegion);
+}
+#endif
+void Region::SubtractWith(int x, int y, int w, int h)
+{
+	RECT rect = RectFromSize(x, y, w, h);
+	SubtractWith(rect);
+}
+void Region::XorWith(const RECT& other)
+{
+	REGION_STATS_TIME(REGION_STAT_XOR_RECT);
+	REGION_TRACE(REGION_TRACE_XOR_RECT, *this, other);
+	if (RectIsEmpty(other))
+	{
+		//Nothing changes
+		REGION_STATS_COUNT(REGION_STAT_NULL_SHORTCUT);
+		return;
+	}
+	//If the rectangle doesn't overlap us, it's the same as a union
+	if (this->regionType == NULLREGION || !RectOverlaps(other, boundingBox))
+	{
+		UnionWith(other);
+		return;
+	}
+	if (this->regionType == SIMPLEREGION && RectEquals(other, boundingBox))
+	{
+		Clear();
+		return;
+	}
+	CombineWith(&other, 1, COMBINE_XOR);
+}
+void Region::XorWith(const RECT* pRect)
+{
+	XorWith(*pRect);
+}
+void Region::XorWith(const Region& otherRegion)
+{
+	REGION_STATS_TIME(REGION_STAT_XOR_REGION);
+	REGION_TRACE(REGION_TRACE_XOR_REGION, *this, otherRegion);
+	if (otherRegion.regionType == SIMPLEREGION)
+	{
+		XorWith(otherRegion.boundingBox);
+	}
+	else if (otherRegion.regionType == COMPLEXREGION)
+	{
+		//If the regions don't overlap, it's the same as a union
+		if (this->regionType == NULLREGION || !RectOverlaps(this->boundingBox, otherRegion.boundingBox))
+		{
+			UnionWith(otherRegion);
+			return;
+		}
+		if (this == &otherRegion)
+		{
+			Clear();
+			return;
+		}
+		CombineWith(otherRegion.rects.Data(), otherRegion.rects.Count(), COMBINE_XOR);
+	}
+	else if (otherRegion.regionType == NULLREGION)
+	{
+		//Nothing changes
+		REGION_STATS_COUNT(REGION_STAT_NULL_SHORTCUT);
+	}
+}
+#if REGION_USE_WIN32
+void Region::XorWith(HRGN other)
+{
+	Region otherRegion;
+	//check if provided HRGN was invalid
+	if (!otherRegion.BecomeHrgn(other))
+	{
+		Clear();
+		return;
+	}
+	XorWith(otherRegion);
+}
+#endif
+void Region::XorWith(int x, int y, int w, int h)
+{
+	RECT rect = RectFromSize(x, y, w, h);
+	XorWith(rect);
+}
+
+Region::Region(const Region& other)
+{
+	Region_Initialize();
+	REGION_TRACE(REGION_TRACE_COPY, *this, other);
+	BecomeRegion(other);
+}
+Region& Region::operator=(const Region& other)
+{
+	REGION_TRACE(REGION_TRACE_ASSIGN, *this, other);
+	BecomeRegion(other);
+	return *this;
+}
+Region& Region::operator=(const RECT& rect)
+{
+	REGION_TRACE(REGION_TRACE_ASSIGN_RECT, *this, rect);
+	BecomeRectangle(rect);
+	return *this;
+}
+Region& Region::operator=(const RECT* pRect)
+{
+	REGION_TRACE(REGION_TRACE_ASSIGN_RECT, *this, *pRect);
+	BecomeRectangle(*pRect);
+	return *this;
+}
+void Region::Swap(Region& other)
+{
+	REGION_TRACE(REGION_TRACE_SWAP, *this, other);
+	std::swap(this->boundingBox, other.boundingBox);
+	std::swap(this->regionType, other.regionType);
+	std::swap(this->area, other.area);
+	std::swap(this->bandCount, other.bandCount);
+	std::swap(this->hash, other.hash);
+	this->rects.Swap(other.rects);
+	this->UpdateDataHeader();
+	other.UpdateDataHeader();
+}
+
+Region::Region(const RECT& other)
+{
+	Region_Initialize();
+	BecomeRectangle(other);
+}
+Region::Region(const RECT* pOtherRect)
+{
+	Region_Initialize();
+	BecomeRectangle(*pOtherRect);
+}
+#if REGION_USE_WIN32
+Region::Region(HRGN otherRegion)
+{
+	Region_Initialize();
+	UnionWith(otherRegion);
+}
+#endif
+Region::Region(const RECT* pRects, size_t count)
+{
+	Region_Initialize();
+	UnionWith(pRects, count);
+}
+//Compact format written by Region::Serialize: the number of bands, then for each band
+//  top: the gap from the bottom of the band above (zigzag encoded distance from 0 for the first band)
+//  height - 1
+//  number of spans, or 0 if the band has the same spans as the band above (such as the rows of a grid, or lines of text), then nothing else
+//  left of the first span: zigzag encoded distance from the left of the first span of the band above
+//  width - 1 of the first span, then gap - 1 and width - 1 of each other span
+//All numbers are unsigned LEB128 varints.
+template <class Writer>
+static void WriteSerializedRects(const RECT* pRects, size_t count, Writer& writer)
+{
+	const RECT* pEnd = pRects + count;
+	size_t bandCount = 0;
+	for (const RECT* pBand = pRects; pBand != pEnd; pBand = BandEnd(pBand, pEnd))
+	{
+		bandCount++;
+	}
+	writer.Write(bandCount);
+	int64_t previousBottom = 0;
+	int64_t previousLeft = 0;
+	const RECT* pPreviousBand = NULL;
+	for (const RECT* pBand = pRects; pBand != pEnd; )
+	{
+		const RECT* pBandEnd = BandEnd(pBand, pEnd);
+		if (pBand == pRects)
+		{
+			writer.WriteSigned(pBand->top);
+		}
+		else
+		{
+			writer.Write(pBand->top - previousBottom);
+		}
+		writer.Write((int64_t)pBand->bottom - pBand->top - 1);
+		previousBottom = pBand->bottom;
+		if (pPreviousBand != NULL && pBand - pPreviousBand == pBandEnd - pBand && SameSpans(pPreviousBand, pBand, pBandEnd - pBand))
+		{
+			writer.Write(0);
+			pPreviousBand = pBand;
+			pBand = pBandEnd;
+			continue;
+		}
+		writer.Write(pBandEnd - pBand);
+		writer.WriteSigned(pBand->left - previousLeft);
+		writer.Write((int64_t)pBand->right - pBand->left - 1);
+		for (const RECT* pSpan = pBand + 1; pSpan != pBandEnd; pSpan++)
+		{
+			writer.Write((int64_t)pSpan->left - pSpan[-1].right - 1);
+			writer.Write((int64_t)pSpan->right - pSpan->left - 1);
+		}
+		previousLeft = pBand->left;
+		pPreviousBand = pBand;
+		pBand = pBandEnd;
+	}
+}
+
+//Writer for WriteSerializedRects which only counts the bytes
+struct SerializedSizeCounter
+{
+	size_t size;
+	SerializedSizeCounter() : size(0) {}
+	void Write(uint64_t value)
+	{
+		do
+		{
+			size++;
+			value >>= 7;
+		} while (value != 0);
+	}
+	void WriteSigned(int64_t value)
+	{
+		Write(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+	}
+};
+
+//Writer for WriteSerializedRects which writes the bytes
+struct SerializedWriter
+{
+	byte* p;
+	explicit SerializedWriter(byte* p) : p(p) {}
+	void Write(uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			*p++ = (byte)(value | 0x80);
+			value >>= 7;
+		}
+		*p++ = (byte)value;
+	}
+	void WriteSigned(int64_t value)
+	{
+		Write(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+	}
+};
+
+//Reads the numbers written by SerializedWriter, and remembers if the data was not valid
+struct SerializedReader
+{
+	const byte* p;
+	const byte* pEnd;
+	bool failed;
+	SerializedReader(const byte* p, const byte* pEnd) : p(p), pEnd(pEnd), failed(false) {}
+	//Reads an unsigned number, which must not be larger than the difference between two coordinates
+	int64_t Read()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 35; shift += 7)
+		{
+			if (p == pEnd)
+			{
+				break;
+			}
+			byte b = *p++;
+			value |= (uint64_t)(b & 0x7F) << shift;
+			if ((b & 0x80) == 0)
+			{
+				if (value > 0xFFFFFFFFu)
+				{
+					break;
+				}
+				return (int64_t)value;
+			}
+		}
+		failed = true;
+		return 0;
+	}
+	int64_t ReadSigned()
+	{
+		int64_t value = Read();
+		return (int64_t)((uint64_t)value >> 1) ^ -(value & 1);
+	}
+};
+
+//Returns true if a number read from serialized data is a valid coordinate
+static inline bool IsCoordinate(int64_t value)
+{
+	return value >= CoordinateMin && value <= CoordinateMax;
+}
+
+RegionSpanIterator::RegionSpanIterator()
+{
+	pRect = NULL;
+	pSpanBegin = NULL;
+	pSpanEnd = NULL;
+	pBandEnd = NULL;
+	pEnd = NULL;
+	clipLeft = 0;
+	clipRight = 0;
+	clipBottom = 0;
+	bandBottom = 0;
+	span.y = 0;
+	span.left = 0;
+	span.right = 0;
+}
+RegionSpanIterator::RegionSpanIterator(const RECT* pRects, size_t count, const RECT& clip)
+{
+	*this = RegionSpanIterator();
+	if (clip.left >= clip.right || clip.top >= clip.bottom)
+	{
+		return;
+	}
+	clipLeft = clip.left;
+	clipRight = clip.right;
+	clipBottom = clip.bottom;
+	const RECT* pRectsEnd = pRects + count;
+	const RECT* pBand = FindBand(pRects, pRectsEnd, clip.top);
+	pEnd = std::upper_bound(pBand, pRectsEnd, clip.bottom - 1, CoordinateAboveTop<RECT>);
+	BeginBand(pBand, clip.top);
+}
+void RegionSpanIterator::BeginBand(const RECT* pBand, LONG top)
+{
+	for (; pBand != pEnd; pBand = pBandEnd)
+	{
+		pBandEnd = FindBandEnd(pBand, pEnd);
+		pSpanBegin = FindSpan(pBand, pBandEnd, clipLeft);
+		pSpanEnd = std::upper_bound(pSpanBegin, pBandEnd, clipRight - 1, CoordinateLeftOfLeft<RECT>);
+		if (pSpanBegin != pSpanEnd)
+		{
+			pRect = pSpanBegin;
+			bandBottom = min(pBand->bottom, clipBottom);
+			span.y = max(pBand->top, top);
+			span.left = max(pRect->left, clipLeft);
+			span.right = min(pRect->right, clipRight);
+			return;
+		}
+	}
+	pRect = NULL;
+}
+const RegionSpan& RegionSpanIterator::operator*() const
+{
+	return span;
+}
+const RegionSpan* RegionSpanIterator::operator->() const
+{
+	return &span;
+}
+RegionSpanIterator& RegionSpanIterator::operator++()
+{
+	pRect++;
+	if (pRect == pSpanEnd)
+	{
+		//Next scanline of the band, or the next band
+		if (span.y + 1 >= bandBottom)
+		{
+			BeginBand(pBandEnd, bandBottom);
+			return *this;
+		}
+		span.y++;
+		pRect = pSpanBegin;
+	}
+	span.left = max(pRect->left, clipLeft);
+	span.right = min(pRect->right, clipRight);
+	return *this;
+}
+RegionSpanIterator RegionSpanIterator::operator++(int)
+{
+	RegionSpanIterator old = *this;
+	++*this;
+	return old;
+}
+bool RegionSpanIterator::operator==(const RegionSpanIterator& other) const
+{
+	return pRect == other.pRect && (pRect == NULL || span.y == other.span.y);
+}
+bool RegionSpanIterator::operator!=(const RegionSpanIterator& other) const
+{
+	return !(*this == other);
+}
+
+RegionSpans::RegionSpans(const RECT* pRects, size_t count, const RECT& clip) : first(pRects, count, clip)
+{
+}
+RegionSpanIterator RegionSpans::begin() const
+{
+	return first;
+}
+RegionSpanIterator RegionSpans::end() const
+{
+	return RegionSpanIterator();
+}
+
+Region::Region(const byte* pMask, int width, int height, int stride, RegionMaskFormat format, byte threshold)
+{
+	Region_Initialize();
+	if (width <= 0 || height <= 0)
+	{
+		return;
+	}
+	//Rows are turned into bit arrays, and a band is only added once a row is different from the rows before it
+	size_t wordCount = ((size_t)width + 63) / 64;
+	vector<uint64_t> bits(wordCount * 2);
+	uint64_t* pBandBits = &bits[0];
+	uint64_t* pRowBits = &bits[wordCount];
+	RegionRectList result(rects.GetArena());
+	RECT bounds;
+	BandBuilder builder(result, bounds);
+	LONG bandTop = 0;
+	for (int y = 0; y <= height; y++)
+	{
+		if (y < height)
+		{
+			const byte* pRow = pMask + (ptrdiff_t)y * stride;
+			if (format == REGION_MASK_1BPP)
+			{
+				MaskRowToBits(pRow, width, pRowBits);
+			}
+			else
+			{
+				RegionSimd::ThresholdBytes(pRow, width, threshold, pRowBits);
+			}
+			if (y > 0 && memcmp(pRowBits, pBandBits, wordCount * sizeof(uint64_t)) == 0)
+			{
+				continue;
+			}
+		}
+		if (y > 0)
+		{
+			builder.BeginBand(bandTop, y);
+			AddBitRuns(pBandBits, wordCount, builder);
+			builder.EndBand();
+		}
+		std::swap(pBandBits, pRowBits);
+		bandTop = y;
+	}
+	BecomeRects(result, bounds);
+}
+Region::Region(int x, int y, int w, int h)
+{
+	Region_Initialize();
+	BecomeRectangle(RectFromSize(x, y, w, h));
+}
+Region::Region(const Region& region1, const Region& region2)
+{
+	Region_Initialize();
+	BecomeRegion(region1);
+	UnionWith(region2);
+}
+Region::Region(const RECT& rect1, const RECT& rect2)
+{
+	Region_Initialize();
+	BecomeRectangle(rect1);
+	UnionWith(rect2);
+}
+#if REGION_USE_WIN32
+Region::Region(HRGN *pRegion)
+{
+	Region_Initialize();
+	AttachHrgn(pRegion);
+}
+#endif
+
+
+#if !_NO_RVALUE_REFERENCE
+Region::Region(Region&& other) noexcept : rects(other.rects.GetArena())
+{
+	//Using the other region's arena means the swap only moves pointers, and never allocates
+	Region_Initialize();
+	Swap(other);
+}
+Region& Region::operator=(Region&& other)
+{
+	Swap(other);
+	return *this;
+}
+#endif
+
+Region Region::Union(const RECT& other) const
+{
+	Region newRegion(other);
+	if (regionType == SIMPLEREGION)
+	{
+		newRegion.UnionWith(this->boundingBox);
+	}
+	else
+	{
+		newRegion.UnionWith(*this);
+	}
+	return newRegion;
+}
+Region Region::Union(const RECT* pOtherRect) const
+{
+	return Union(*pOtherRect);
+}
+Region Region::Union(const Region& otherRegion) const
+{
+	if (regionType == SIMPLEREGION && otherRegion.regionType == SIMPLEREGION)
+	{
+		Region newRegion(otherRegion.boundingBox);
+		newRegion.UnionRectWithRect(this->boundingBox);
+		return newRegion;
+	}
+	else
+	{
+		Region newRegion(otherRegion);
+		newRegion.UnionWith(*this);
+		return newRegion;
+	}
+}
+#if REGION_USE_WIN32
+Region Region::Union(HRGN otherRegion) const
+{
+	Region newRegion(otherRegion);
+	newRegion.UnionWith(*this);
+	return newRegion;
+}
+#endif
+Region Region::Union(int x, int y, int w, int h) const
+{
+	Region newRegion(x, y, w, h);
+	newRegion.UnionWith(*this);
+	return newRegion;
+}
+
+Region Region::Intersect(const RECT& other) const
+{
+	Region newRegion(other);
+	newRegion.IntersectWith(*this);
+	return newRegion;
+}
+Region Region::Intersect(const RECT* pOtherRect) const
+{
+	Region newRegion(pOtherRect);
+	newRegion.IntersectWith(*this);
+	return newRegion;
+}
+Region Region::Intersect(const Region& otherRegion) const
+{
+	Region newRegion(otherRegion);
+	newRegion.IntersectWith(*this);
+	return newRegion;
+}
+#if REGION_USE_WIN32
+Region Region::Intersect(HRGN otherRegion) const
+{
+	Region newRegion(otherRegion);
+	newRegion.IntersectWith(*this);
+	return newRegion;
+}
+#endif
+Region Region::Intersect(int x, int y, int w, int h) const
+{
+	Region newRegion(x, y, w, h);
+	newRegion.IntersectWith(*this);
+	return newRegion;
+}
+
+Region Region::Subtract(const RECT& other) const
+{
+	Region newRegion(*this);
+	newRegion.SubtractWith(other);
+	return newRegion;
+}
+Region Region::Subtract(const RECT* pOtherRect) const
+{
+	return Subtract(*pOtherRect);
+}
+Region Region::Subtract(const Region& otherRegion) const
+{
+	Region newRegion(*this);
+	newRegion.SubtractWith(otherRegion);
+	return newRegion;
+}
+#if REGION_USE_WIN32
+Region Region::Subtract(HRGN otherRegion) const
+{
+	Region newRegion(*this);
+	newRegion.SubtractWith(otherRegion);
+	return newRegion;
+}
+#endif
+Region Region::Subtract(int x, int y, int w, int h) const
+{
+	Region newRegion(*this);
+	newRegion.SubtractWith(x, y, w, h);
+	return newRegion;
+}
+
+Region Region::Xor(const RECT& other) const
+{
+	Region newRegion(other);
+	newRegion.XorWith(*this);
+	return newRegion;
+}
+Region Region::Xor(const RECT* pOtherRect) const
+{
+	return Xor(*pOtherRect);
+}
+Region Region::Xor(const Region& otherRegion) const
+{
+	Region newRegion(otherRegion);
+	newRegion.XorWith(*this);
+	return newRegion;
+}
+#if REGION_USE_WIN32
+Region Region::Xor(HRGN otherRegion) const
+{
+	Region newRegion(otherRegion);
+	newRegion.XorWith(*this);
+	return newRegion;
+}
+#endif
+Region Region::Xor(int x, int y, int w, int h) const
+{
+	Region newRegion(x, y, w, h);
+	newRegion.XorWith(*this);
+	return newRegion;
+}
+
+void Region::CombineAll(const RECT* const* ppRects, const size_t* pCounts, size_t listCount, int operation)
+{
+	vector<ListCursor> lists(listCount);
+	for (size_t i = 0; i < listCount; i++)
+	{
+		lists[i].pBand = ppRects[i];
+		lists[i].pBandEnd = ppRects[i];
+		lists[i].pEnd = ppRects[i] + pCounts[i];
+	}
+	RegionRectList result(rects.GetArena());
+	RECT bounds;
+	CombineLists(lists, operation, result, bounds);
+	BecomeRects(result, bounds);
+}
+
+/*static*/ Region Region::UnionAll(const Region* const* ppRegions, size_t count)
+{
+	Region newRegion;
+	//Null regions are left out, and if a rectangle covers the bounding boxes of all of the regions, it's the whole union
+	vector<const RECT*> lists;
+	vector<size_t> counts;
+	RECT bounds = { CoordinateMax, CoordinateMax, CoordinateMin, CoordinateMin };
+	const Region* pLargestRect = NULL;
+	const Region* pOnlyRegion = NULL;
+	for (size_t i = 0; i < count; i++)
+	{
+		const Region& region = *ppRegions[i];
+		if (region.regionType == NULLREGION)
+		{
+			continue;
+		}
+		pOnlyRegion = &region;
+		size_t rectCount;
+		lists.push_back(region.GetRectPointer(rectCount));
+		counts.push_back(rectCount);
+		const RECT& box = region.boundingBox;
+		bounds.left = min(bounds.left, box.left);
+		bounds.top = min(bounds.top, box.top);
+		bounds.right = max(bounds.right, box.right);
+		bounds.bottom = max(bounds.bottom, box.bottom);
+		if (region.regionType == SIMPLEREGION && (pLargestRect == NULL || RectCoversUpOther(box, pLargestRect->boundingBox)))
+		{
+			pLargestRect = &region;
+		}
+	}
+	if (pLargestRect != NULL && RectCoversUpOther(pLargestRect->boundingBox, bounds))
+	{
+		newRegion.BecomeRectangle(bounds);
+	}
+	else if (lists.size() == 1)
+	{
+		newRegion.BecomeRegion(*pOnlyRegion);
+	}
+	else if (lists.size() > 1)
+	{
+		newRegion.CombineAll(&lists[0], &counts[0], lists.size(), COMBINE_OR);
+	}
+	return newRegion;
+}
+
+/*static*/ Region Region::IntersectAll(const Region* const* ppRegions, size_t count)
+{
+	Region newRegion;
+	if (count == 0)
+	{
+		return newRegion;
+	}
+	//The result is inside of the intersection of the bounding boxes, so rectangles are left out, and the intersection of the bounding boxes
+	//(which is the intersection of the rectangles cut down to the other regions) is used as one more list in their place
+	RECT clip = { CoordinateMin, CoordinateMin, CoordinateMax, CoordinateMax };
+	for (size_t i = 0; i < count; i++)
+	{
+		const Region& region = *ppRegions[i];
+		if (region.regionType == NULLREGION)
+		{
+			return newRegion;
+		}
+		const RECT& box = region.boundingBox;
+		clip.left = max(clip.left, box.left);
+		clip.top = max(clip.top, box.top);
+		clip.right = min(clip.right, box.right);
+		clip.bottom = min(clip.bottom, box.bottom);
+	}
+	if (RectIsEmpty(clip))
+	{
+		return newRegion;
+	}
+	//Only the bands of each complex region which overlap the clip rectangle vertically are looked at
+	vector<const RECT*> lists;
+	vector<size_t> counts;
+	bool hasRectangle = false;
+	const Region* pComplexRegion = NULL;
+	for (size_t i = 0; i < count; i++)
+	{
+		const Region& region = *ppRegions[i];
+		if (region.regionType == SIMPLEREGION)
+		{
+			hasRectangle = true;
+			continue;
+		}
+		pComplexRegion = &region;
+		size_t rectCount;
+		const RECT* pRects = region.GetRectPointer(rectCount);
+		const RECT* pEnd = pRects + rectCount;
+		const RECT* pFirst = FindBand(pRects, pEnd, clip.top);
+		const RECT* pLast = std::upper_bound(pFirst, pEnd, clip.bottom - 1, CoordinateAboveTop<RECT>);
+		lists.push_back(pFirst);
+		counts.push_back(pLast - pFirst);
+	}
+	if (lists.empty())
+	{
+		newRegion.BecomeRectangle(clip);
+	}
+	else if (lists.size() == 1)
+	{
+		newRegion.BecomeRegion(*pComplexRegion);
+		newRegion.ClipToRect(clip);
+	}
+	else
+	{
+		if (hasRectangle)
+		{
+			lists.push_back(&clip);
+			counts.push_back(1);
+		}
+		newRegion.CombineAll(&lists[0], &counts[0], lists.size(), COMBINE_AND);
+	}
+	return newRegion;
+}
+
+void Region::OffsetBy(int dx, int dy)
+{
+	REGION_TRACE(REGION_TRACE_OFFSET, *this, dx, dy);
+	if (this->regionType == NULLREGION)
+	{
+		return;
+	}
+	RECT moved = { OffsetCoordinate(boundingBox.left, dx), OffsetCoordinate(boundingBox.top, dy), OffsetCoordinate(boundingBox.right, dx), OffsetCoordinate(boundingBox.bottom, dy) };
+	if (this->regionType == SIMPLEREGION)
+	{
+		BecomeRectangle(moved);
+		return;
+	}
+	bool cutOff = (int64_t)boundingBox.left + dx < CoordinateMin || (int64_t)boundingBox.top + dy < CoordinateMin ||
+		(int64_t)boundingBox.right + dx > CoordinateMax || (int64_t)boundingBox.bottom + dy > CoordinateMax;
+	if (cutOff)
+	{
+		//Part of the region moves past the end of the coordinate range.  Rectangles cut off there can become empty, or match the band
+		//next to them, so the list is rebuilt.
+		size_t count;
+		const RECT* pRects = GetRectPointer(count);
+		vector<RECT> cutRects;
+		cutRects.reserve(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			RECT rect = { OffsetCoordinate(pRects[i].left, dx), OffsetCoordinate(pRects[i].top, dy), OffsetCoordinate(pRects[i].right, dx), OffsetCoordinate(pRects[i].bottom, dy) };
+			cutRects.push_back(rect);
+		}
+		//(BuildRectsUnion leaves out the empty rectangles)
+		RegionRectList result(rects.GetArena());
+		RECT bounds;
+		BuildRectsUnion(cutRects.data(), cutRects.size(), result, bounds);
+		BecomeRects(result, bounds);
+		return;
+	}
+	boundingBox = moved;
+	if (this->regionType == COMPLEXREGION)
+	{
+		//Moving every rectangle by the same amount keeps the bands in order
+		RECT* pRects = rects.Data();
+		size_t count = rects.Count();
+		for (size_t i = 0; i < count; i++)
+		{
+			pRects[i].left += dx;
+			pRects[i].top += dy;
+			pRects[i].right += dx;
+			pRects[i].bottom += dy;
+		}
+		UpdateSummary();
+	}
+}
+void Region::ScaleBy(int num, int den, RegionRounding rounding)
+{
+	assert(den > 0 && num >= 0);
+	REGION_TRACE(REGION_TRACE_SCALE, *this, num, den, (int)rounding);
+	if (this->regionType == NULLREGION || num == den)
+	{
+		return;
+	}
+	bool outward = rounding == REGION_ROUND_OUTWARD;
+	if (this->regionType == SIMPLEREGION)
+	{
+		RECT rect = boundingBox;
+		ScaleRect(rect, num, den, outward);
+		BecomeRectangle(rect);
+	}
+	else if (this->regionType == COMPLEXREGION)
+	{
+		//Scaling keeps the rectangles in the same order, so the list stays banded unless rounding made
+		//rectangles empty, touch, or overlap.  Only in that case does the list need to be rebuilt.
+		RECT* pRects = rects.Data();
+		size_t count = rects.Count();
+		for (size_t i = 0; i < count; i++)
+		{
+			ScaleRect(pRects[i], num, den, outward);
+		}
+		if (IsBanded(pRects, count))
+		{
+			ScaleRect(boundingBox, num, den, outward);
+			UpdateSummary();
+		}
+		else
+		{
+			RegionRectList result(rects.GetArena());
+			RECT bounds;
+			BuildRectsUnion(pRects, count, result, bounds);
+			BecomeRects(result, bounds);
+		}
+	}
+}
+
+void Region::Simplify(size_t maxRects, int maxWastePercent)
+{
+	REGION_TRACE(REGION_TRACE_SIMPLIFY, *this, (int)std::min(maxRects, (size_t)std::numeric_limits<int>::max()), maxWastePercent);
+	if (this->regionType != COMPLEXREGION || rects.Count() <= maxRects)
+	{
+		return;
+	}
+	size_t count;
+	const RECT* pRects = GetRectPointer(count);
+	double area = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		area += ((double)pRects[i].right - pRects[i].left) * ((double)pRects[i].bottom - pRects[i].top);
+	}
+	double maxWaste = area * max(maxWastePercent, 0) / 100;
+	RegionRectList result(rects.GetArena());
+	RECT bounds;
+	SimplifyRects(pRects, count, max(maxRects, (size_t)1), maxWaste, result, bounds);
+	BecomeRects(result, bounds);
+}
+
+bool Region::ContainsPoint(int x, int y) const
+{
+	if (this->regionType == NULLREGION || x < boundingBox.left || x >= boundingBox.right || y < boundingBox.top || y >= boundingBox.bottom)
+	{
+		return false;
+	}
+	if (this->regionType == SIMPLEREGION)
+	{
+		return true;
+	}
+	const RECT* pEnd = rects.Data() + rects.Count();
+	const RECT* pBand = FindBand(rects.Data(), pEnd, y);
+	if (pBand == pEnd || pBand->top > y)
+	{
+		//y is in a gap between bands
+		return false;
+	}
+	const RECT* pBandEnd = FindBandEnd(pBand, pEnd);
+	const RECT* pSpan = FindSpan(pBand, pBandEnd, x);
+	return pSpan != pBandEnd && pSpan->left <= x;
+}
+bool Region::ContainsRect(const RECT& rect) const
+{
+	if (this->regionType == NULLREGION || RectIsEmpty(rect) || !RectCoversUpOther(boundingBox, rect))
+	{
+		return false;
+	}
+	if (this->regionType == SIMPLEREGION)
+	{
+		return true;
+	}
+	//Every band from the top of the rectangle to the bottom must have a single span covering the rectangle, with no gaps between bands
+	const RECT* pEnd = rects.Data() + rects.Count();
+	const RECT* pBand = FindBand(rects.Data(), pEnd, rect.top);
+	LONG y = rect.top;
+	while (y < rect.bottom)
+	{
+		if (pBand == pEnd || pBand->top > y)
+		{
+			return false;
+		}
+		const RECT* pBandEnd = FindBandEnd(pBand, pEnd);
+		const RECT* pSpan = FindSpan(pBand, pBandEnd, rect.left);
+		if (pSpan == pBandEnd || pSpan->left > rect.left || pSpan->right < rect.right)
+		{
+			return false;
+		}
+		y = pBand->bottom;
+		pBand = pBandEnd;
+	}
+	return true;
+}
+bool Region::ContainsRect(const RECT* pRect) const
+{
+	return ContainsRect(*pRect);
+}
+bool Region::OverlapsRect(const RECT& rect) const
+{
+	if (this->regionType == NULLREGION || RectIsEmpty(rect) || !RectOverlaps(boundingBox, rect))
+	{
+		return false;
+	}
+	if (this->regionType == SIMPLEREGION)
+	{
+		return true;
+	}
+	//Check each band between the top and bottom of the rectangle for a span which overlaps it horizontally
+	const RECT* pEnd = rects.Data() + rects.Count();
+	const RECT* pBand = FindBand(rects.Data(), pEnd, rect.top);
+	while (pBand != pEnd && pBand->top < rect.bottom)
+	{
+		const RECT* pBandEnd = FindBandEnd(pBand, pEnd);
+		const RECT* pSpan = FindSpan(pBand, pBandEnd, rect.left);
+		if (pSpan != pBandEnd && pSpan->left < rect.right)
+		{
+			return true;
+		}
+		pBand = pBandEnd;
+	}
+	return false;
+}
+bool Region::OverlapsRect(const RECT* pRect) const
+{
+	return OverlapsRect(*pRect);
+}
+
+bool Region::operator==(const Region& other) const
+{
+	if (this->regionType != other.regionType)
+	{
+		return false;
+	}
+	if (this->regionType == NULLREGION)
+	{
+		return true;
+	}
+	if (this->regionType == SIMPLEREGION)
+	{
+		return RectEquals(this->boundingBox, other.boundingBox);
+	}
+	//Banded rectangle lists are canonical, so equal regions have identical lists (and identical hashes)
+	if (this->hash != other.hash || this->rects.Count() != other.rects.Count() || !RectEquals(this->boundingBox, other.boundingBox))
+	{
+		return false;
+	}
+	//Regions which share their rectangles (copies of each other) are equal without comparing them
+	if (this->rects.Data() == other.rects.Data())
+	{
+		return true;
+	}
+	return 0 == memcmp(this->rects.Data(), other.rects.Data(), sizeof(RECT) * rects.Count());
+}
+bool Region::operator!=(const Region& other) const
+{
+	return !(*this == other);
+}
+
+vector<RECT> Region::GetRegionRects() const
+{
+	vector<RECT> result;
+	GetRegionRects(result);
+	return result;
+}
+vector<byte> Region::GetRegionData() const
+{
+	vector<byte> result;
+	GetRegionData(result);
+	return result;
+}
+void Region::GetRegionRects(vector<RECT>& rects) const
+{
+	size_t count;
+	const RECT* pRects = GetRectPointer(count);
+	rects.assign(pRects, pRects + count);
+}
+void Region::GetRegionData(vector<byte>& bytes) const
+{
+	size_t count;
+	const RECT* pRects = GetRectPointer(count);
+	bytes.resize(sizeof(RGNDATAHEADER) + sizeof(RECT) * count);
+	FillDataHeader(*((RGNDATAHEADER*)&bytes[0]), count, this->boundingBox);
+	if (count > 0)
+	{
+		memcpy(&bytes[0] + sizeof(RGNDATAHEADER), pRects, sizeof(RECT) * count);
+	}
+}
+const RECT* Region::GetRegionRects(size_t& count) const
+{
+	return GetRectPointer(count);
+}
+size_t Region::GetSerializedSize() const
+{
+	size_t count;
+	const RECT* pRects = GetRectPointer(count);
+	SerializedSizeCounter counter;
+	WriteSerializedRects(pRects, count, counter);
+	return counter.size;
+}
+size_t Region::Serialize(byte* pDest) const
+{
+	size_t count;
+	const RECT* pRects = GetRectPointer(count);
+	SerializedWriter writer(pDest);
+	WriteSerializedRects(pRects, count, writer);
+	return writer.p - pDest;
+}
+void Region::Serialize(vector<byte>& bytes) const
+{
+	bytes.resize(GetSerializedSize());
+	Serialize(bytes.data());
+}
+bool Region::Deserialize(const byte* pData, size_t size)
+{
+	return Deserialize(pData, size, REGION_DESERIALIZE_MAX_RECTS);
+}
+bool Region::Deserialize(const byte* pData, size_t size, size_t maxRects)
+{
+	SerializedReader reader(pData, pData + size);
+	int64_t bandCount = reader.Read();
+	//Every band takes at least 3 bytes, so a bad count can't make this allocate too much
+	if (reader.failed || bandCount > (int64_t)(size / 3))
+	{
+		return false;
+	}
+	RegionRectList result(rects.GetArena());
+	//A span takes at least 2 bytes (unless its band repeats the band above)
+	result.Reserve(min(size / 2, maxRects));
+	result.MakeWritable();
+	int64_t previousBottom = 0;
+	int64_t previousLeft = 0;
+	RECT bounds = { CoordinateMax, CoordinateMax, CoordinateMin, CoordinateMin };
+	//Index of the first rectangle of the band above
+	size_t previousBand = 0;
+	for (int64_t band = 0; band < bandCount; band++)
+	{
+		int64_t top = band == 0 ? reader.ReadSigned() : previousBottom + reader.Read();
+		int64_t bottom = top + reader.Read() + 1;
+		int64_t spanCount = reader.Read();
+		if (reader.failed || !IsCoordinate(top) || !IsCoordinate(bottom) || (spanCount == 0 && band == 0))
+		{
+			return false;
+		}
+		previousBottom = bottom;
+		size_t bandStart = result.Count();
+		//Check before adding the band, a repeated band costs a few bytes but can add many rectangles
+		size_t room = maxRects - bandStart;
+		if (spanCount == 0 ? bandStart - previousBand > room : (uint64_t)spanCount > room)
+		{
+			return false;
+		}
+		if (spanCount == 0)
+		{
+			//Same spans as the band above
+			for (size_t i = previousBand; i < bandStart; i++)
+			{
+				RECT rect = result.WritableData()[i];
+				rect.top = (LONG)top;
+				rect.bottom = (LONG)bottom;
+				result.AddWritable(rect);
+			}
+			previousBand = bandStart;
+			continue;
+		}
+		previousBand = bandStart;
+		int64_t left = previousLeft + reader.ReadSigned();
+		int64_t right = left + reader.Read() + 1;
+		if (reader.failed || !IsCoordinate(left) || !IsCoordinate(right) || spanCount > (reader.pEnd - reader.p) / 2 + 1)
+		{
+			return false;
+		}
+		previousLeft = left;
+		bounds.left = min(bounds.left, (LONG)left);
+		for (int64_t span = 0; span < spanCount; span++)
+		{
+			if (span != 0)
+			{
+				left = right + reader.Read() + 1;
+				right = left + reader.Read() + 1;
+				if (reader.failed || !IsCoordinate(right))
+				{
+					return false;
+				}
+			}
+			RECT rect = { (LONG)left, (LONG)top, (LONG)right, (LONG)bottom };
+			result.AddWritable(rect);
+		}
+		bounds.right = max(bounds.right, (LONG)right);
+	}
+	if (reader.p != reader.pEnd)
+	{
+		return false;
+	}
+	if (bandCount != 0)
+	{
+		const RECT* pResult = result.Data();
+		bounds.top = pResult[0].top;
+		bounds.bottom = pResult[result.Count() - 1].bottom;
+		//Data which wasn't written by Serialize could have touching bands with the same spans
+		result.Truncate(CoalesceBands(result.Data(), result.Count()));
+	}
+	//The new contents don't come from recorded operations, so the region is defined again the next time it's used
+	REGION_TRACE_FORGET(*this);
+	BecomeRects(result, bounds);
+	return true;
+}
+
+RegionSpans Region::GetSpans(int top, int bottom) const
 {
-	//are we a rectangle?
-	if (this->regionType == SIMPLEREGION)
+	RECT clip = { CoordinateMin, top, CoordinateMax, bottom };
+	return GetSpans(clip);
+}
+RegionSpans Region::GetSpans(const RECT& clip) const
+{
+	size_t count;
+	const RECT* pRects = GetRectPointer(count);
+	return RegionSpans(pRects, count, clip);
+}
+const RGNDATAHEADER* Region::GetRegionData(size_t& size) const
+{
+	const RGNDATAHEADER* pHeader;
+	if (this->regionType == COMPLEXREGION)
 	{
-		const RECT& me = boundingBox;
-		//If other covers up us (and we are saving a valid HRGN) no assignments needed (preserves HRGN too)
-		if (HrgnIsValid() && RectCoversUpOther(other, me))
-		{
-			return;
-		}
-		IntersectBoundingbox(other);
-		SetHrgnInvalid();
-		int w = me.right - me.left;
-		int h = me.bottom - me.top;
-		if (w <= 0 || h <= 0) Clear();
+		pHeader = rects.GetDataHeader(this->boundingBox);
 	}
-	//are we complex?
-	else if (this->regionType == COMPLEXREGION)
+	else
 	{
-		if (RectCoversUpOther(other, boundingBox))
-		{
-			return;
-		}
-		GetHrgn();
-		HRGN hrgnTemp = SetTempRegion(other);
-		this->regionType = CombineRgn(hrgn, hrgn, hrgnTemp, RGN_AND);
-		this->regionType = GetRgnBox(hrgn, &boundingBox);
+		pHeader = rects.GetRectDataHeader();
 	}
-	//are we empty?
-	else if (this->regionType == NULLREGION)
+	size = sizeof(RGNDATAHEADER) + pHeader->nRgnSize;
+	return pHeader;
+}
+
+#if REGION_USE_WIN32
+void Region::AttachHrgn(HRGN *pOtherRegion)
+{
+	if (pOtherRegion == NULL) return;
+	//The new contents don't come from recorded operations, so the region is defined again the next time it's used
+	REGION_TRACE_FORGET(*this);
+	if (!BecomeHrgn(*pOtherRegion))
 	{
-		//already null, intersection will be nothing
+		Clear();
+	}
+	else
+	{
+		//The rectangles have been copied out, so the region object itself is no longer needed
+		DeleteObject(*pOtherRegion);
+		*pOtherRegion = NULL;
 	}
 }
-void Region::IntersectWith(const RECT* pRect)
+HRGN Region::DetachHrgn()
 {
-	IntersectWith(*pRect);
+	HRGN returnValue = DetachHrgnCopy();
+	Clear();
+	return returnValue;
 }
-void Region::IntersectWith(const Region& otherRegion)
+HRGN Region::DetachHrgnCopy() const
 {
-	if (otherRegion.regionType == SIMPLEREGION)
+	REGION_STATS_COUNT(REGION_STAT_HRGN_CONVERSION);
+	if (this->regionType == COMPLEXREGION)
 	{
-		IntersectWith(otherRegion.boundingBox);
+		size_t size;
+		const RGNDATAHEADER* pData = GetRegionData(size);
+		return ExtCreateRegion(NULL, (DWORD)size, (const RGNDATA*)pData);
 	}
-	else if (otherRegion.regionType == COMPLEXREGION)
+	return CreateRectRgnIndirect(&this->boundingBox);
+}
+#endif
+
+/*static*/ size_t FixedRegionBase::SetRectangle(const RECT& rect, RECT* pRects, RECT& boundingBox)
+{
+	if (RectIsEmpty(rect))
 	{
-		if (this->regionType == NULLREGION)
+		boundingBox = RECT{};
+		return 0;
+	}
+	pRects[0] = rect;
+	boundingBox = rect;
+	return 1;
+}
+/*static*/ bool FixedRegionBase::Combine(RECT* pRects, size_t& count, RECT& boundingBox, size_t capacity, RECT* pScratch,
+	const RECT* pOtherRects, size_t otherCount, const RECT& otherBounds, Operation operation, FixedRegionOverflow overflow)
+{
+	static const int combineOperations[] = { COMBINE_OR, COMBINE_AND, COMBINE_DIFF, COMBINE_XOR };
+	FixedRectList result(pScratch, capacity);
+	RECT bounds;
+	CombineBands(pRects, pRects + count, pOtherRects, pOtherRects + otherCount, combineOperations[operation], CoordinateMin, CoordinateMax, result, bounds);
+	if (!result.Overflowed())
+	{
+		count = result.Count();
+		memcpy(pRects, pScratch, sizeof(RECT) * count);
+		boundingBox = count > 0 ? bounds : RECT{};
+		return true;
+	}
+	if (overflow == FIXED_REGION_BOUNDING_BOX)
+	{
+		//The result of a union or xor is inside of the box around both operands, the result of an intersect or subtract is inside
+		//of this region's box (also inside of the other region's box for an intersect)
+		RECT box = boundingBox;
+		if (operation == OPERATION_INTERSECT)
 		{
-			return;
+			box.left = max(box.left, otherBounds.left);
+			box.top = max(box.top, otherBounds.top);
+			box.right = min(box.right, otherBounds.right);
+			box.bottom = min(box.bottom, otherBounds.bottom);
 		}
-		if (!RectOverlaps(this->boundingBox, otherRegion.boundingBox))
+		else if (operation != OPERATION_SUBTRACT && otherCount > 0)
 		{
-			Clear();
-			return;
+			//An empty region's box is all zeroes, don't stretch the other box out to the origin
+			box = count > 0 ? RectUnion(box, otherBounds) : otherBounds;
 		}
-		GetHrgn();
-		this->regionType = CombineRgn(hrgn, hrgn, otherRegion.hrgn, RGN_AND);
-		this->regionType = GetRgnBox(hrgn, &boundingBox);
-	}
-	else if (otherRegion.regionType == NULLREGION)
-	{
-		Clear();
+		count = SetRectangle(box, pRects, boundingBox);
 	}
+	return false;
 }
-void Region::IntersectWith(HRGN other)
+/*static*/ bool FixedRegionBase::RectsContainPoint(const RECT* pRects, size_t count, const RECT& boundingBox, int x, int y)
 {
-	if (this->regionType == NULLREGION)
+	if (count == 0 || x < boundingBox.left || x >= boundingBox.right || y < boundingBox.top || y >= boundingBox.bottom)
 	{
-		return;
+		return false;
 	}
-	GetHrgn();
-	this->regionType = CombineRgn(hrgn, hrgn, other, RGN_AND);
-	//check if provided HRGN was invalid
-	if (this->regionType == 0)
+	const RECT* pEnd = pRects + count;
+	const RECT* pBand = FindBand(pRects, pEnd, y);
+	if (pBand == pEnd || pBand->top > y)
 	{
-		Clear();
-		return;
+		return false;
 	}
-	this->regionType = GetRgnBox(hrgn, &boundingBox);
-	SetHrgnValid();
+	const RECT* pBandEnd = FindBandEnd(pBand, pEnd);
+	const RECT* pSpan = FindSpan(pBand, pBandEnd, x);
+	return pSpan != pBandEnd && pSpan->left <= x;
 }
-void Region::IntersectWith(int x, int y, int w, int h)
+/*static*/ bool FixedRegionBase::RectsEqual(const RECT* pRects, size_t count, const RECT* pOtherRects, size_t otherCount)
 {
-	RECT rect{ x, y, x + w, y + h };
-	IntersectWith(rect);
+	//Banded rectangle lists are canonical, so equal regions have identical lists
+	return count == otherCount && (count == 0 || 0 == memcmp(pRects, pOtherRects, sizeof(RECT) * count));
 }
 
-Region::Region(const Region& other)
-{
-	Region_Initialize();
-	BecomeRegion(other);
-}
-Region& Region::operator=(const Region& other)
+//True if adding delta to a coordinate would go past the end of the coordinate range
+template <class T>
+static inline bool CoordinatesOverflow(T value, T delta)
 {
-	BecomeRegion(other);
-	return *this;
+	return (delta > 0 && value > std::numeric_limits<T>::max() - delta) || (delta < 0 && value < std::numeric_limits<T>::min() - delta);
 }
-Region& Region::operator=(const RECT& rect)
+//Adds delta to a coordinate, cutting the result off at the ends of the coordinate range instead of wrapping around
+template <class T>
+static inline T AddCoordinates(T value, T delta)
 {
-	BecomeRectangle(rect);
-	return *this;
+	if (delta > 0 && value > std::numeric_limits<T>::max() - delta)
+	{
+		return std::numeric_limits<T>::max();
+	}
+	if (delta < 0 && value < std::numeric_limits<T>::min() - delta)
+	{
+		return std::numeric_limits<T>::min();
+	}
+	return (T)(value + delta);
 }
-Region& Region::operator=(const RECT* pRect)
+
+template <class Coord>
+BasicRegion<Coord>::BasicRegion()
 {
-	BecomeRectangle(*pRect);
-	return *this;
+	boundingBox = Rect();
 }
-void Region::Swap(Region& other)
+template <class Coord>
+BasicRegion<Coord>::BasicRegion(const Rect& rect)
 {
-	std::swap(this->boundingBox, other.boundingBox);
-	std::swap(this->regionType, other.regionType);
-	std::swap(this->hrgn, other.hrgn);
-#if !REGION_USE_GLOBAL_TEMP_REGION
-	std::swap(this->hrgnTemp, other.hrgnTemp);
-#endif
-#if REGION_USE_VALID_FLAG
-	std::swap(this->hrgnValid, other.hrgnValid);
-#endif
+	BecomeRectangle(rect);
 }
-
-Region::Region(const RECT& other)
+template <class Coord>
+BasicRegion<Coord>::BasicRegion(Coordinate x, Coordinate y, Coordinate w, Coordinate h)
 {
-	Region_Initialize();
-	BecomeRectangle(other);
+	Rect rect = { x, y, AddCoordinates(x, w), AddCoordinates(y, h) };
+	BecomeRectangle(rect);
 }
-Region::Region(const RECT* pOtherRect)
+template <class Coord>
+BasicRegion<Coord>::BasicRegion(const Rect* pRects, size_t count)
 {
-	Region_Initialize();
-	BecomeRectangle(*pOtherRect);
+	vector<Rect> result;
+	VectorRectList<Rect> list(result);
+	Rect bounds;
+	BuildRectsUnion(pRects, count, list, bounds);
+	BecomeRects(result, bounds);
 }
-Region::Region(HRGN otherRegion)
+template <class Coord>
+void BasicRegion<Coord>::BecomeRectangle(const Rect& rect)
 {
-	Region_Initialize();
-	UnionWith(otherRegion);
+	if (RectIsEmpty(rect))
+	{
+		Clear();
+		return;
+	}
+	rects.assign(1, rect);
+	boundingBox = rect;
 }
-Region::Region(int x, int y, int w, int h)
+template <class Coord>
+void BasicRegion<Coord>::BecomeRects(vector<Rect>& result, const Rect& bounds)
 {
-	Region_Initialize();
-	BecomeRectangle(x, y, x + w, y + h);
+	rects.swap(result);
+	boundingBox = rects.empty() ? Rect() : bounds;
 }
-Region::Region(const Region& region1, const Region& region2)
+template <class Coord>
+void BasicRegion<Coord>::CombineWith(const Rect* pOtherRects, size_t otherCount, int operation)
 {
-	Region_Initialize();
-	BecomeRegion(region1);
-	UnionWith(region2);
+	vector<Rect> result;
+	VectorRectList<Rect> list(result);
+	list.Reserve(rects.size() + otherCount);
+	Rect bounds;
+	CombineBands(rects.data(), rects.data() + rects.size(), pOtherRects, pOtherRects + otherCount, operation,
+		std::numeric_limits<Coordinate>::min(), std::numeric_limits<Coordinate>::max(), list, bounds);
+	BecomeRects(result, bounds);
 }
-Region::Region(const RECT& rect1, const RECT& rect2)
+template <class Coord>
+DWORD BasicRegion<Coord>::GetRegionType() const
 {
-	Region_Initialize();
-	BecomeRectangle(rect1);
-	UnionRectWithRect(rect2);
+	return rects.empty() ? NULLREGION : rects.size() == 1 ? SIMPLEREGION : COMPLEXREGION;
 }
-Region::Region(HRGN *pRegion)
+template <class Coord>
+const typename BasicRegion<Coord>::Rect& BasicRegion<Coord>::GetBoundingBox() const
 {
-	Region_Initialize();
-	AttachHrgn(pRegion);
+	return boundingBox;
 }
-
-
-#if !_NO_RVALUE_REFERENCE
-Region::Region(Region&& other) noexcept
+template <class Coord>
+const typename BasicRegion<Coord>::Rect* BasicRegion<Coord>::GetRegionRects(size_t& count) const
 {
-	Region_Initialize();
-	Swap(other);
+	count = rects.size();
+	return rects.data();
 }
-Region& Region::operator=(Region&& other) noexcept
+template <class Coord>
+size_t BasicRegion<Coord>::GetRectCount() const
 {
-	Swap(other);
-	return *this;
+	return rects.size();
 }
-#endif
-
-Region Region::Union(const RECT& other)
+template <class Coord>
+int64_t BasicRegion<Coord>::GetArea() const
 {
-	Region newRegion(other);
-	if (regionType == SIMPLEREGION)
-	{
-		newRegion.UnionWith(this->boundingBox);
-	}
-	else
+	int64_t area = 0;
+	for (size_t i = 0; i < rects.size(); i++)
 	{
-		newRegion.UnionWith(*this);
+		int64_t rectArea = RectArea(rects[i]);
+		area = rectArea > AreaMax - area ? AreaMax : area + rectArea;
 	}
-	return newRegion;
+	return area;
 }
-Region Region::Union(const RECT* pOtherRect)
+template <class Coord>
+void BasicRegion<Coord>::Clear()
 {
-	return Union(*pOtherRect);
+	rects.clear();
+	boundingBox = Rect();
 }
-Region Region::Union(const Region& otherRegion)
+template <class Coord>
+void BasicRegion<Coord>::UnionWith(const Rect& rect)
 {
-	if (regionType == SIMPLEREGION && otherRegion.regionType == SIMPLEREGION)
+	UnionWith(BasicRegion(rect));
+}
+template <class Coord>
+void BasicRegion<Coord>::UnionWith(const BasicRegion& other)
+{
+	if (other.rects.empty())
 	{
-		Region newRegion(otherRegion.boundingBox);
-		newRegion.UnionRectWithRect(this->boundingBox);
-		return newRegion;
+		return;
 	}
-	else
+	const Rect& otherBounds = other.boundingBox;
+	//Either region is empty, or the other region is a rectangle covering up this one
+	if (rects.empty() || (other.rects.size() == 1 && RectCoversUpOther(otherBounds, boundingBox)))
 	{
-		Region newRegion(otherRegion);
-		newRegion.UnionWith(*this);
-		return newRegion;
+		*this = other;
+		return;
 	}
+	CombineWith(other.rects.data(), other.rects.size(), COMBINE_OR);
 }
-Region Region::Union(HRGN otherRegion)
+template <class Coord>
+void BasicRegion<Coord>::IntersectWith(const Rect& rect)
 {
-	Region newRegion(otherRegion);
-	newRegion.UnionWith(*this);
-	return newRegion;
+	IntersectWith(BasicRegion(rect));
 }
-Region Region::Union(int x, int y, int w, int h)
+template <class Coord>
+void BasicRegion<Coord>::IntersectWith(const BasicRegion& other)
 {
-	Region newRegion(x, y, w, h);
-	if (regionType == SIMPLEREGION)
+	if (rects.empty() || other.rects.empty())
 	{
-		newRegion.UnionRectWithRect(this->boundingBox);
+		Clear();
+		return;
 	}
-	else
+	if (rects.size() == 1 && other.rects.size() == 1)
 	{
-		newRegion.UnionWith(*this);
+		//The intersection of two rectangles is a rectangle
+		const Rect& otherBounds = other.boundingBox;
+		Rect rect = { max(boundingBox.left, otherBounds.left), max(boundingBox.top, otherBounds.top),
+			min(boundingBox.right, otherBounds.right), min(boundingBox.bottom, otherBounds.bottom) };
+		BecomeRectangle(rect);
+		return;
 	}
-	return newRegion;
-}
-
-Region Region::Intersect(const RECT& other)
-{
-	Region newRegion(other);
-	newRegion.IntersectWith(*this);
-	return newRegion;
-}
-Region Region::Intersect(const RECT* pOtherRect)
-{
-	Region newRegion(pOtherRect);
-	newRegion.IntersectWith(*this);
-	return newRegion;
+	CombineWith(other.rects.data(), other.rects.size(), COMBINE_AND);
 }
-Region Region::Intersect(const Region& otherRegion)
+template <class Coord>
+void BasicRegion<Coord>::SubtractWith(const Rect& rect)
 {
-	Region newRegion(otherRegion);
-	newRegion.IntersectWith(*this);
-	return newRegion;
+	SubtractWith(BasicRegion(rect));
 }
-Region Region::Intersect(HRGN otherRegion)
+template <class Coord>
+void BasicRegion<Coord>::SubtractWith(const BasicRegion& other)
 {
-	Region newRegion(otherRegion);
-	newRegion.IntersectWith(*this);
-	return newRegion;
+	const Rect& otherBounds = other.boundingBox;
+	//Nothing to remove if the bounding boxes don't overlap
+	if (rects.empty() || other.rects.empty() || !RectOverlaps(otherBounds, boundingBox))
+	{
+		return;
+	}
+	CombineWith(other.rects.data(), other.rects.size(), COMBINE_DIFF);
 }
-Region Region::Intersect(int x, int y, int w, int h)
+template <class Coord>
+void BasicRegion<Coord>::XorWith(const Rect& rect)
 {
-	Region newRegion(x, y, w, h);
-	newRegion.IntersectWith(*this);
-	return newRegion;
+	XorWith(BasicRegion(rect));
 }
-
-bool Region::operator==(const Region& other) const
+template <class Coord>
+void BasicRegion<Coord>::XorWith(const BasicRegion& other)
 {
-	if (this->regionType != other.regionType)
-	{
-		return false;
-	}
-	if (this->regionType == NULLREGION)
+	if (other.rects.empty())
 	{
-		return true;
+		return;
 	}
-	if (this->regionType == SIMPLEREGION)
+	if (rects.empty())
 	{
-		return RectEquals(this->boundingBox, other.boundingBox);
+		*this = other;
+		return;
 	}
-	return EqualRgn(this->hrgn, other.hrgn);
+	CombineWith(other.rects.data(), other.rects.size(), COMBINE_XOR);
 }
-bool Region::operator!=(const Region& other) const
+template <class Coord>
+BasicRegion<Coord> BasicRegion<Coord>::Union(const BasicRegion& other) const
 {
-	return !(*this == other);
+	BasicRegion result(*this);
+	result.UnionWith(other);
+	return result;
 }
-
-vector<RECT> Region::GetRegionRects() const
+template <class Coord>
+BasicRegion<Coord> BasicRegion<Coord>::Intersect(const BasicRegion& other) const
 {
-	vector<RECT> result;
-	GetRegionRects(result);
+	BasicRegion result(*this);
+	result.IntersectWith(other);
 	return result;
 }
-vector<byte> Region::GetRegionData() const
+template <class Coord>
+BasicRegion<Coord> BasicRegion<Coord>::Subtract(const BasicRegion& other) const
 {
-	vector<byte> result;
-	GetRegionData(result);
+	BasicRegion result(*this);
+	result.SubtractWith(other);
 	return result;
 }
-void Region::GetRegionRects(vector<RECT>& rects) const
+template <class Coord>
+BasicRegion<Coord> BasicRegion<Coord>::Xor(const BasicRegion& other) const
 {
-	rects.clear();
-	if (this->regionType == SIMPLEREGION)
-	{
-		rects.push_back(this->boundingBox);
-	}
-	else if (this->regionType == NULLREGION)
-	{
-		//no rects to add
-	}
-	else if (this->regionType == COMPLEXREGION)
-	{
-		vector<byte> regionData;
-		GetRegionData(regionData);
-		if (regionData.size() < sizeof(RGNDATAHEADER) + sizeof(RECT))
-		{
-			//error condition, only happens if Windows itself is broken or the HRGN is somehow in a bad state
-			return;
-		}
-		RGNDATAHEADER& header = *((RGNDATAHEADER*)(&regionData[0]));
-		if (!(header.nCount > 0 && header.dwSize == sizeof(RGNDATAHEADER) && header.nCount * sizeof(RECT) == header.nRgnSize))
-		{
-			//error condition, only happens if Windows itself is broken or the HRGN is somehow in a bad state
-			return;
-		}
-		RECT* pRects = (RECT*)(&regionData[0] + sizeof(RGNDATAHEADER));
-		rects.resize(header.nCount);
-		memcpy(&rects[0], &pRects[0], sizeof(RECT) * rects.size());
-	}
+	BasicRegion result(*this);
+	result.XorWith(other);
+	return result;
 }
-void Region::GetRegionData(vector<byte>& bytes) const
+template <class Coord>
+void BasicRegion<Coord>::OffsetBy(Coordinate dx, Coordinate dy)
 {
-	if (this->regionType == NULLREGION)
+	if (rects.empty())
 	{
-		bytes.resize(sizeof(RGNDATAHEADER));
-		RGNDATAHEADER& header = *((RGNDATAHEADER*)&bytes[0]);
-		header.dwSize = sizeof(RGNDATAHEADER);
-		header.iType = RDH_RECTANGLES;
-		header.nCount = 0;
-		header.nRgnSize = 0;
-		header.rcBound = {};
-	}
-	else if (this->regionType == SIMPLEREGION)
-	{
-		bytes.resize(sizeof(RGNDATAHEADER) + sizeof(RECT));
-		RGNDATAHEADER& header = *((RGNDATAHEADER*)&bytes[0]);
-		RECT* rects = (RECT*)(&bytes[0] + sizeof(RGNDATAHEADER));
-		header.dwSize = sizeof(RGNDATAHEADER);
-		header.iType = RDH_RECTANGLES;
-		header.nCount = 1;
-		header.nRgnSize = sizeof(RECT);
-		header.rcBound = this->boundingBox;
-		rects[0] = this->boundingBox;
+		return;
 	}
-	else if (this->regionType == COMPLEXREGION)
+	bool cutOff = CoordinatesOverflow(boundingBox.left, dx) || CoordinatesOverflow(boundingBox.top, dy) ||
+		CoordinatesOverflow(boundingBox.right, dx) || CoordinatesOverflow(boundingBox.bottom, dy);
+	for (size_t i = 0; i < rects.size(); i++)
 	{
-		DWORD size = ::GetRegionData(hrgn, 0, NULL);
-		bytes.resize(size);
-		if (size > 0)
-		{
-			DWORD success = ::GetRegionData(hrgn, (DWORD)bytes.size(), (LPRGNDATA)&bytes[0]);
-			if (!success) bytes.resize(0);
-		}
+		Rect& rect = rects[i];
+		rect.left = AddCoordinates(rect.left, dx);
+		rect.top = AddCoordinates(rect.top, dy);
+		rect.right = AddCoordinates(rect.right, dx);
+		rect.bottom = AddCoordinates(rect.bottom, dy);
 	}
-}
-
-void Region::AttachHrgn(HRGN *pOtherRegion)
-{
-	if (pOtherRegion == NULL) return;
-	if (this->hrgn != NULL)
+	if (cutOff)
 	{
-		DeleteObject(this->hrgn);
-		this->hrgn = NULL;
+		//Rectangles cut off at the end of the coordinate range can become empty, or match the band next to them, so the list is rebuilt
+		vector<Rect> cutRects;
+		cutRects.swap(rects);
+		vector<Rect> result;
+		VectorRectList<Rect> list(result);
+		Rect bounds;
+		BuildRectsUnion(cutRects.data(), cutRects.size(), list, bounds);
+		BecomeRects(result, bounds);
+		return;
 	}
-	this->hrgn = *pOtherRegion;
-	this->regionType = GetRgnBox(this->hrgn, &this->boundingBox);
-	if (this->regionType == 0)
+	boundingBox.left = AddCoordinates(boundingBox.left, dx);
+	boundingBox.top = AddCoordinates(boundingBox.top, dy);
+	boundingBox.right = AddCoordinates(boundingBox.right, dx);
+	boundingBox.bottom = AddCoordinates(boundingBox.bottom, dy);
+}
+template <class Coord>
+bool BasicRegion<Coord>::ContainsPoint(Coordinate x, Coordinate y) const
+{
+	if (rects.empty() || x < boundingBox.left || x >= boundingBox.right || y < boundingBox.top || y >= boundingBox.bottom)
 	{
-		this->hrgn = NULL;
-		Clear();
+		return false;
 	}
-	else
+	const Rect* pEnd = rects.data() + rects.size();
+	const Rect* pBand = FindBand(rects.data(), pEnd, y);
+	if (pBand == pEnd || pBand->top > y)
 	{
-		*pOtherRegion = NULL;
-		SetHrgnValid();
+		//y is in a gap between bands
+		return false;
 	}
+	const Rect* pBandEnd = FindBandEnd(pBand, pEnd);
+	const Rect* pSpan = FindSpan(pBand, pBandEnd, x);
+	return pSpan != pBandEnd && pSpan->left <= x;
 }
-HRGN Region::DetachHrgn()
+template <class Coord>
+bool BasicRegion<Coord>::operator==(const BasicRegion& other) const
 {
-	GetHrgn();
-	HRGN returnValue = this->hrgn;
-	this->hrgn = NULL;
-	Clear();
-	return returnValue;
+	//Banded rectangle lists are canonical, so equal regions have identical lists
+	return rects.size() == other.rects.size() && (rects.empty() || 0 == memcmp(rects.data(), other.rects.data(), sizeof(Rect) * rects.size()));
 }
-HRGN Region::DetachHrgnCopy() const
+template <class Coord>
+bool BasicRegion<Coord>::operator!=(const BasicRegion& other) const
 {
-	Region R2(*this);
-	return R2.DetachHrgn();
+	return !(*this == other);
 }
+template class BasicRegion<RegionCoord16>;
+template class BasicRegion<RegionCoord64>;
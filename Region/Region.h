@@ -1,9 +1,47 @@
 #pragma once
 
+#ifndef REGION_USE_WIN32
+//Option to build against Windows.h, which enables HRGN interop (AttachHrgn, DetachHrgn, and the HRGN overloads).
+//Without it, Region defines the handful of Win32 types it needs (RECT, DWORD, NULLREGION, etc) itself.
+#ifdef _WIN32
+#define REGION_USE_WIN32 1
+#else
+#define REGION_USE_WIN32 0
+#endif
+#endif
+
+#if REGION_USE_WIN32
 struct IUnknown;
 #define NOMINMAX
 #include <Windows.h>
+#else
+#include <stdint.h>
+typedef int32_t LONG;
+typedef uint32_t DWORD;
+struct RECT
+{
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+};
+struct RGNDATAHEADER
+{
+	DWORD dwSize;
+	DWORD iType;
+	DWORD nCount;
+	DWORD nRgnSize;
+	RECT rcBound;
+};
+#define NULLREGION 1
+#define SIMPLEREGION 2
+#define COMPLEXREGION 3
+#define RDH_RECTANGLES 1
+#endif
 
+#include <stddef.h>
+#include <stdint.h>
+#include <iterator>
 #include <vector>
 using std::vector;
 typedef unsigned char byte;
@@ -33,92 +71,383 @@ typedef unsigned char byte;
 #endif
 
 
-#ifndef REGION_USE_VALID_FLAG
-//option to use a "valid flag" instead of using the hrgn variable itself as the valid flag
-//(reduces api calls if region switches between simple and complex more than once)
-#define REGION_USE_VALID_FLAG 1
+#ifndef REGION_INLINE_RECT_COUNT
+//Number of rectangles a complex region can store inside of the Region object itself before it needs to allocate memory
+//(most complex regions are only a few rectangles, such as an L shape)
+#define REGION_INLINE_RECT_COUNT 4
+#endif
+
+#if REGION_INLINE_RECT_COUNT < 1
+#error REGION_INLINE_RECT_COUNT must be at least 1
+#endif
+
+#ifndef REGION_USE_STATS
+//Option to count which paths Region operations take and how long they take (see RegionStats.h).  When 0, the instrumentation compiles to nothing.
+#define REGION_USE_STATS 0
 #endif
 
-#ifndef REGION_USE_GLOBAL_TEMP_REGION
-//Option to use a global variable instead of an instance variable for the temporary region
-#define REGION_USE_GLOBAL_TEMP_REGION 1
+#ifndef REGION_USE_TRACE
+//Option to record Region operations to a trace file which can be replayed later (see RegionTrace.h).  When 0, the recording hooks compile to nothing.
+#define REGION_USE_TRACE 0
 #endif
 
-#if REGION_USE_GLOBAL_TEMP_REGION
-//Frees the temporary region used for combining GDI regions
-void FreeTempRegion();
+#ifndef REGION_USE_SIMD
+//Option to use SSE4.1 or AVX2 (picked at runtime from what the CPU supports) for operations which work on every rectangle
+//of a region, such as clipping a region to a rectangle (see RegionSimd.h).  When 0, only plain C++ code is used.
+#define REGION_USE_SIMD 1
 #endif
 
-//Wraps a GDI Region (avoiding Win32 API calls whenever possible), but if the Region can be represented as a RECT, wraps that instead.
+#ifndef REGION_USE_THREADS
+//Option to combine two very large complex regions on several threads, by splitting them into horizontal stripes (see RegionThreadPool.h).
+//When 0, every operation runs on the calling thread only.
+#define REGION_USE_THREADS 1
+#endif
+
+#ifndef REGION_PARALLEL_MIN_RECTS
+//Number of rectangles (both regions added together) from which a combine is split into stripes and run on several threads
+#define REGION_PARALLEL_MIN_RECTS 65536
+#endif
+
+#ifndef REGION_PARALLEL_STRIPE_MIN_RECTS
+//Stripes of a parallel combine have at least about this many rectangles, so the work of a stripe is worth handing to another thread
+#define REGION_PARALLEL_STRIPE_MIN_RECTS 256
+#endif
+
+#ifndef REGION_DESERIALIZE_MAX_RECTS
+//Largest number of rectangles Region::Deserialize builds (unless given another limit).  A band which repeats the band above takes only
+//a few bytes, so a small buffer could otherwise describe a huge region.
+#define REGION_DESERIALIZE_MAX_RECTS 4194304
+#endif
+
+//How Region::ScaleBy rounds edges which don't land on a whole coordinate
+enum RegionRounding
+{
+	//Left and top edges round down, right and bottom edges round up (covers at least the exact scaled area)
+	REGION_ROUND_OUTWARD,
+	//Left and top edges round up, right and bottom edges round down (covers at most the exact scaled area)
+	REGION_ROUND_INWARD,
+};
+
+//Pixel formats of the masks a Region can be built from
+enum RegionMaskFormat
+{
+	//1 bit per pixel, the most significant bit of each byte is the leftmost pixel, set bits are inside of the region (like a monochrome DIB)
+	REGION_MASK_1BPP,
+	//1 byte per pixel (such as alpha values), pixels which are at least the threshold are inside of the region
+	REGION_MASK_8BPP,
+};
+
+//What a FixedRegion does when the result of an operation has more rectangles than it can hold
+enum FixedRegionOverflow
+{
+	//The operation returns false and leaves the region unchanged
+	FIXED_REGION_FAIL,
+	//The operation returns false and the region becomes a bounding box which covers the whole result
+	FIXED_REGION_BOUNDING_BOX,
+};
+
+//A rectangle with coordinates of type T, laid out like RECT
+template <class T>
+struct BasicRect
+{
+	T left;
+	T top;
+	T right;
+	T bottom;
+};
+
+//Coordinate policies for BasicRegion: the type of a coordinate, and the type of rectangle the region stores.
+//(32-bit coordinates are Region itself, which stores RECTs.)
+//16-bit coordinates, for regions local to a tile (rectangles take half the memory of a RECT)
+struct RegionCoord16
+{
+	typedef int16_t Coordinate;
+	typedef BasicRect<int16_t> Rect;
+};
+//64-bit coordinates, for canvases too large for 32-bit coordinates
+struct RegionCoord64
+{
+	typedef int64_t Coordinate;
+	typedef BasicRect<int64_t> Rect;
+};
+
+//Rectangle helpers, for RECT and BasicRect alike. These are constexpr, so they also work on rectangles known at compile time.
+//True if rect1 covers up or is equal to rect2
+template <class Rect>
+constexpr bool RectCoversUpOther(const Rect& rect1, const Rect& rect2)
+{
+	return rect2.left >= rect1.left && rect2.right <= rect1.right &&
+		rect2.top >= rect1.top && rect2.bottom <= rect1.bottom;
+}
+//True if any part of rect1 overlaps any part of rect2 (adjacent is not overlapping)
+template <class Rect>
+constexpr bool RectOverlaps(const Rect& rect1, const Rect& rect2)
+{
+	return !(rect1.right <= rect2.left || rect2.right <= rect1.left || rect1.bottom <= rect2.top || rect2.bottom <= rect1.top);
+}
+//True if the two rectangles are equal
+template <class Rect>
+constexpr bool RectEquals(const Rect& rect1, const Rect& rect2)
+{
+	return rect1.left == rect2.left && rect1.top == rect2.top && rect1.right == rect2.right && rect1.bottom == rect2.bottom;
+}
+//True if the rectangle has no area
+template <class Rect>
+constexpr bool RectIsEmpty(const Rect& rect)
+{
+	return rect.left >= rect.right || rect.top >= rect.bottom;
+}
+//True if the union of two rectangles is also a rectangle: one covers up the other,
+//or they are aligned vertically or horizontally and overlap or touch.
+template <class Rect>
+constexpr bool RectUnionIsRect(const Rect& rect1, const Rect& rect2)
+{
+	return RectCoversUpOther(rect1, rect2) || RectCoversUpOther(rect2, rect1) ||
+		(rect1.top == rect2.top && rect1.bottom == rect2.bottom && rect1.left <= rect2.right && rect2.left <= rect1.right) ||
+		(rect1.left == rect2.left && rect1.right == rect2.right && rect1.top <= rect2.bottom && rect2.top <= rect1.bottom);
+}
+//The smallest rectangle which covers up both rectangles.  When RectUnionIsRect is true, this is their union.
+template <class Rect>
+constexpr Rect RectUnion(const Rect& rect1, const Rect& rect2)
+{
+	return Rect{ rect1.left < rect2.left ? rect1.left : rect2.left, rect1.top < rect2.top ? rect1.top : rect2.top,
+		rect1.right > rect2.right ? rect1.right : rect2.right, rect1.bottom > rect2.bottom ? rect1.bottom : rect2.bottom };
+}
+
+class RegionArena;
+
+//A list of rectangles which stores up to REGION_INLINE_RECT_COUNT rectangles inside of itself,
+//and only allocates memory when it needs to hold more than that.
+//Memory comes from the RegionArena that was current when the list was created (see RegionArenaScope), or from the heap.
+//Copies share allocated memory (reference counted), and a list only makes its own copy when it is about to be modified.
+class RegionRectList
+{
+public:
+	typedef RECT Rect;
+private:
+	//Points to inlineRects, or to allocated memory
+	RECT* pRects;
+	//Arena this list allocates from, or NULL to allocate from the heap
+	RegionArena* pArena;
+	//Number of rectangles in the list
+	size_t count;
+	//Number of rectangles that fit in pRects
+	size_t capacity;
+	//Space for a region data header directly in front of inlineRects (see UpdateDataHeader)
+	RGNDATAHEADER inlineHeader;
+	//Storage used until the list grows past REGION_INLINE_RECT_COUNT rectangles.
+	//Also used by SetRectDataHeader when the list is not in use.
+	RECT inlineRects[REGION_INLINE_RECT_COUNT];
+	//True if the rectangles are stored in inlineRects
+	bool IsInline() const;
+	//Releases the allocated memory (if any), and returns to using the inline storage
+	void FreeMemory();
+	//True if the allocated memory is shared with another list
+	bool IsShared() const;
+	//Makes a private copy of the allocated memory if it is shared with another list
+	void MakeUnique();
+	//True if this list may use the other list's allocated memory.  Heap memory can be used by any list, but arena memory only by lists
+	//which use the same arena, otherwise a list using the heap could be left pointing at arena memory after the arena is Reset.
+	bool CanUseMemoryOf(const RegionRectList& other) const;
+	//Becomes a copy of another list, sharing its allocated memory if possible
+	void CopyFrom(const RegionRectList& other);
+public:
+	//Creates an empty list, which allocates from the current arena
+	RegionRectList();
+	//Creates an empty list, which allocates from the arena (or the heap if pArena is NULL)
+	explicit RegionRectList(RegionArena* pArena);
+	//Creates a copy of another list (shares the other list's allocated memory)
+	RegionRectList(const RegionRectList& other);
+	//Destructor, frees allocated memory if needed
+	~RegionRectList();
+	//Copies another list (shares the other list's allocated memory)
+	RegionRectList& operator=(const RegionRectList& other);
+	//Returns the arena this list allocates from, or NULL for the heap
+	RegionArena* GetArena() const;
+	//Number of rectangles in the list
+	size_t Count() const;
+	//Pointer to the first rectangle, for modifying the rectangles (makes a private copy of shared memory first)
+	RECT* Data();
+	//Pointer to the first rectangle
+	const RECT* Data() const;
+	RECT& operator[](size_t index);
+	const RECT& operator[](size_t index) const;
+	//Makes sure the list can hold this many rectangles without allocating again
+	void Reserve(size_t newCapacity);
+	//Adds a rectangle to the end of the list
+	void Add(const RECT& rect);
+	//Shrinks the list to a smaller count
+	void Truncate(size_t newCount);
+	//Makes a private copy of shared storage, and marks the region data header as out of date, once for a run of changes.
+	//Until the list is copied again, the Writable functions below can change it without checking for shared storage on every call
+	//(such as when a band sweep appends rectangles one at a time).
+	void MakeWritable();
+	//Pointer to the first rectangle, for modifying the rectangles (MakeWritable must have been called)
+	RECT* WritableData();
+	//Adds a rectangle to the end of the list (MakeWritable must have been called)
+	void AddWritable(const RECT& rect);
+	//Shrinks the list to a smaller count (MakeWritable must have been called)
+	void TruncateWritable(size_t newCount);
+	//Changes the number of rectangles, and returns a pointer for writing them (rectangles added to the end are not initialized)
+	RECT* Resize(size_t newCount);
+	//Removes all rectangles (keeps allocated memory for later use)
+	void Clear();
+	//Replaces the contents of the list with a copy of an array of rectangles
+	void Assign(const RECT* pOtherRects, size_t otherCount);
+	//Swaps with another list.  Each list keeps its own arena, so rectangles in memory the other list can't use are copied instead of moved.
+	void Swap(RegionRectList& other);
+	//Writes the region data header in front of inline rectangles (bounds is the bounding box of the rectangles).
+	//Must be called after the list changes, before GetDataHeader is used.
+	void UpdateDataHeader(const RECT& bounds);
+	//Returns a region data header (bounds is the bounding box of the rectangles), which is directly followed by the rectangles in memory.
+	//The header in front of allocated rectangles is written the first time it's needed after the list changes.
+	const RGNDATAHEADER* GetDataHeader(const RECT& bounds) const;
+	//Writes a region data header followed by rectCount (0 or 1) copies of rect to the inline storage.
+	//Only for lists which are not in use (the Region is a Simple or Null region).
+	void SetRectDataHeader(const RECT& rect, size_t rectCount);
+	//Returns the header written by SetRectDataHeader
+	const RGNDATAHEADER* GetRectDataHeader() const;
+};
+
+//A run of pixels on one scanline of a region, from left up to (not including) right
+struct RegionSpan
+{
+	LONG y;
+	LONG left;
+	LONG right;
+};
+
+//Forward iterator over the spans of a y-x banded list of rectangles, one scanline at a time from top to bottom, and left to right within
+//a scanline.  Reads the rectangles where they are stored, and never allocates memory.
+class RegionSpanIterator
+{
+private:
+	//Current rectangle, or NULL at the end
+	const RECT* pRect;
+	//Rectangles of the current band which are inside of the clip rectangle
+	const RECT* pSpanBegin;
+	const RECT* pSpanEnd;
+	//End of the current band, and end of the bands which are inside of the clip rectangle
+	const RECT* pBandEnd;
+	const RECT* pEnd;
+	LONG clipLeft;
+	LONG clipRight;
+	LONG clipBottom;
+	//Last scanline of the current band which is inside of the clip rectangle, plus one
+	LONG bandBottom;
+	RegionSpan span;
+	//Moves to the first span of the first band at or after pBand with spans inside of the clip rectangle, starting at scanline top
+	void BeginBand(const RECT* pBand, LONG top);
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef RegionSpan value_type;
+	typedef ptrdiff_t difference_type;
+	typedef const RegionSpan* pointer;
+	typedef const RegionSpan& reference;
+	//Creates an iterator which is at the end
+	RegionSpanIterator();
+	//Creates an iterator at the first span of a banded list of rectangles which is inside of the clip rectangle (spans are clipped to it)
+	RegionSpanIterator(const RECT* pRects, size_t count, const RECT& clip);
+	const RegionSpan& operator*() const;
+	const RegionSpan* operator->() const;
+	//Moves to the next span
+	RegionSpanIterator& operator++();
+	RegionSpanIterator operator++(int);
+	bool operator==(const RegionSpanIterator& other) const;
+	bool operator!=(const RegionSpanIterator& other) const;
+};
+
+//The spans of a region (see Region::GetSpans), for use with range-based for loops.
+//Only valid until the region is modified or destroyed.
+class RegionSpans
+{
+private:
+	RegionSpanIterator first;
+public:
+	//Spans of a banded list of rectangles (such as from Region::GetRegionRects) which are inside of the clip rectangle
+	RegionSpans(const RECT* pRects, size_t count, const RECT& clip);
+	RegionSpanIterator begin() const;
+	RegionSpanIterator end() const;
+};
+
+//Manages Simple regions (rectangles) and Null regions directly, and Complex regions as a list of y-x banded rectangles.
+//No Win32 region API functions are used except to convert from or to an HRGN.
 class Region
 {
 private:
 	//For rectangluar regions, the entire region.  For Complex regions, the tightest bounding box that encloses the region.
 	//For empty regions, a (0, 0, 0, 0) rectangle.
 	RECT boundingBox;
-	//When this Region becomes a complex region, an hrgn object is created.
-	//If this HRGN becomes a rectangle or empty region, it remains valid
-	//until this Region object becomes a different rectangle or empty region.
-	HRGN hrgn;
-#if !REGION_USE_GLOBAL_TEMP_REGION
-	//Temporary region, used when a rectangle must be used with Win32 API calls
-	HRGN hrgnTemp;
-#endif
+	//For Complex regions, the rectangles that make up the region, in y-x banded order (same format as RGNDATA):
+	//Rectangles are sorted by top, then by left.  Rectangles with the same top form a band, and share the same bottom.
+	//Within a band, rectangles never overlap or touch.  Two touching bands never have the same list of left/right edges.
+	//Small complex regions are stored inline without allocating memory.
+	//Unused for Simple and Null regions (but keeps its capacity for the next time the region becomes complex).
+	RegionRectList rects;
 	//Region type (1 = NULLREGION, 2 = SIMPLEREGION, 3 = COMPLEXREGION)
 	byte regionType;
-#if REGION_USE_VALID_FLAG
-	//Indicates that the HRGN is accurate to the current state of the Region object.
-	//HRGN becomes valid when region becomes complex.
-	//Can remain valid if the last Win32 region API call turned this into a rectangle or empty region.
-	//Will become invalid if it becomes a different rectangle or empty region.
-	bool hrgnValid;
+	//For Complex regions, the number of pixels covered, the number of bands, and a hash of the rectangles (see GetHash).
+	//Worked out whenever the rectangle list is replaced, so the getters never walk the list.
+	int64_t area;
+	size_t bandCount;
+	uint64_t hash;
+#if REGION_USE_TRACE
+	//Identifies this region in the trace being recorded, or 0 if it hasn't appeared in the trace yet
+	//(mutable because regions used as operands are given ids too)
+	mutable DWORD traceId;
+	//Which recording traceId belongs to (ids from an earlier recording don't count)
+	mutable DWORD traceGeneration;
+	friend class RegionTrace;
 #endif
 private:
-	//Sets hrgn as invalid (Done when becoming a rectangle or null region)
-	void SetHrgnInvalid();
-	//Sets hrgn as valid (Done after becoming a complex region, which uses the Win32 region API calls)
-	void SetHrgnValid();
-	//Returns true if the HRGN is valid (Region is complex, or just became a rectangle or empty region)
-	bool HrgnIsValid() const;
-#if !REGION_USE_GLOBAL_TEMP_REGION
-	//Sets the temp region to a rectangle
-	HRGN SetTempRegion(const RECT& rect);
-#endif
-	//Turns this region into a rectangle (sets bounding box, sets region type, invalidates hrgn)
+	//Turns this region into a rectangle (sets bounding box, sets region type)
+	//An empty rectangle becomes a null region.
 	void BecomeRectangle(int left, int top, int right, int bottom);
-	//Turns this region into a rectangle (sets bounding box, sets region type, invalidates hrgn)
+	//Turns this region into a rectangle (sets bounding box, sets region type)
+	//An empty rectangle becomes a null region.
 	void BecomeRectangle(const RECT& rect);
 	//Turns this region into a copy of the other region (possibly a rectangle or null region)
 	void BecomeRegion(const Region& otherRegion);
+	//Turns this region into the banded rectangle list in result (swaps with the vector), bounds is the bounding box of the list.
+	//Becomes a rectangle or null region if result has one or zero rectangles.
+	void BecomeRects(RegionRectList& result, const RECT& bounds);
 	//Sets the bounding box a rectangle which contains both the current bounding box and the rect argument.
 	//This is the min of left/top, and the max of right/bottom.
-	//Call SetHrgnInvalid if the region is becoming that rectangle.
-	//Don't call SetHrgnInvalid for a complex region having its bounding box recalculated.
 	void UnionBoundingBox(const RECT& rect);
 	//Sets the bounding box to the intersection of the current bounding box and the rect argument.
 	//This is the max of right/bottom, and the min of left/top.
-	//After calling this, must check if the dimensions have become zero or negative, and must call SetHrgnInvalid.
+	//After calling this, must check if the dimensions have become zero or negative.
 	//Used for Intersection with two rectangles
 	void IntersectBoundingbox(const RECT& rect);
-	//True if rect1 covers up or is equal to rect2
-	static bool RectCoversUpOther(const RECT& rect1, const RECT& rect2);
-	//True if any part of rect1 overlaps any part of rect2 (adjacent is not overlapping)
-	//Only used for Intersection with rectangle
-	static bool RectOverlaps(const RECT& rect1, const RECT& rect2);
-	//True if the two rectangles are equal
-	static bool RectEquals(const RECT& rect1, const RECT& rect2);
 	//Unions (adds another rectangle to) this Region object.
 	//Only call this when this Region is guaranteed to be a rectangle region.
 	void UnionRectWithRect(const RECT& other);
 	//Called when performing a union with another rectangle would form a complex region, or we are already complex.
 	void UnionRectWithRectBecomeComplex(const RECT& other);
-	//Creates or Updates the HRGN for this Region object, so we can call Win32 region API functions.
-	//Also validates HRGN.  Doesn't do anything if the HRGN was already valid.
-	HRGN GetHrgn();
+	//Subtracts (removes a rectangle from) this Region object.
+	//Only call this when this Region is a rectangle region that overlaps the other rectangle without being covered up by it.
+	void SubtractRectFromRect(const RECT& other);
+	//Gets the rectangles that make up this region (the bounding box for a Simple region, nothing for a Null region)
+	const RECT* GetRectPointer(size_t& count) const;
+	//Works out area, bandCount and hash of a Complex region from its rectangles, and updates the region data header
+	void UpdateSummary();
+	//Writes the region data header for the current rectangles (see GetRegionData(size_t&)), called whenever the region changes
+	void UpdateDataHeader();
+	//Combines this region with a banded list of rectangles using the band sweep, and becomes the result.
+	void CombineWith(const RECT* pOtherRects, size_t otherCount, int operation);
+	//Intersects a complex region with a rectangle by clipping each rectangle (see RegionSimd.h), which is much faster than the band sweep.
+	//Only call this when the rectangle overlaps the region's bounding box.
+	void ClipToRect(const RECT& clip);
+	//Combines several banded rectangle lists in one sweep (operation is COMBINE_OR or COMBINE_AND), and becomes the result
+	void CombineAll(const RECT* const* ppRects, const size_t* pCounts, size_t listCount, int operation);
+#if REGION_USE_WIN32
+	//Turns this region into a copy of a GDI region.  Returns false if the HRGN is bad, and leaves this region unchanged.
+	bool BecomeHrgn(HRGN hrgn);
+#endif
 public:
 	//Create an empty Region object
 	Region();
-	//Destructor, frees HRGN if needed
+	//Destructor
 	~Region();
 	//Gets the type of the region (1 = NULLREGION, 2 = SIMPLEREGION (rectangle), 3 = COMPLEXREGION)
 	DWORD GetRegionType() const;
@@ -138,18 +467,34 @@ public:
 	//Copies the bounding box for the region to a rectangle. (3rd and 4th parameters are Width and Height)
 	//For rectangluar regions, the entire region.  For Complex regions, the tightest bounding box that encloses the region.
 	//For empty regions, a (0, 0, 0, 0) rectangle.
+	//A width or height too large for an int comes back as the largest int.
 	void GetBoundingBox(int& x, int& y, int& w, int& h) const;
+	//Returns the number of pixels inside of the region.  Kept up to date as the region changes, so this doesn't walk the rectangles.
+	//An area too large for an int64_t (only possible for regions spanning most of the coordinate range) comes back as the largest int64_t.
+	int64_t GetArea() const;
+	//Returns the number of rectangles in the region (0 for Null regions, 1 for Simple regions)
+	size_t GetRectCount() const;
+	//Returns the number of bands (rows of rectangles which share the same top and bottom) in the region
+	size_t GetBandCount() const;
+	//Returns a hash of the rectangles of the region.  Equal regions always have the same hash, so regions with different hashes are
+	//never equal.  Kept up to date as the region changes, like GetArea.
+	uint64_t GetHash() const;
 	//Sets this region to the null region
 	void Clear();
 	//Modifies this Region object, unions the region with a rectangle (adds a rectangle to the region)
 	void UnionWith(const RECT& other);
 	//Modifies this Region object, unions the region with a rectangle (adds a rectangle to the region)
 	void UnionWith(const RECT* pOtherRect);
+	//Modifies this Region object, unions the region with an array of rectangles (adds all of the rectangles to the region)
+	//The rectangles may be in any order, and may overlap.  Builds the union of the array in a single sweep.
+	void UnionWith(const RECT* pRects, size_t count);
 	//Modifies this Region object, unions the region with another region (adds another region)
 	void UnionWith(const Region& otherRegion);
+#if REGION_USE_WIN32
 	//Modifies this Region object, unions the region with another region (adds another region)
 	//If provided HRGN is bad, becomes a null region.  HRGN parameter is not modified.
 	void UnionWith(HRGN otherRegion);
+#endif
 	//Modifies this Region object, unions the region with a rectangle (adds a rectangle to the region, 3rd and 4th parameters are Width and Height)
 	void UnionWith(int x, int y, int w, int h);
 	//Modifies this Region object, gets the area which intersects with the rectangle (returns only the area which overlaps)
@@ -158,33 +503,96 @@ public:
 	void IntersectWith(const RECT* pOtherRect);
 	//Modifies this Region object, gets the area which intersects with the other region (returns only the area which overlaps)
 	void IntersectWith(const Region& otherRegion);
+#if REGION_USE_WIN32
 	//Modifies this Region object, gets the area which intersects with the other region (returns only the area which overlaps)
 	//If provided HRGN is bad, becomes a null region.  HRGN parameter is not modified.
 	void IntersectWith(HRGN hrgn);
+#endif
 	//Modifies this Region object, gets the area which intersects with the rectangle (returns only the area which overlaps, 3rd and 4th parameters are Width and Height)
 	void IntersectWith(int x, int y, int w, int h);
+	//Modifies this Region object, removes the area covered by a rectangle
+	void SubtractWith(const RECT& other);
+	//Modifies this Region object, removes the area covered by a rectangle
+	void SubtractWith(const RECT* pOtherRect);
+	//Modifies this Region object, removes the area covered by another region
+	void SubtractWith(const Region& otherRegion);
+#if REGION_USE_WIN32
+	//Modifies this Region object, removes the area covered by another region
+	//If provided HRGN is bad, becomes a null region.  HRGN parameter is not modified.
+	void SubtractWith(HRGN otherRegion);
+#endif
+	//Modifies this Region object, removes the area covered by a rectangle (3rd and 4th parameters are Width and Height)
+	void SubtractWith(int x, int y, int w, int h);
+	//Modifies this Region object, keeps the area covered by exactly one of this region or the rectangle
+	void XorWith(const RECT& other);
+	//Modifies this Region object, keeps the area covered by exactly one of this region or the rectangle
+	void XorWith(const RECT* pOtherRect);
+	//Modifies this Region object, keeps the area covered by exactly one of this region or the other region
+	void XorWith(const Region& otherRegion);
+#if REGION_USE_WIN32
+	//Modifies this Region object, keeps the area covered by exactly one of this region or the other region
+	//If provided HRGN is bad, becomes a null region.  HRGN parameter is not modified.
+	void XorWith(HRGN otherRegion);
+#endif
+	//Modifies this Region object, keeps the area covered by exactly one of this region or the rectangle (3rd and 4th parameters are Width and Height)
+	void XorWith(int x, int y, int w, int h);
 	//Returns a new Region object, unions the region with a rectangle (region combined with new rectangle)
-	Region Union(const RECT& otherRect);
+	Region Union(const RECT& otherRect) const;
 	//Returns a new Region object, unions the region with a rectangle (region combined with new rectangle)
-	Region Union(const RECT* pOtherRect);
+	Region Union(const RECT* pOtherRect) const;
 	//Returns a new Region object, unions the region with another region (region combined with other region)
-	Region Union(const Region& otherRegion);
+	Region Union(const Region& otherRegion) const;
+#if REGION_USE_WIN32
 	//Returns a new Region object, unions the region with another region (region combined with other region)
 	//If provided HRGN is bad, returns a null region.  HRGN parameter is not modified.
-	Region Union(HRGN otherRegion);
+	Region Union(HRGN otherRegion) const;
+#endif
 	//Returns a new Region object, unions the region with a rectangle (region combined with new rectangle, 3rd and 4th parameter are Width and Height)
-	Region Union(int x, int y, int w, int h);
+	Region Union(int x, int y, int w, int h) const;
 	//Returns a new Region object, gets the area which intersects with the rectangle (returns only the area which overlaps)
-	Region Intersect(const RECT& otherRect);
+	Region Intersect(const RECT& otherRect) const;
 	//Returns a new Region object, gets the area which intersects with the rectangle (returns only the area which overlaps)
-	Region Intersect(const RECT* pOtherRect);
+	Region Intersect(const RECT* pOtherRect) const;
 	//Returns a new Region object, gets the area which intersects with the other region (returns only the area which overlaps)
-	Region Intersect(const Region& otherRegion);
+	Region Intersect(const Region& otherRegion) const;
+#if REGION_USE_WIN32
 	//Returns a new Region object, gets the area which intersects with the other region (returns only the area which overlaps)
 	//If provided HRGN is bad, returns a null region
-	Region Intersect(HRGN otherRegion);
+	Region Intersect(HRGN otherRegion) const;
+#endif
 	//Returns a new Region object, gets the area which intersects with the other region (returns only the area which overlaps, 3rd and 4th parameter are Width and Height)
-	Region Intersect(int x, int y, int w, int h);
+	Region Intersect(int x, int y, int w, int h) const;
+	//Returns a new Region object, the region with the area covered by the rectangle removed
+	Region Subtract(const RECT& otherRect) const;
+	//Returns a new Region object, the region with the area covered by the rectangle removed
+	Region Subtract(const RECT* pOtherRect) const;
+	//Returns a new Region object, the region with the area covered by the other region removed
+	Region Subtract(const Region& otherRegion) const;
+#if REGION_USE_WIN32
+	//Returns a new Region object, the region with the area covered by the other region removed
+	//If provided HRGN is bad, returns a null region
+	Region Subtract(HRGN otherRegion) const;
+#endif
+	//Returns a new Region object, the region with the area covered by the rectangle removed (3rd and 4th parameter are Width and Height)
+	Region Subtract(int x, int y, int w, int h) const;
+	//Returns a new Region object, the area covered by exactly one of the region or the rectangle
+	Region Xor(const RECT& otherRect) const;
+	//Returns a new Region object, the area covered by exactly one of the region or the rectangle
+	Region Xor(const RECT* pOtherRect) const;
+	//Returns a new Region object, the area covered by exactly one of the region or the other region
+	Region Xor(const Region& otherRegion) const;
+#if REGION_USE_WIN32
+	//Returns a new Region object, the area covered by exactly one of the region or the other region
+	//If provided HRGN is bad, returns a null region
+	Region Xor(HRGN otherRegion) const;
+#endif
+	//Returns a new Region object, the area covered by exactly one of the region or the rectangle (3rd and 4th parameter are Width and Height)
+	Region Xor(int x, int y, int w, int h) const;
+
+	//Returns the union of several regions, combining all of them in a single top to bottom sweep (instead of one pass for each region)
+	static Region UnionAll(const Region* const* ppRegions, size_t count);
+	//Returns the intersection of several regions, combining all of them in a single top to bottom sweep (instead of one pass for each region)
+	static Region IntersectAll(const Region* const* ppRegions, size_t count);
 
 	//Creates a new region which is a rectangle
 	Region(const RECT& otherRect);
@@ -192,19 +600,30 @@ public:
 	Region(const RECT* pOtherRect);
 	//Creates a new region which is a copy of another region
 	Region(const Region& other);
+#if REGION_USE_WIN32
 	//Creates a new region which is a copy of another region
 	//If provided HRGN is bad, becomes a null region.  HRGN parameter is not modified, does not take ownership.
 	Region(HRGN otherRegion);
+#endif
+	//Creates a new region which is the union of an array of rectangles (in any order, may overlap)
+	Region(const RECT* pRects, size_t count);
 	//Creates a new region which is a rectangle, 3rd and 4th parameters are Width and Height.
+	//An edge which would go past the largest coordinate is cut off there instead of wrapping around.
 	Region(int x, int y, int w, int h);
 	//Creates a new region which is a union of two regions (region combined with another region)
 	Region(const Region& region1, const Region& region2);
 	//Creates a new region which is a union of two rectangles (rectangle combined with another rectangle)
 	Region(const RECT& rect1, const RECT& rect2);
+	//Creates a new region from a mask bitmap, covering the pixels which are inside of the mask (see RegionMaskFormat), with the top left pixel at (0, 0).
+	//Rows start stride bytes apart (a negative stride walks a bottom-up bitmap from its top row).  threshold is only used for 8bpp masks.
+	//Builds the bands directly from the runs of each row, and rows which are the same as the row above them become part of the same band.
+	Region(const byte* pMask, int width, int height, int stride, RegionMaskFormat format, byte threshold);
 
+#if REGION_USE_WIN32
 	//Attaches an HRGN to a new Region object.  This region object becomes the new owner of the HRGN.
 	//Value at pOtherRegion is set to NULL.  If a bad HRGN was provided, becomes an empty region.
 	Region(HRGN* pRegion);
+#endif
 
 	//Assigns another region to this region
 	Region& operator=(const Region& other);
@@ -215,15 +634,37 @@ public:
 	//Swaps with another region
 	void Swap(Region& other);
 
-	//Checks if two Regions are equal
+	//Moves the region by dx and dy, in place
+	//Edges moved past the end of the coordinate range are cut off there (parts moved entirely past it are lost).
+	void OffsetBy(int dx, int dy);
+	//Scales the region (coordinates and sizes) by num / den in place, such as for a DPI change.  num must not be negative, den must be positive.
+	//Each rectangle is scaled separately, then the region is only rebuilt if rounding caused rectangles to vanish, touch, or overlap.
+	void ScaleBy(int num, int den, RegionRounding rounding);
+	//Replaces the region with a larger region made of at most maxRects rectangles (such as for the dirty rectangles of a present call).
+	//Gaps between rectangles are filled in greedily, cheapest first, but the area added is limited to maxWastePercent percent of the
+	//region's area, so the region can end up with more than maxRects rectangles if the limit is reached first.
+	void Simplify(size_t maxRects, int maxWastePercent);
+
+	//Returns true if the point is inside of the region (points on the right or bottom edge of a rectangle are outside, like PtInRegion)
+	bool ContainsPoint(int x, int y) const;
+	//Returns true if the entire rectangle is inside of the region.  An empty rectangle is never contained.
+	bool ContainsRect(const RECT& rect) const;
+	//Returns true if the entire rectangle is inside of the region.  An empty rectangle is never contained.
+	bool ContainsRect(const RECT* pRect) const;
+	//Returns true if any part of the rectangle is inside of the region (like RectInRegion)
+	bool OverlapsRect(const RECT& rect) const;
+	//Returns true if any part of the rectangle is inside of the region (like RectInRegion)
+	bool OverlapsRect(const RECT* pRect) const;
+
+	//Checks if two Regions are equal (regions with different hashes or rectangle counts are rejected without comparing the rectangles)
 	bool operator==(const Region& other) const;
 	//Checks if two Regions are not equal
 	bool operator!=(const Region& other) const;
 #if !_NO_RVALUE_REFERENCE
-	//rvalue constructor, swaps with the other region
+	//rvalue constructor, takes the other region's rectangles and arena without allocating (the other region becomes empty)
 	Region(Region&& other) noexcept;
-	//rvalue assignment, swaps with the other region
-	Region& operator=(Region&& other) noexcept;
+	//rvalue assignment, swaps with the other region.  Not noexcept: a region keeps its own arena, so rectangles in another arena's memory are copied.
+	Region& operator=(Region&& other);
 #endif
 	//Returns a list of rectangles that make up the region
 	vector<RECT> GetRegionRects() const;
@@ -233,7 +674,33 @@ public:
 	void GetRegionRects(vector<RECT>& rects) const;
 	//Copies the bytes that make up the region into the vector
 	void GetRegionData(vector<byte>& bytes) const;
+	//Returns a pointer to the rectangles that make up the region without copying them, count receives the number of rectangles.
+	//The pointer is only valid until the region is modified or destroyed.
+	const RECT* GetRegionRects(size_t& count) const;
+	//Returns a pointer to the bytes that make up the region (an RGNDATA header followed by the rectangles) without copying the rectangles,
+	//size receives the number of bytes.  The header is kept in the region's own storage, so this doesn't allocate memory.
+	//The pointer is only valid until the region is modified or destroyed.
+	const RGNDATAHEADER* GetRegionData(size_t& size) const;
+	//Returns the spans of the region on scanlines top to bottom - 1, reading the rectangles without copying them.
+	//The spans are only valid until the region is modified or destroyed.
+	RegionSpans GetSpans(int top, int bottom) const;
+	//Returns the spans of the region which are inside of the clip rectangle, cut off at its left and right edges.
+	//The spans are only valid until the region is modified or destroyed.
+	RegionSpans GetSpans(const RECT& clip) const;
+	//Returns the number of bytes Serialize writes
+	size_t GetSerializedSize() const;
+	//Writes the region in a compact format (see Deserialize) to pDest, which must have room for GetSerializedSize() bytes.  Returns the number of bytes written.
+	size_t Serialize(byte* pDest) const;
+	//Replaces the contents of the vector with the region in a compact format (see Deserialize)
+	void Serialize(vector<byte>& bytes) const;
+	//Becomes the region written by Serialize, building the bands directly.  Each band is written as the distance from the band above it, its height,
+	//and its spans as the gap from the previous span and the width, all as varints, so it's much smaller than RGNDATA.
+	//Returns false if the data is not valid (such as cut short) or has more than REGION_DESERIALIZE_MAX_RECTS rectangles, and leaves this region unchanged.
+	bool Deserialize(const byte* pData, size_t size);
+	//Becomes the region written by Serialize, like Deserialize above, but returns false if the region would have more than maxRects rectangles
+	bool Deserialize(const byte* pData, size_t size, size_t maxRects);
 
+#if REGION_USE_WIN32
 	//Attaches an HRGN to this Region object.  This region object becomes the new owner of the HRGN.
 	//Value at pOtherRegion is set to NULL.  If a bad HRGN was provided, becomes an empty region.
 	void AttachHrgn(HRGN *pOtherRegion);
@@ -243,4 +710,251 @@ public:
 	//Returns a new HRGN which is a copy of this region. After calling this, you must free the HRGN using DeleteObject.
 	//Does not affect contents of this region
 	HRGN DetachHrgnCopy() const;
+#endif
+};
+
+//The parts of FixedRegion which don't depend on its capacity
+class FixedRegionBase
+{
+protected:
+	enum Operation
+	{
+		OPERATION_UNION,
+		OPERATION_INTERSECT,
+		OPERATION_SUBTRACT,
+		OPERATION_XOR,
+	};
+	//Writes a rectangle to pRects (room for one rectangle) and its bounding box, returns the number of rectangles (0 if it is empty)
+	static size_t SetRectangle(const RECT& rect, RECT* pRects, RECT& boundingBox);
+	//Combines a region (count banded rectangles in pRects, room for capacity) with another banded list of rectangles, building the result in pScratch
+	//(room for capacity rectangles).  Returns false if the result has more than capacity rectangles, the region is then left unchanged
+	//or becomes a bounding box, depending on overflow.
+	static bool Combine(RECT* pRects, size_t& count, RECT& boundingBox, size_t capacity, RECT* pScratch,
+		const RECT* pOtherRects, size_t otherCount, const RECT& otherBounds, Operation operation, FixedRegionOverflow overflow);
+	//Returns true if a point is inside of a banded list of rectangles
+	static bool RectsContainPoint(const RECT* pRects, size_t count, const RECT& boundingBox, int x, int y);
+	//Returns true if two banded lists of rectangles are the same
+	static bool RectsEqual(const RECT* pRects, size_t count, const RECT* pOtherRects, size_t otherCount);
+};
+
+//A region which holds up to N rectangles inside of itself, in the same y-x banded format as Region.  It never allocates memory
+//or uses the Win32 region API, and an operation costs at most one pass over the rectangles of both operands (plus a copy of N rectangles
+//on the stack), so it suits real-time code and tables of fixed clip regions.  Operations return false if the result doesn't fit,
+//and the overflow parameter picks what happens to the region then.
+template <size_t N, FixedRegionOverflow overflow = FIXED_REGION_FAIL>
+class FixedRegion : public FixedRegionBase
+{
+	static_assert(N > 0, "a FixedRegion must hold at least one rectangle");
+private:
+	//The rectangles of the region in y-x banded order, only the first count are used
+	RECT rects[N];
+	size_t count;
+	//Bounding box of the region, (0, 0, 0, 0) for an empty region
+	RECT boundingBox;
+	bool CombineWith(const RECT* pOtherRects, size_t otherCount, const RECT& otherBounds, Operation operation)
+	{
+		RECT scratch[N];
+		return Combine(rects, count, boundingBox, N, scratch, pOtherRects, otherCount, otherBounds, operation, overflow);
+	}
+	bool CombineWith(const RECT& rect, Operation operation)
+	{
+		RECT otherRect;
+		RECT otherBounds;
+		size_t otherCount = SetRectangle(rect, &otherRect, otherBounds);
+		return CombineWith(&otherRect, otherCount, otherBounds, operation);
+	}
+	bool CombineWith(const Region& region, Operation operation)
+	{
+		size_t otherCount;
+		const RECT* pOtherRects = region.GetRegionRects(otherCount);
+		return CombineWith(pOtherRects, otherCount, region.GetBoundingBox(), operation);
+	}
+public:
+	//Creates an empty region
+	FixedRegion()
+	{
+		Clear();
+	}
+	//Creates a region which is a rectangle
+	explicit FixedRegion(const RECT& rect)
+	{
+		count = SetRectangle(rect, rects, boundingBox);
+	}
+	//Sets this region to the empty region
+	void Clear()
+	{
+		RECT empty = {};
+		count = SetRectangle(empty, rects, boundingBox);
+	}
+	//Returns true for the empty region
+	bool IsEmpty() const
+	{
+		return count == 0;
+	}
+	//Returns the number of rectangles in the region
+	size_t GetRectCount() const
+	{
+		return count;
+	}
+	//Returns the rectangles of the region, in y-x banded order
+	const RECT* GetRects() const
+	{
+		return rects;
+	}
+	//Returns the bounding box of the region, (0, 0, 0, 0) for the empty region
+	const RECT& GetBoundingBox() const
+	{
+		return boundingBox;
+	}
+	//Returns true if the point is inside of the region
+	bool ContainsPoint(int x, int y) const
+	{
+		return RectsContainPoint(rects, count, boundingBox, x, y);
+	}
+	//Modifies this region, adds a rectangle, another fixed region, or a region to it.  Returns false if the result doesn't fit.
+	bool UnionWith(const RECT& rect)
+	{
+		return CombineWith(rect, OPERATION_UNION);
+	}
+	template <size_t M, FixedRegionOverflow otherOverflow>
+	bool UnionWith(const FixedRegion<M, otherOverflow>& other)
+	{
+		return CombineWith(other.GetRects(), other.GetRectCount(), other.GetBoundingBox(), OPERATION_UNION);
+	}
+	bool UnionWith(const Region& region)
+	{
+		return CombineWith(region, OPERATION_UNION);
+	}
+	//Modifies this region, intersects it with a rectangle, another fixed region, or a region.  Returns false if the result doesn't fit.
+	bool IntersectWith(const RECT& rect)
+	{
+		return CombineWith(rect, OPERATION_INTERSECT);
+	}
+	template <size_t M, FixedRegionOverflow otherOverflow>
+	bool IntersectWith(const FixedRegion<M, otherOverflow>& other)
+	{
+		return CombineWith(other.GetRects(), other.GetRectCount(), other.GetBoundingBox(), OPERATION_INTERSECT);
+	}
+	bool IntersectWith(const Region& region)
+	{
+		return CombineWith(region, OPERATION_INTERSECT);
+	}
+	//Modifies this region, removes a rectangle, another fixed region, or a region from it.  Returns false if the result doesn't fit.
+	bool SubtractWith(const RECT& rect)
+	{
+		return CombineWith(rect, OPERATION_SUBTRACT);
+	}
+	template <size_t M, FixedRegionOverflow otherOverflow>
+	bool SubtractWith(const FixedRegion<M, otherOverflow>& other)
+	{
+		return CombineWith(other.GetRects(), other.GetRectCount(), other.GetBoundingBox(), OPERATION_SUBTRACT);
+	}
+	bool SubtractWith(const Region& region)
+	{
+		return CombineWith(region, OPERATION_SUBTRACT);
+	}
+	//Modifies this region, xors it with a rectangle, another fixed region, or a region.  Returns false if the result doesn't fit.
+	bool XorWith(const RECT& rect)
+	{
+		return CombineWith(rect, OPERATION_XOR);
+	}
+	template <size_t M, FixedRegionOverflow otherOverflow>
+	bool XorWith(const FixedRegion<M, otherOverflow>& other)
+	{
+		return CombineWith(other.GetRects(), other.GetRectCount(), other.GetBoundingBox(), OPERATION_XOR);
+	}
+	bool XorWith(const Region& region)
+	{
+		return CombineWith(region, OPERATION_XOR);
+	}
+	//Returns true if both regions cover the same area
+	template <size_t M, FixedRegionOverflow otherOverflow>
+	bool operator==(const FixedRegion<M, otherOverflow>& other) const
+	{
+		return RectsEqual(rects, count, other.GetRects(), other.GetRectCount());
+	}
+	template <size_t M, FixedRegionOverflow otherOverflow>
+	bool operator!=(const FixedRegion<M, otherOverflow>& other) const
+	{
+		return !(*this == other);
+	}
+	//Returns a Region with the same area
+	Region ToRegion() const
+	{
+		return Region(rects, count);
+	}
+};
+
+//A region with the coordinate type picked by a coordinate policy (RegionCoord16 or RegionCoord64), in the same y-x banded format as Region.
+//Operations use the same band sweep as Region, compiled for the policy's coordinate type.  Region is the region with 32-bit coordinates,
+//and only it converts to and from RECT lists, RGNDATA and HRGNs.  Edges which would move past the end of the coordinate range are cut off there.
+template <class Coord>
+class BasicRegion
+{
+public:
+	typedef typename Coord::Coordinate Coordinate;
+	typedef typename Coord::Rect Rect;
+private:
+	//The rectangles of the region in y-x banded order (one rectangle for a Simple region, none for a Null region)
+	vector<Rect> rects;
+	//Bounding box of the region, (0, 0, 0, 0) for an empty region
+	Rect boundingBox;
+	//Turns this region into a rectangle, or the empty region if the rectangle is empty
+	void BecomeRectangle(const Rect& rect);
+	//Becomes a banded list of rectangles with bounding box bounds (takes the contents of the vector)
+	void BecomeRects(vector<Rect>& result, const Rect& bounds);
+	//Combines this region with a banded list of rectangles using the band sweep, and becomes the result
+	void CombineWith(const Rect* pOtherRects, size_t otherCount, int operation);
+public:
+	//Creates an empty region
+	BasicRegion();
+	//Creates a region which is a rectangle
+	explicit BasicRegion(const Rect& rect);
+	//Creates a region which is a rectangle (3rd and 4th parameters are Width and Height)
+	BasicRegion(Coordinate x, Coordinate y, Coordinate w, Coordinate h);
+	//Creates a region which is the union of an array of rectangles (in any order, and may overlap)
+	BasicRegion(const Rect* pRects, size_t count);
+	//Gets the type of the region (1 = NULLREGION, 2 = SIMPLEREGION (rectangle), 3 = COMPLEXREGION)
+	DWORD GetRegionType() const;
+	//Gets the bounding box of the region, a (0, 0, 0, 0) rectangle for an empty region
+	const Rect& GetBoundingBox() const;
+	//Returns a pointer to the rectangles that make up the region, count receives the number of rectangles.
+	//The pointer is only valid until the region is modified or destroyed.
+	const Rect* GetRegionRects(size_t& count) const;
+	//Returns the number of rectangles in the region
+	size_t GetRectCount() const;
+	//Returns the number of pixels inside of the region, or the largest int64_t if that doesn't fit
+	int64_t GetArea() const;
+	//Sets this region to the null region
+	void Clear();
+	//Modifies this region, unions it with a rectangle or another region
+	void UnionWith(const Rect& rect);
+	void UnionWith(const BasicRegion& other);
+	//Modifies this region, intersects it with a rectangle or another region
+	void IntersectWith(const Rect& rect);
+	void IntersectWith(const BasicRegion& other);
+	//Modifies this region, removes a rectangle or another region from it
+	void SubtractWith(const Rect& rect);
+	void SubtractWith(const BasicRegion& other);
+	//Modifies this region, xors it with a rectangle or another region
+	void XorWith(const Rect& rect);
+	void XorWith(const BasicRegion& other);
+	//Returns the union of this region and another region
+	BasicRegion Union(const BasicRegion& other) const;
+	//Returns the intersection of this region and another region
+	BasicRegion Intersect(const BasicRegion& other) const;
+	//Returns this region with another region removed from it
+	BasicRegion Subtract(const BasicRegion& other) const;
+	//Returns the area inside of exactly one of the regions
+	BasicRegion Xor(const BasicRegion& other) const;
+	//Moves the region by dx, dy.  Parts moved past the end of the coordinate range are cut off.
+	void OffsetBy(Coordinate dx, Coordinate dy);
+	//True if the pixel at x, y is inside of the region
+	bool ContainsPoint(Coordinate x, Coordinate y) const;
+	//Returns true if both regions cover the same area
+	bool operator==(const BasicRegion& other) const;
+	bool operator!=(const BasicRegion& other) const;
 };
+//Defined in Region.cpp for these coordinate policies
+extern template class BasicRegion<RegionCoord16>;
+extern template class BasicRegion<RegionCoord64>;
@@ -0,0 +1,169 @@
+#include "RegionAccumulator.h"
+
+//Ids given to accumulators
+static std::atomic<uint64_t> nextAccumulatorId(1);
+
+//Slots given to accumulators, a slot is reused once its accumulator is destroyed
+struct AccumulatorSlots
+{
+	std::mutex mutex;
+	size_t slotCount;
+	vector<size_t> freeSlots;
+};
+static AccumulatorSlots& GetAccumulatorSlots()
+{
+	static AccumulatorSlots slots;
+	return slots;
+}
+
+//Buffers the current thread has made, indexed by accumulator slot.
+//An entry left by a destroyed accumulator has an old id, and is replaced when the slot's next accumulator adds from this thread,
+//so the list only grows to the most accumulators alive at once.
+struct ThreadBufferEntry
+{
+	uint64_t accumulatorId;
+	void* pBuffer;
+};
+static thread_local vector<ThreadBufferEntry> threadBuffers;
+
+RegionAccumulator::RegionAccumulator()
+{
+	this->id = nextAccumulatorId.fetch_add(1, std::memory_order_relaxed);
+	this->pFirstBuffer = NULL;
+	AccumulatorSlots& slots = GetAccumulatorSlots();
+	std::lock_guard<std::mutex> lock(slots.mutex);
+	if (!slots.freeSlots.empty())
+	{
+		this->slot = slots.freeSlots.back();
+		slots.freeSlots.pop_back();
+	}
+	else
+	{
+		this->slot = slots.slotCount++;
+	}
+}
+
+RegionAccumulator::~RegionAccumulator()
+{
+	ThreadBuffer* pNextBuffer;
+	for (ThreadBuffer* pBuffer = pFirstBuffer.load(std::memory_order_acquire); pBuffer != NULL; pBuffer = pNextBuffer)
+	{
+		pNextBuffer = pBuffer->pNextBuffer;
+		Chunk* pNextChunk;
+		for (Chunk* pChunk = pBuffer->pReadChunk; pChunk != NULL; pChunk = pNextChunk)
+		{
+			pNextChunk = pChunk->pNext.load(std::memory_order_acquire);
+			delete pChunk;
+		}
+		delete pBuffer;
+	}
+	AccumulatorSlots& slots = GetAccumulatorSlots();
+	std::lock_guard<std::mutex> lock(slots.mutex);
+	slots.freeSlots.push_back(this->slot);
+}
+
+/*static*/ RegionAccumulator::Chunk* RegionAccumulator::NewChunk()
+{
+	Chunk* pChunk = new Chunk;
+	pChunk->pNext.store(NULL, std::memory_order_relaxed);
+	pChunk->count.store(0, std::memory_order_relaxed);
+	return pChunk;
+}
+
+RegionAccumulator::ThreadBuffer* RegionAccumulator::GetThreadBuffer()
+{
+	if (this->slot < threadBuffers.size() && threadBuffers[this->slot].accumulatorId == this->id)
+	{
+		return (ThreadBuffer*)threadBuffers[this->slot].pBuffer;
+	}
+	ThreadBuffer* pBuffer = new ThreadBuffer;
+	pBuffer->pWriteChunk = NewChunk();
+	pBuffer->pReadChunk = pBuffer->pWriteChunk;
+	pBuffer->readIndex = 0;
+	//Adds the buffer to the front of the list
+	ThreadBuffer* pFirst = pFirstBuffer.load(std::memory_order_relaxed);
+	do
+	{
+		pBuffer->pNextBuffer = pFirst;
+	} while (!pFirstBuffer.compare_exchange_weak(pFirst, pBuffer, std::memory_order_release, std::memory_order_relaxed));
+	if (this->slot >= threadBuffers.size())
+	{
+		ThreadBufferEntry unused = { 0, NULL };
+		threadBuffers.resize(this->slot + 1, unused);
+	}
+	threadBuffers[this->slot].accumulatorId = this->id;
+	threadBuffers[this->slot].pBuffer = pBuffer;
+	return pBuffer;
+}
+
+void RegionAccumulator::Add(const RECT& rect)
+{
+	Add(&rect, 1);
+}
+
+void RegionAccumulator::Add(const RECT* pRects, size_t count)
+{
+	ThreadBuffer* pBuffer = GetThreadBuffer();
+	Chunk* pChunk = pBuffer->pWriteChunk;
+	size_t chunkCount = pChunk->count.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < count; i++)
+	{
+		const RECT& rect = pRects[i];
+		if (rect.left >= rect.right || rect.top >= rect.bottom)
+		{
+			continue;
+		}
+		if (chunkCount == ChunkRectCount)
+		{
+			//The consumer only moves past a full block once the next one is linked, and never frees the block being written to
+			Chunk* pNewChunk = NewChunk();
+			pChunk->pNext.store(pNewChunk, std::memory_order_release);
+			pBuffer->pWriteChunk = pNewChunk;
+			pChunk = pNewChunk;
+			chunkCount = 0;
+		}
+		pChunk->rects[chunkCount] = rect;
+		chunkCount++;
+		//Publishes the rectangle to the consumer
+		pChunk->count.store(chunkCount, std::memory_order_release);
+	}
+}
+
+void RegionAccumulator::Add(const Region& region)
+{
+	size_t count;
+	const RECT* pRects = region.GetRegionRects(count);
+	Add(pRects, count);
+}
+
+void RegionAccumulator::DrainInto(Region& region)
+{
+	std::lock_guard<std::mutex> lock(drainMutex);
+	drained.clear();
+	for (ThreadBuffer* pBuffer = pFirstBuffer.load(std::memory_order_acquire); pBuffer != NULL; pBuffer = pBuffer->pNextBuffer)
+	{
+		while (true)
+		{
+			Chunk* pChunk = pBuffer->pReadChunk;
+			size_t chunkCount = pChunk->count.load(std::memory_order_acquire);
+			drained.insert(drained.end(), pChunk->rects + pBuffer->readIndex, pChunk->rects + chunkCount);
+			pBuffer->readIndex = chunkCount;
+			if (chunkCount < ChunkRectCount)
+			{
+				break;
+			}
+			Chunk* pNextChunk = pChunk->pNext.load(std::memory_order_acquire);
+			if (pNextChunk == NULL)
+			{
+				break;
+			}
+			delete pChunk;
+			pBuffer->pReadChunk = pNextChunk;
+			pBuffer->readIndex = 0;
+		}
+	}
+	if (!drained.empty())
+	{
+		region.UnionWith(drained.data(), drained.size());
+	}
+}
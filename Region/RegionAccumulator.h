@@ -0,0 +1,63 @@
+#pragma once
+#include "Region.h"
+#include <atomic>
+#include <mutex>
+
+//Collects dirty rectangles from many threads at once, and unions them into a Region when the consumer asks for them (such as at the end of a frame).
+//Each thread adds to its own buffer without locking or waiting on the other threads, and the consumer builds the union of everything
+//in a single sweep (see Region::UnionWith(const RECT*, size_t)) instead of combining one rectangle at a time.
+class RegionAccumulator
+{
+private:
+	//Number of rectangles in each block of a thread's buffer
+	static const size_t ChunkRectCount = 256;
+	//A block of rectangles added by one thread
+	struct Chunk
+	{
+		//Next block, set by the adding thread once this one is full
+		std::atomic<Chunk*> pNext;
+		//Number of rectangles written to this block, only changed by the adding thread
+		std::atomic<size_t> count;
+		RECT rects[ChunkRectCount];
+	};
+	//The buffer of one thread: a list of blocks which the thread adds to at the end, and the consumer reads and frees from the start
+	struct ThreadBuffer
+	{
+		//Next buffer in the list of all buffers
+		ThreadBuffer* pNextBuffer;
+		//Block the thread is adding to (only used by the adding thread)
+		Chunk* pWriteChunk;
+		//Block the consumer reads next, and how many of its rectangles it has already read (only used by the consumer)
+		Chunk* pReadChunk;
+		size_t readIndex;
+	};
+	//Identifies this accumulator to the threads' lists of their buffers (never reused, unlike addresses)
+	uint64_t id;
+	//Index of this accumulator's entry in each thread's list of its buffers (reused by later accumulators, which have a different id)
+	size_t slot;
+	//List of the buffers of every thread which has added anything, newest first
+	std::atomic<ThreadBuffer*> pFirstBuffer;
+	//Held while draining, only one thread drains at a time
+	std::mutex drainMutex;
+	//Rectangles gathered from the buffers while draining (kept to avoid allocating again)
+	vector<RECT> drained;
+	//Returns the calling thread's buffer, creating it the first time
+	ThreadBuffer* GetThreadBuffer();
+	static Chunk* NewChunk();
+	//Not copyable
+	RegionAccumulator(const RegionAccumulator& other);
+	RegionAccumulator& operator=(const RegionAccumulator& other);
+public:
+	//Creates an empty accumulator
+	RegionAccumulator();
+	//Destructor, frees every thread's buffer.  No thread may still be adding rectangles.
+	~RegionAccumulator();
+	//Adds a rectangle, can be called from any number of threads at once
+	void Add(const RECT& rect);
+	//Adds an array of rectangles, can be called from any number of threads at once
+	void Add(const RECT* pRects, size_t count);
+	//Adds every rectangle of a region, can be called from any number of threads at once
+	void Add(const Region& region);
+	//Unions everything added since the last call into a region.  Rectangles added while this runs are either included, or kept for the next call.
+	void DrainInto(Region& region);
+};
@@ -0,0 +1,123 @@
+#include "RegionArena.h"
+#include <assert.h>
+#include <stdint.h>
+#include <new>
+
+//Allocations are aligned to this many bytes
+static const size_t ArenaAlignment = 16;
+//Size of a chunk header, rounded up so the memory after it stays aligned
+static const size_t ChunkHeaderSize = (sizeof(void*) + sizeof(size_t) + ArenaAlignment - 1) & ~(ArenaAlignment - 1);
+
+//Arena used by Region objects created on this thread
+static thread_local RegionArena* currentArena = NULL;
+
+RegionArena::RegionArena(size_t chunkSize)
+{
+	this->pFirstChunk = NULL;
+	this->pChunk = NULL;
+	this->used = 0;
+	this->lastAllocation = SIZE_MAX;
+	this->chunkSize = chunkSize;
+	this->liveAllocations = 0;
+}
+
+RegionArena::~RegionArena()
+{
+	assert(liveAllocations == 0);
+	Chunk* pNextChunk;
+	for (Chunk* pChunk = pFirstChunk; pChunk != NULL; pChunk = pNextChunk)
+	{
+		pNextChunk = pChunk->pNext;
+		::operator delete(pChunk);
+	}
+}
+
+char* RegionArena::ChunkMemory(Chunk* pChunk)
+{
+	return (char*)pChunk + ChunkHeaderSize;
+}
+
+void* RegionArena::Allocate(size_t size)
+{
+	size = (size + ArenaAlignment - 1) & ~(ArenaAlignment - 1);
+	if (pChunk == NULL || used + size > pChunk->size)
+	{
+		//Move on to the next chunk (left over from before a Reset) if it's big enough, otherwise add a new chunk after the current one
+		Chunk* pNextChunk = pChunk != NULL ? pChunk->pNext : pFirstChunk;
+		if (pNextChunk == NULL || pNextChunk->size < size)
+		{
+			size_t newSize = size > chunkSize ? size : chunkSize;
+			Chunk* pNewChunk = (Chunk*)::operator new(ChunkHeaderSize + newSize);
+			pNewChunk->size = newSize;
+			pNewChunk->pNext = pNextChunk;
+			if (pChunk != NULL)
+			{
+				pChunk->pNext = pNewChunk;
+			}
+			else
+			{
+				pFirstChunk = pNewChunk;
+			}
+			pNextChunk = pNewChunk;
+		}
+		pChunk = pNextChunk;
+		used = 0;
+	}
+	void* pMemory = ChunkMemory(pChunk) + used;
+	lastAllocation = used;
+	used += size;
+	liveAllocations++;
+	return pMemory;
+}
+
+void RegionArena::Free(void* pMemory)
+{
+	if (pMemory == NULL)
+	{
+		return;
+	}
+	assert(liveAllocations > 0);
+	liveAllocations--;
+	//Freeing the most recent allocation (such as a temporary region) gives the memory back right away
+	if (lastAllocation != SIZE_MAX && pMemory == ChunkMemory(pChunk) + lastAllocation)
+	{
+		used = lastAllocation;
+		lastAllocation = SIZE_MAX;
+	}
+}
+
+void RegionArena::Reset()
+{
+	//A Region still using the arena would be left pointing at memory which is about to be reused
+	assert(liveAllocations == 0);
+	pChunk = NULL;
+	used = 0;
+	lastAllocation = SIZE_MAX;
+}
+
+size_t RegionArena::GetLiveAllocations() const
+{
+	return liveAllocations;
+}
+
+/*static*/ RegionArena* RegionArena::GetCurrent()
+{
+	return currentArena;
+}
+
+RegionArenaScope::RegionArenaScope(RegionArena& arena)
+{
+	this->pPreviousArena = currentArena;
+	currentArena = &arena;
+}
+
+RegionArenaScope::RegionArenaScope(RegionArena* pArena)
+{
+	this->pPreviousArena = currentArena;
+	currentArena = pArena;
+}
+
+RegionArenaScope::~RegionArenaScope()
+{
+	currentArena = this->pPreviousArena;
+}
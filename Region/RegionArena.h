@@ -0,0 +1,74 @@
+#pragma once
+#include <stddef.h>
+
+//A bump allocator for the rectangle storage of short-lived Region objects.
+//Memory is handed out from large chunks, and is only given back all at once by Reset (for example, at the end of each frame).
+//Chunks are kept after a Reset, so once the arena has grown big enough for a frame, it no longer allocates from the heap.
+//Only the rectangle storage of Regions comes from the arena.  Temporary buffers used while an operation runs (such as the
+//std::vector scratch of UnionAll, BuildRectsUnion, CombineLists and Simplify) still come from the heap, and are freed before it returns.
+class RegionArena
+{
+private:
+	//Header at the start of each chunk of memory
+	struct Chunk
+	{
+		//Next chunk in the list
+		Chunk* pNext;
+		//Number of usable bytes after the header
+		size_t size;
+	};
+	//First chunk in the list
+	Chunk* pFirstChunk;
+	//Chunk currently being allocated from, chunks after this one are empty
+	Chunk* pChunk;
+	//Number of bytes used in the current chunk
+	size_t used;
+	//Offset in the current chunk of the most recent allocation (so freeing it right away can give the memory back), or SIZE_MAX
+	size_t lastAllocation;
+	//Minimum size of new chunks
+	size_t chunkSize;
+	//Number of allocations which have not been freed yet
+	size_t liveAllocations;
+	//Returns a pointer to the usable memory of a chunk
+	static char* ChunkMemory(Chunk* pChunk);
+	//Not copyable
+	RegionArena(const RegionArena& other);
+	RegionArena& operator=(const RegionArena& other);
+public:
+	//Creates an empty arena, no memory is allocated until the first allocation
+	RegionArena(size_t chunkSize = 65536);
+	//Destructor, frees all chunks
+	~RegionArena();
+	//Allocates memory from the arena (aligned to 16 bytes)
+	void* Allocate(size_t size);
+	//Marks an allocation as no longer used.  The memory is only reused if it was the most recent allocation, otherwise it waits for Reset.
+	void Free(void* pMemory);
+	//Makes all of the memory available again.  Every allocation must already be freed (every Region using the arena must be destroyed).
+	void Reset();
+	//Returns the number of allocations which have not been freed
+	size_t GetLiveAllocations() const;
+	//Returns the arena Region objects created on this thread will allocate from, or NULL if they use the heap
+	static RegionArena* GetCurrent();
+};
+
+//While a RegionArenaScope object exists, Region objects created on this thread allocate their rectangle storage from the arena.
+//Regions keep using the arena they were created with, so Regions created outside of the scope keep using the heap.
+//Regions created inside of the scope must be destroyed before the arena is Reset, don't move them into longer lived Regions.
+//(A Region move constructed from another Region keeps using the other Region's arena.)
+//Scopes can be nested, the previous arena becomes current again when the scope ends.
+class RegionArenaScope
+{
+private:
+	//Arena which was current before this scope started
+	RegionArena* pPreviousArena;
+	//Not copyable
+	RegionArenaScope(const RegionArenaScope& other);
+	RegionArenaScope& operator=(const RegionArenaScope& other);
+public:
+	//Makes the arena current for this thread
+	RegionArenaScope(RegionArena& arena);
+	//Makes the arena current for this thread, or the heap if pArena is NULL (such as for creating long lived Regions while another scope is active)
+	explicit RegionArenaScope(RegionArena* pArena);
+	//Makes the previous arena current again
+	~RegionArenaScope();
+};
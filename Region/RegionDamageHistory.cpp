@@ -0,0 +1,88 @@
+#include "RegionDamageHistory.h"
+
+RegionDamageHistory::RegionDamageHistory(int capacity)
+{
+	if (capacity < 1)
+	{
+		capacity = 1;
+	}
+	frames.resize(capacity);
+	cumulative.resize(capacity);
+	newest = 0;
+	frameCount = 0;
+}
+
+int RegionDamageHistory::GetCapacity() const
+{
+	return (int)frames.size();
+}
+
+int RegionDamageHistory::GetFrameCount() const
+{
+	return (int)frameCount;
+}
+
+void RegionDamageHistory::AddFrame(const Region& damage)
+{
+	size_t capacity = frames.size();
+	newest = (newest + 1) % capacity;
+	frames[newest] = damage;
+	if (frameCount < capacity)
+	{
+		frameCount++;
+	}
+	//Each union grows by one frame: the union of the newest i + 1 frames is the old union of the newest i frames plus the new damage.
+	//Swapping moves the old unions along without copying them, and the oldest union (which is dropped) ends up at the front to be replaced.
+	for (size_t i = frameCount - 1; i > 0; i--)
+	{
+		cumulative[i].Swap(cumulative[i - 1]);
+		cumulative[i].UnionWith(damage);
+	}
+	cumulative[0] = damage;
+}
+
+void RegionDamageHistory::Clear()
+{
+	for (size_t i = 0; i < frames.size(); i++)
+	{
+		frames[i].Clear();
+		cumulative[i].Clear();
+	}
+	newest = 0;
+	frameCount = 0;
+}
+
+bool RegionDamageHistory::GetDamageSince(int age, Region& result) const
+{
+	const Region* pDamage = GetDamageSince(age);
+	if (pDamage == NULL)
+	{
+		result.Clear();
+		return false;
+	}
+	result = *pDamage;
+	return true;
+}
+
+const Region* RegionDamageHistory::GetDamageSince(int age) const
+{
+	if (age < 1 || (size_t)age > frameCount)
+	{
+		return NULL;
+	}
+	return &cumulative[age - 1];
+}
+
+bool RegionDamageHistory::GetDamageChange(int age, Region& result) const
+{
+	if (age < 0 || (size_t)age >= frameCount)
+	{
+		result.Clear();
+		return false;
+	}
+	size_t capacity = frames.size();
+	const Region& older = frames[(newest + capacity - age) % capacity];
+	result = frames[newest];
+	result.XorWith(older);
+	return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "Region.h"
+
+//Keeps the damage (changed area) of the last few frames, for drawing only the damaged part of a frame into a swap chain buffer which
+//still holds an older frame.  With a buffer age of N (the buffer holds the frame from N frames ago, as reported by EGL_EXT_buffer_age
+//or similar), the part of the buffer to redraw is the union of the damage of the last N frames.
+//Those unions are kept up to date as frames are added, so looking one up doesn't combine any regions.
+class RegionDamageHistory
+{
+private:
+	//Damage of each frame, in a ring, newest frame at frames[newest]
+	vector<Region> frames;
+	//cumulative[i] is the union of the damage of the newest i + 1 frames
+	vector<Region> cumulative;
+	//Index of the newest frame in frames
+	size_t newest;
+	//Number of frames added (up to the capacity)
+	size_t frameCount;
+public:
+	//Creates a history which remembers the damage of up to capacity frames (the largest buffer age it can answer for)
+	explicit RegionDamageHistory(int capacity);
+	//Returns the number of frames the history can remember
+	int GetCapacity() const;
+	//Returns the number of frames in the history
+	int GetFrameCount() const;
+	//Adds the damage of a new frame, forgetting the oldest frame if the history is full.  Call this before drawing the frame.
+	void AddFrame(const Region& damage);
+	//Forgets every frame (such as after the swap chain is resized, when no buffer holds anything useful)
+	void Clear();
+	//Gets the union of the damage of the newest age frames: what to redraw in a buffer which holds the frame from age frames ago.
+	//Returns false (and clears result) if age is 0 (the buffer's contents are unknown) or older than the history, then the whole buffer must be redrawn.
+	bool GetDamageSince(int age, Region& result) const;
+	//Returns the union of the damage of the newest age frames (see GetDamageSince), or NULL if the whole buffer must be redrawn.
+	//The pointer is only valid until the next call to AddFrame or Clear.
+	const Region* GetDamageSince(int age) const;
+	//Gets the area damaged in only one of the newest frame and the frame age frames before it (the part of the damage which moved or changed shape).
+	//Returns false (and clears result) if the history doesn't go back that far.
+	bool GetDamageChange(int age, Region& result) const;
+};
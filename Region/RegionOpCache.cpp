@@ -0,0 +1,186 @@
+#include "RegionOpCache.h"
+#include "RegionArena.h"
+
+//Combines the operation and the hashes of its operands into the key of a cache entry
+static uint64_t EntryKey(RegionOperation operation, uint64_t hash1, uint64_t hash2)
+{
+	uint64_t key = (hash1 ^ (uint64_t)operation) * 0x9E3779B97F4A7C15ull;
+	key = (key ^ (key >> 29) ^ hash2) * 0xBF58476D1CE4E5B9ull;
+	return key ^ (key >> 32);
+}
+
+RegionOpCache::RegionOpCache(size_t maxRects)
+{
+	this->maxRects = maxRects;
+	rectCount = 0;
+	hitCount = 0;
+	missCount = 0;
+}
+
+Region RegionOpCache::Union(const Region& region1, const Region& region2)
+{
+	return Combine(REGION_OP_UNION, region1, region2);
+}
+
+Region RegionOpCache::Intersect(const Region& region1, const Region& region2)
+{
+	return Combine(REGION_OP_INTERSECT, region1, region2);
+}
+
+Region RegionOpCache::Subtract(const Region& region1, const Region& region2)
+{
+	return Combine(REGION_OP_SUBTRACT, region1, region2);
+}
+
+Region RegionOpCache::Xor(const Region& region1, const Region& region2)
+{
+	return Combine(REGION_OP_XOR, region1, region2);
+}
+
+Region RegionOpCache::Combine(RegionOperation operation, const Region& region1, const Region& region2)
+{
+	//Regions held by the cache outlive any arena the caller is using, so they (and the results, which share with them) use the heap
+	RegionArenaScope heapScope(NULL);
+	uint64_t key = EntryKey(operation, region1.GetHash(), region2.GetHash());
+	std::pair<EntryIndex::iterator, EntryIndex::iterator> range = entryIndex.equal_range(key);
+	for (EntryIndex::iterator it = range.first; it != range.second; ++it)
+	{
+		Entry& entry = *it->second;
+		//Different operands can have the same hash, so they are compared too (which is quick when they share rectangles with the entry)
+		if (entry.operation == operation && entry.operand1 == region1 && entry.operand2 == region2)
+		{
+			hitCount++;
+			entries.splice(entries.begin(), entries, it->second);
+			return entry.result;
+		}
+	}
+	missCount++;
+
+	entries.emplace_front();
+	Entry& entry = entries.front();
+	entry.key = key;
+	entry.operation = operation;
+	entry.operand1 = region1;
+	entry.operand2 = region2;
+	switch (operation)
+	{
+	case REGION_OP_UNION:
+		entry.result = region1.Union(region2);
+		break;
+	case REGION_OP_INTERSECT:
+		entry.result = region1.Intersect(region2);
+		break;
+	case REGION_OP_SUBTRACT:
+		entry.result = region1.Subtract(region2);
+		break;
+	case REGION_OP_XOR:
+		entry.result = region1.Xor(region2);
+		break;
+	}
+	AddRegion(entry.operand1);
+	AddRegion(entry.operand2);
+	AddRegion(entry.result);
+	entry.rectCount = 1 + entry.operand1.GetRectCount() + entry.operand2.GetRectCount() + entry.result.GetRectCount();
+	rectCount += entry.rectCount;
+	entryIndex.insert(std::make_pair(key, entries.begin()));
+
+	//Copy the result before evicting, a result bigger than the whole cache is not kept
+	Region result(entry.result);
+	while (rectCount > maxRects && !entries.empty())
+	{
+		EvictOldest();
+	}
+	return result;
+}
+
+void RegionOpCache::AddRegion(Region& region)
+{
+	if (region.GetRegionType() != COMPLEXREGION)
+	{
+		return;
+	}
+	Intern(region);
+	regionIndex.insert(std::make_pair(region.GetHash(), &region));
+}
+
+void RegionOpCache::RemoveRegion(Region& region)
+{
+	if (region.GetRegionType() != COMPLEXREGION)
+	{
+		return;
+	}
+	std::pair<RegionIndex::iterator, RegionIndex::iterator> range = regionIndex.equal_range(region.GetHash());
+	for (RegionIndex::iterator it = range.first; it != range.second; ++it)
+	{
+		if (it->second == &region)
+		{
+			regionIndex.erase(it);
+			return;
+		}
+	}
+}
+
+void RegionOpCache::EvictOldest()
+{
+	EntryList::iterator oldest = --entries.end();
+	std::pair<EntryIndex::iterator, EntryIndex::iterator> range = entryIndex.equal_range(oldest->key);
+	for (EntryIndex::iterator it = range.first; it != range.second; ++it)
+	{
+		if (it->second == oldest)
+		{
+			entryIndex.erase(it);
+			break;
+		}
+	}
+	RemoveRegion(oldest->operand1);
+	RemoveRegion(oldest->operand2);
+	RemoveRegion(oldest->result);
+	rectCount -= oldest->rectCount;
+	entries.erase(oldest);
+}
+
+bool RegionOpCache::Intern(Region& region) const
+{
+	if (region.GetRegionType() != COMPLEXREGION)
+	{
+		return false;
+	}
+	std::pair<RegionIndex::const_iterator, RegionIndex::const_iterator> range = regionIndex.equal_range(region.GetHash());
+	for (RegionIndex::const_iterator it = range.first; it != range.second; ++it)
+	{
+		if (*it->second == region)
+		{
+			region = *it->second;
+			return true;
+		}
+	}
+	return false;
+}
+
+void RegionOpCache::Clear()
+{
+	entries.clear();
+	entryIndex.clear();
+	regionIndex.clear();
+	rectCount = 0;
+}
+
+size_t RegionOpCache::GetEntryCount() const
+{
+	return entries.size();
+}
+
+size_t RegionOpCache::GetRectCount() const
+{
+	return rectCount;
+}
+
+size_t RegionOpCache::GetHitCount() const
+{
+	return hitCount;
+}
+
+size_t RegionOpCache::GetMissCount() const
+{
+	return missCount;
+}
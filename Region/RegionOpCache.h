@@ -0,0 +1,81 @@
+#pragma once
+#include "Region.h"
+#include <list>
+#include <unordered_map>
+
+//Operations whose results a RegionOpCache remembers
+enum RegionOperation
+{
+	REGION_OP_UNION,
+	REGION_OP_INTERSECT,
+	REGION_OP_SUBTRACT,
+	REGION_OP_XOR,
+};
+
+//Remembers the results of recent region operations, found by the operation and the hashes of its operands (see Region::GetHash),
+//so repeating an operation on unchanged operands (such as working out each window's visible region every frame) is only a lookup.
+//Results share their rectangles with the cached copy instead of being copied.  Equal regions held by the cache also share their rectangles
+//with each other, and Intern lets other regions share them too.
+//The cache holds up to maxRects rectangles, and forgets the least recently used results to stay under that.  Not thread safe.
+class RegionOpCache
+{
+private:
+	struct Entry
+	{
+		uint64_t key;
+		RegionOperation operation;
+		Region operand1;
+		Region operand2;
+		Region result;
+		//Rectangles held by this entry (at least 1, so entries of Null regions count too)
+		size_t rectCount;
+	};
+	typedef std::list<Entry> EntryList;
+	typedef std::unordered_multimap<uint64_t, EntryList::iterator> EntryIndex;
+	typedef std::unordered_multimap<uint64_t, Region*> RegionIndex;
+	//Entries, most recently used first
+	EntryList entries;
+	//Entries by key (operation and operand hashes)
+	EntryIndex entryIndex;
+	//Complex regions held by the entries, by hash
+	RegionIndex regionIndex;
+	size_t maxRects;
+	//Rectangles held by all entries
+	size_t rectCount;
+	size_t hitCount;
+	size_t missCount;
+	//Returns the cached result of an operation, or works it out and remembers it
+	Region Combine(RegionOperation operation, const Region& region1, const Region& region2);
+	//Makes a region held by an entry share its rectangles with an equal region already in the cache, and adds it to regionIndex
+	void AddRegion(Region& region);
+	//Removes a region held by an entry from regionIndex
+	void RemoveRegion(Region& region);
+	//Forgets the least recently used entry
+	void EvictOldest();
+	//Not copyable (the indexes point into entries)
+	RegionOpCache(const RegionOpCache& other);
+	RegionOpCache& operator=(const RegionOpCache& other);
+public:
+	//Creates an empty cache which holds up to maxRects rectangles (results and operands added together)
+	explicit RegionOpCache(size_t maxRects);
+	//Returns the union of two regions
+	Region Union(const Region& region1, const Region& region2);
+	//Returns the intersection of two regions
+	Region Intersect(const Region& region1, const Region& region2);
+	//Returns region1 with region2 removed from it
+	Region Subtract(const Region& region1, const Region& region2);
+	//Returns the area inside of exactly one of the regions
+	Region Xor(const Region& region1, const Region& region2);
+	//If the cache holds a region equal to this one, makes this region share its rectangles, and returns true
+	bool Intern(Region& region) const;
+	//Forgets every result
+	void Clear();
+	//Returns the number of results the cache holds
+	size_t GetEntryCount() const;
+	//Returns the number of rectangles the cache holds
+	size_t GetRectCount() const;
+	//Returns the number of operations which were found in the cache
+	size_t GetHitCount() const;
+	//Returns the number of operations which had to be worked out
+	size_t GetMissCount() const;
+};
@@ -0,0 +1,44 @@
+//Replays a trace recorded with RegionTrace (see RegionTrace.h), and prints how long each kind of operation took.
+//Usage: RegionReplay <trace file> [repeat count]
+#include "RegionTrace.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: RegionReplay <trace file> [repeat count]\n");
+		return 2;
+	}
+	int repeatCount = 1;
+	if (argc > 2)
+	{
+		repeatCount = atoi(argv[2]);
+		if (repeatCount < 1)
+		{
+			repeatCount = 1;
+		}
+	}
+
+	RegionReplayResult result;
+	if (!RegionTrace::Replay(argv[1], repeatCount, result))
+	{
+		printf("Could not read trace file %s\n", argv[1]);
+		return 1;
+	}
+
+	printf("%-20s %12s %14s %12s\n", "operation", "count", "total ms", "ns/op");
+	for (int i = 0; i < REGION_TRACE_OPCODE_COUNT; i++)
+	{
+		if (result.opcodeCounts[i] != 0)
+		{
+			printf("%-20s %12llu %14.3f %12.1f\n", RegionTrace::GetOpcodeName((RegionTraceOpcode)i), (unsigned long long)result.opcodeCounts[i],
+				result.opcodeNanoseconds[i] / 1000000.0, result.opcodeNanoseconds[i] / result.opcodeCounts[i]);
+		}
+	}
+	printf("%-20s %12llu %14.3f\n", "total", (unsigned long long)result.operationCount, result.totalNanoseconds / 1000000.0);
+	printf("result type mismatches: %llu\n", (unsigned long long)result.mismatchCount);
+	printf("live regions: %llu, checksum: %016llx\n", (unsigned long long)result.liveRegionCount, (unsigned long long)result.checksum);
+	return result.mismatchCount != 0 ? 1 : 0;
+}
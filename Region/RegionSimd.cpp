@@ -0,0 +1,369 @@
+#include "RegionSimd.h"
+#include <atomic>
+#include <limits>
+
+#if REGION_USE_SIMD && (defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__))
+#define REGION_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define REGION_SIMD_X86 0
+#endif
+
+//GCC and Clang only allow intrinsics for instruction sets the function is compiled for, MSVC allows them anywhere
+#if defined(__GNUC__)
+#define REGION_SIMD_TARGET(instructions) __attribute__((target(instructions)))
+#else
+#define REGION_SIMD_TARGET(instructions)
+#endif
+
+#if REGION_SIMD_X86
+static_assert(sizeof(RECT) == 16, "the vector kernels load a RECT as four 32-bit numbers");
+#endif
+
+static const LONG CoordinateMin = std::numeric_limits<LONG>::min();
+static const LONG CoordinateMax = std::numeric_limits<LONG>::max();
+
+//Below this many rectangles, the plain version is used, because switching to the vector registers (especially the
+//256-bit AVX2 registers) costs more than it saves
+static const size_t VectorMinimumCount = 32;
+
+typedef size_t(*ClipRectsFunction)(const RECT* pSource, size_t count, const RECT& clip, RECT* pDest, RECT& bounds);
+typedef void(*ThresholdBytesFunction)(const byte* pSource, size_t count, byte threshold, uint64_t* pBits);
+
+//Plain version, also handles the rectangles left over at the end of the vector versions
+static size_t ClipRectsScalar(const RECT* pSource, size_t count, const RECT& clip, RECT* pDest, RECT& bounds)
+{
+	RECT* pOut = pDest;
+	for (size_t i = 0; i < count; i++)
+	{
+		RECT rect = pSource[i];
+		if (rect.left < clip.left) rect.left = clip.left;
+		if (rect.top < clip.top) rect.top = clip.top;
+		if (rect.right > clip.right) rect.right = clip.right;
+		if (rect.bottom > clip.bottom) rect.bottom = clip.bottom;
+		if (rect.left < rect.right && rect.top < rect.bottom)
+		{
+			if (rect.left < bounds.left) bounds.left = rect.left;
+			if (rect.top < bounds.top) bounds.top = rect.top;
+			if (rect.right > bounds.right) bounds.right = rect.right;
+			if (rect.bottom > bounds.bottom) bounds.bottom = rect.bottom;
+			*pOut++ = rect;
+		}
+	}
+	return pOut - pDest;
+}
+
+//Plain version, also handles the bytes left over at the end of the vector versions
+static void ThresholdBytesScalar(const byte* pSource, size_t count, byte threshold, uint64_t* pBits)
+{
+	for (size_t i = 0; i < count; i += 64)
+	{
+		size_t wordCount = count - i < 64 ? count - i : 64;
+		uint64_t word = 0;
+		for (size_t j = 0; j < wordCount; j++)
+		{
+			word |= (uint64_t)(pSource[i + j] >= threshold) << j;
+		}
+		pBits[i / 64] = word;
+	}
+}
+
+#if REGION_SIMD_X86
+//The vector versions hold one rectangle per 128 bits (left, top, right, bottom), so a rectangle is clipped by raising the
+//first two numbers to at least (clip.left, clip.top), and lowering the last two to at most (clip.right, clip.bottom).
+//A rectangle is not empty when its last two numbers are greater than its first two.  Every rectangle is stored, but the
+//output pointer only moves past the rectangles which are not empty, which packs them together without branches.
+
+//Clips one rectangle, adds it to the bounds if it's not empty, and returns 1 if it's not empty.
+//(SSE4.1 is the first version with 32-bit min, max and blend.  SSE2 needs several instructions for each, and is no faster than the plain version.)
+REGION_SIMD_TARGET("sse4.1") static inline size_t ClipRectSse41(__m128i& rect, __m128i clipLow, __m128i clipHigh, __m128i empty, __m128i& boundsLow, __m128i& boundsHigh)
+{
+	rect = _mm_min_epi32(_mm_max_epi32(rect, clipLow), clipHigh);
+	//Compares (left, top, right, bottom) with (right, bottom, left, top), the last two results say whether it's not empty
+	__m128i greater = _mm_cmpgt_epi32(rect, _mm_shuffle_epi32(rect, _MM_SHUFFLE(1, 0, 3, 2)));
+	__m128i keep = _mm_and_si128(_mm_shuffle_epi32(greater, _MM_SHUFFLE(2, 2, 2, 2)), _mm_shuffle_epi32(greater, _MM_SHUFFLE(3, 3, 3, 3)));
+	__m128i kept = _mm_blendv_epi8(empty, rect, keep);
+	boundsLow = _mm_min_epi32(boundsLow, kept);
+	boundsHigh = _mm_max_epi32(boundsHigh, kept);
+	return _mm_cvtsi128_si32(keep) & 1;
+}
+REGION_SIMD_TARGET("sse4.1") static size_t ClipRectsSse41(const RECT* pSource, size_t count, const RECT& clip, RECT* pDest, RECT& bounds)
+{
+	const __m128i clipLow = _mm_setr_epi32(clip.left, clip.top, CoordinateMin, CoordinateMin);
+	const __m128i clipHigh = _mm_setr_epi32(CoordinateMax, CoordinateMax, clip.right, clip.bottom);
+	//What an empty rectangle counts as for the bounds (does not change them)
+	const __m128i empty = _mm_setr_epi32(CoordinateMax, CoordinateMax, CoordinateMin, CoordinateMin);
+	__m128i boundsLow = _mm_setr_epi32(bounds.left, bounds.top, bounds.right, bounds.bottom);
+	__m128i boundsHigh = boundsLow;
+	RECT* pOut = pDest;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i rect0 = _mm_loadu_si128((const __m128i*)(pSource + i));
+		__m128i rect1 = _mm_loadu_si128((const __m128i*)(pSource + i + 1));
+		__m128i rect2 = _mm_loadu_si128((const __m128i*)(pSource + i + 2));
+		__m128i rect3 = _mm_loadu_si128((const __m128i*)(pSource + i + 3));
+		size_t keep0 = ClipRectSse41(rect0, clipLow, clipHigh, empty, boundsLow, boundsHigh);
+		size_t keep1 = ClipRectSse41(rect1, clipLow, clipHigh, empty, boundsLow, boundsHigh);
+		size_t keep2 = ClipRectSse41(rect2, clipLow, clipHigh, empty, boundsLow, boundsHigh);
+		size_t keep3 = ClipRectSse41(rect3, clipLow, clipHigh, empty, boundsLow, boundsHigh);
+		_mm_storeu_si128((__m128i*)pOut, rect0);
+		pOut += keep0;
+		_mm_storeu_si128((__m128i*)pOut, rect1);
+		pOut += keep1;
+		_mm_storeu_si128((__m128i*)pOut, rect2);
+		pOut += keep2;
+		_mm_storeu_si128((__m128i*)pOut, rect3);
+		pOut += keep3;
+	}
+	//boundsLow has the lowest left and top, boundsHigh has the highest right and bottom
+	RECT low, high;
+	_mm_storeu_si128((__m128i*)&low, boundsLow);
+	_mm_storeu_si128((__m128i*)&high, boundsHigh);
+	bounds.left = low.left;
+	bounds.top = low.top;
+	bounds.right = high.right;
+	bounds.bottom = high.bottom;
+	return (pOut - pDest) + ClipRectsScalar(pSource + i, count - i, clip, pOut, bounds);
+}
+
+//Same as the SSE4.1 version, with two rectangles per register and eight rectangles per loop.
+//Clips two rectangles, adds the ones which are not empty to the bounds, and returns which ones are not empty.
+REGION_SIMD_TARGET("avx2") static inline __m256i ClipRectPairAvx2(__m256i& rects, __m256i clipLow, __m256i clipHigh, __m256i empty, __m256i& boundsLow, __m256i& boundsHigh)
+{
+	rects = _mm256_min_epi32(_mm256_max_epi32(rects, clipLow), clipHigh);
+	__m256i greater = _mm256_cmpgt_epi32(rects, _mm256_shuffle_epi32(rects, _MM_SHUFFLE(1, 0, 3, 2)));
+	__m256i keep = _mm256_and_si256(_mm256_shuffle_epi32(greater, _MM_SHUFFLE(2, 2, 2, 2)), _mm256_shuffle_epi32(greater, _MM_SHUFFLE(3, 3, 3, 3)));
+	__m256i kept = _mm256_blendv_epi8(empty, rects, keep);
+	boundsLow = _mm256_min_epi32(boundsLow, kept);
+	boundsHigh = _mm256_max_epi32(boundsHigh, kept);
+	return keep;
+}
+//Stores the two rectangles of a register, moving past the ones which are not empty
+REGION_SIMD_TARGET("avx2") static inline RECT* StoreRectsAvx2(RECT* pOut, __m256i rects, __m256i keep)
+{
+	int mask = _mm256_movemask_ps(_mm256_castsi256_ps(keep));
+	_mm_storeu_si128((__m128i*)pOut, _mm256_castsi256_si128(rects));
+	pOut += mask & 1;
+	_mm_storeu_si128((__m128i*)pOut, _mm256_extracti128_si256(rects, 1));
+	pOut += (mask >> 4) & 1;
+	return pOut;
+}
+REGION_SIMD_TARGET("avx2") static size_t ClipRectsAvx2(const RECT* pSource, size_t count, const RECT& clip, RECT* pDest, RECT& bounds)
+{
+	const __m256i clipLow = _mm256_setr_epi32(clip.left, clip.top, CoordinateMin, CoordinateMin, clip.left, clip.top, CoordinateMin, CoordinateMin);
+	const __m256i clipHigh = _mm256_setr_epi32(CoordinateMax, CoordinateMax, clip.right, clip.bottom, CoordinateMax, CoordinateMax, clip.right, clip.bottom);
+	const __m256i empty = _mm256_setr_epi32(CoordinateMax, CoordinateMax, CoordinateMin, CoordinateMin, CoordinateMax, CoordinateMax, CoordinateMin, CoordinateMin);
+	__m256i boundsLow = _mm256_setr_epi32(bounds.left, bounds.top, bounds.right, bounds.bottom, bounds.left, bounds.top, bounds.right, bounds.bottom);
+	__m256i boundsHigh = boundsLow;
+	RECT* pOut = pDest;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i rects0 = _mm256_loadu_si256((const __m256i*)(pSource + i));
+		__m256i rects1 = _mm256_loadu_si256((const __m256i*)(pSource + i + 2));
+		__m256i rects2 = _mm256_loadu_si256((const __m256i*)(pSource + i + 4));
+		__m256i rects3 = _mm256_loadu_si256((const __m256i*)(pSource + i + 6));
+		__m256i keep0 = ClipRectPairAvx2(rects0, clipLow, clipHigh, empty, boundsLow, boundsHigh);
+		__m256i keep1 = ClipRectPairAvx2(rects1, clipLow, clipHigh, empty, boundsLow, boundsHigh);
+		__m256i keep2 = ClipRectPairAvx2(rects2, clipLow, clipHigh, empty, boundsLow, boundsHigh);
+		__m256i keep3 = ClipRectPairAvx2(rects3, clipLow, clipHigh, empty, boundsLow, boundsHigh);
+		pOut = StoreRectsAvx2(pOut, rects0, keep0);
+		pOut = StoreRectsAvx2(pOut, rects1, keep1);
+		pOut = StoreRectsAvx2(pOut, rects2, keep2);
+		pOut = StoreRectsAvx2(pOut, rects3, keep3);
+	}
+	//Combine the bounds of the two halves
+	__m128i low = _mm_min_epi32(_mm256_castsi256_si128(boundsLow), _mm256_extracti128_si256(boundsLow, 1));
+	__m128i high = _mm_max_epi32(_mm256_castsi256_si128(boundsHigh), _mm256_extracti128_si256(boundsHigh, 1));
+	RECT lowRect, highRect;
+	_mm_storeu_si128((__m128i*)&lowRect, low);
+	_mm_storeu_si128((__m128i*)&highRect, high);
+	bounds.left = lowRect.left;
+	bounds.top = lowRect.top;
+	bounds.right = highRect.right;
+	bounds.bottom = highRect.bottom;
+	return (pOut - pDest) + ClipRectsScalar(pSource + i, count - i, clip, pOut, bounds);
+}
+
+//The vector versions compare 16 or 32 bytes at once, and gather the sign bits of the results with movemask.
+//There is no unsigned compare, but a byte is at least threshold when max(byte, threshold) is the byte.
+
+//Returns 16 bits, one for each of the 16 bytes at pSource
+REGION_SIMD_TARGET("sse4.1") static inline uint64_t ThresholdSse41(const byte* pSource, __m128i threshold)
+{
+	__m128i bytes = _mm_loadu_si128((const __m128i*)pSource);
+	return (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(bytes, threshold), bytes));
+}
+REGION_SIMD_TARGET("sse4.1") static void ThresholdBytesSse41(const byte* pSource, size_t count, byte threshold, uint64_t* pBits)
+{
+	const __m128i thresholds = _mm_set1_epi8((char)threshold);
+	size_t i = 0;
+	for (; i + 64 <= count; i += 64)
+	{
+		pBits[i / 64] = ThresholdSse41(pSource + i, thresholds) | ThresholdSse41(pSource + i + 16, thresholds) << 16 |
+			ThresholdSse41(pSource + i + 32, thresholds) << 32 | ThresholdSse41(pSource + i + 48, thresholds) << 48;
+	}
+	ThresholdBytesScalar(pSource + i, count - i, threshold, pBits + i / 64);
+}
+
+//Returns 32 bits, one for each of the 32 bytes at pSource
+REGION_SIMD_TARGET("avx2") static inline uint64_t ThresholdAvx2(const byte* pSource, __m256i threshold)
+{
+	__m256i bytes = _mm256_loadu_si256((const __m256i*)pSource);
+	return (uint64_t)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(bytes, threshold), bytes));
+}
+REGION_SIMD_TARGET("avx2") static void ThresholdBytesAvx2(const byte* pSource, size_t count, byte threshold, uint64_t* pBits)
+{
+	const __m256i thresholds = _mm256_set1_epi8((char)threshold);
+	size_t i = 0;
+	for (; i + 64 <= count; i += 64)
+	{
+		pBits[i / 64] = ThresholdAvx2(pSource + i, thresholds) | ThresholdAvx2(pSource + i + 32, thresholds) << 32;
+	}
+	ThresholdBytesScalar(pSource + i, count - i, threshold, pBits + i / 64);
+}
+
+//Asks the CPU which instruction sets it supports
+static bool CpuSupports(RegionSimdLevel level)
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	if (level == REGION_SIMD_SSE41)
+	{
+		return (info[2] & (1 << 19)) != 0;
+	}
+	//AVX2 also needs the OS to save the upper halves of the registers (OSXSAVE, AVX, and XCR0 bits 1 and 2)
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6 || maxLeaf < 7)
+	{
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	if (level == REGION_SIMD_SSE41)
+	{
+		return __builtin_cpu_supports("sse4.1") != 0;
+	}
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+//Kernels for each instruction set
+static const ClipRectsFunction ClipRectsFunctions[REGION_SIMD_LEVEL_COUNT] =
+{
+	ClipRectsScalar,
+#if REGION_SIMD_X86
+	ClipRectsSse41,
+	ClipRectsAvx2,
+#else
+	NULL,
+	NULL,
+#endif
+};
+
+static const ThresholdBytesFunction ThresholdBytesFunctions[REGION_SIMD_LEVEL_COUNT] =
+{
+	ThresholdBytesScalar,
+#if REGION_SIMD_X86
+	ThresholdBytesSse41,
+	ThresholdBytesAvx2,
+#else
+	NULL,
+	NULL,
+#endif
+};
+
+static RegionSimdLevel DetectLevel()
+{
+	RegionSimdLevel level = REGION_SIMD_NONE;
+	for (int i = REGION_SIMD_NONE + 1; i < REGION_SIMD_LEVEL_COUNT; i++)
+	{
+		if (RegionSimd::IsSupported((RegionSimdLevel)i))
+		{
+			level = (RegionSimdLevel)i;
+		}
+	}
+	return level;
+}
+
+//Level the kernels use, detected the first time it's needed
+static std::atomic<RegionSimdLevel>& CurrentLevel()
+{
+	static std::atomic<RegionSimdLevel> level(DetectLevel());
+	return level;
+}
+
+/*static*/ bool RegionSimd::IsSupported(RegionSimdLevel level)
+{
+	if (level == REGION_SIMD_NONE)
+	{
+		return true;
+	}
+#if REGION_SIMD_X86
+	if (level > REGION_SIMD_NONE && level < REGION_SIMD_LEVEL_COUNT)
+	{
+		//Asked once for each level
+		static const bool supported[REGION_SIMD_LEVEL_COUNT] = { true, CpuSupports(REGION_SIMD_SSE41), CpuSupports(REGION_SIMD_AVX2) };
+		return supported[level];
+	}
+#endif
+	return false;
+}
+
+/*static*/ RegionSimdLevel RegionSimd::GetLevel()
+{
+	return CurrentLevel().load(std::memory_order_relaxed);
+}
+
+/*static*/ bool RegionSimd::SetLevel(RegionSimdLevel level)
+{
+	if (!IsSupported(level))
+	{
+		return false;
+	}
+	CurrentLevel().store(level, std::memory_order_relaxed);
+	return true;
+}
+
+/*static*/ const char* RegionSimd::GetLevelName(RegionSimdLevel level)
+{
+	static const char* const names[REGION_SIMD_LEVEL_COUNT] =
+	{
+		"scalar",
+		"sse4.1",
+		"avx2",
+	};
+	return level >= REGION_SIMD_NONE && level < REGION_SIMD_LEVEL_COUNT ? names[level] : "unknown";
+}
+
+/*static*/ size_t RegionSimd::ClipRects(const RECT* pSource, size_t count, const RECT& clip, RECT* pDest, RECT& bounds)
+{
+	bounds.left = CoordinateMax;
+	bounds.top = CoordinateMax;
+	bounds.right = CoordinateMin;
+	bounds.bottom = CoordinateMin;
+	if (count < VectorMinimumCount)
+	{
+		return ClipRectsScalar(pSource, count, clip, pDest, bounds);
+	}
+	return ClipRectsFunctions[GetLevel()](pSource, count, clip, pDest, bounds);
+}
+
+/*static*/ void RegionSimd::ThresholdBytes(const byte* pSource, size_t count, byte threshold, uint64_t* pBits)
+{
+	if (count < VectorMinimumCount)
+	{
+		ThresholdBytesScalar(pSource, count, threshold, pBits);
+		return;
+	}
+	ThresholdBytesFunctions[GetLevel()](pSource, count, threshold, pBits);
+}
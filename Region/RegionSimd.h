@@ -0,0 +1,36 @@
+#pragma once
+#include "Region.h"
+
+//Vectorized kernels for operations which work on every rectangle of a region (or every pixel of a mask) independently.
+//The kernel is picked at runtime from what the CPU supports (AVX2, then SSE4.1), with a plain C++ version for other CPUs,
+//or when REGION_USE_SIMD is 0.
+
+//Instruction sets the kernels can use
+enum RegionSimdLevel
+{
+	REGION_SIMD_NONE,
+	REGION_SIMD_SSE41,
+	REGION_SIMD_AVX2,
+	REGION_SIMD_LEVEL_COUNT
+};
+
+class RegionSimd
+{
+public:
+	//Returns the instruction set used by the kernels (the best one the CPU supports, unless SetLevel changed it)
+	static RegionSimdLevel GetLevel();
+	//Returns true if the CPU (and this build) supports an instruction set
+	static bool IsSupported(RegionSimdLevel level);
+	//Makes the kernels use an instruction set, for testing and benchmarks.  Returns false (and changes nothing) if it's not supported.
+	static bool SetLevel(RegionSimdLevel level);
+	//Returns a name for an instruction set
+	static const char* GetLevelName(RegionSimdLevel level);
+
+	//Clips each rectangle against clip, and writes the rectangles which are not empty afterwards to pDest, keeping their order.
+	//Returns the number of rectangles written, and sets bounds to their bounding box (left undefined if none were written).
+	//pDest must have room for count rectangles, and may be the same as pSource.
+	static size_t ClipRects(const RECT* pSource, size_t count, const RECT& clip, RECT* pDest, RECT& bounds);
+	//Sets bit i of the bit array (bit i % 64 of pBits[i / 64]) when pSource[i] is at least threshold, and clears it otherwise.
+	//Writes (count + 63) / 64 words, bits past count in the last word are cleared.
+	static void ThresholdBytes(const byte* pSource, size_t count, byte threshold, uint64_t* pBits);
+};
@@ -0,0 +1,308 @@
+#include "RegionStats.h"
+
+#if REGION_USE_STATS
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+
+//Counters for one thread.  Only the owning thread adds to them, other threads read them for snapshots, or zero them for Reset.
+struct ThreadStats
+{
+	std::atomic<uint64_t> counters[REGION_STAT_COUNTER_COUNT];
+	std::atomic<uint64_t> latency[REGION_STAT_OPERATION_COUNT][REGION_STAT_LATENCY_BUCKETS];
+	//Number of RegionStatsTimer objects running on this thread
+	int timerDepth;
+	ThreadStats();
+	~ThreadStats();
+	//Adds the counts to a snapshot
+	void AddTo(RegionStatsSnapshot& snapshot) const;
+	//Sets every count to zero
+	void Reset();
+};
+
+//Every live ThreadStats, plus the totals of threads which have exited
+struct StatsRegistry
+{
+	std::mutex mutex;
+	vector<ThreadStats*> threads;
+	RegionStatsSnapshot exitedThreads;
+};
+
+static StatsRegistry& GetRegistry()
+{
+	//Created on first use, so it's constructed before (and destroyed after) any thread's ThreadStats
+	static StatsRegistry registry;
+	return registry;
+}
+
+static thread_local ThreadStats threadStats;
+
+//Adds to a counter which only this thread writes to, without a locked instruction
+static inline void AddRelaxed(std::atomic<uint64_t>& counter, uint64_t amount)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+ThreadStats::ThreadStats()
+{
+	Reset();
+	timerDepth = 0;
+	StatsRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	registry.threads.push_back(this);
+}
+
+ThreadStats::~ThreadStats()
+{
+	StatsRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	AddTo(registry.exitedThreads);
+	for (size_t i = 0; i < registry.threads.size(); i++)
+	{
+		if (registry.threads[i] == this)
+		{
+			registry.threads.erase(registry.threads.begin() + i);
+			break;
+		}
+	}
+}
+
+void ThreadStats::AddTo(RegionStatsSnapshot& snapshot) const
+{
+	for (int i = 0; i < REGION_STAT_COUNTER_COUNT; i++)
+	{
+		snapshot.counters[i] += counters[i].load(std::memory_order_relaxed);
+	}
+	for (int op = 0; op < REGION_STAT_OPERATION_COUNT; op++)
+	{
+		for (int bucket = 0; bucket < REGION_STAT_LATENCY_BUCKETS; bucket++)
+		{
+			snapshot.latency[op][bucket] += latency[op][bucket].load(std::memory_order_relaxed);
+		}
+	}
+}
+
+void ThreadStats::Reset()
+{
+	for (int i = 0; i < REGION_STAT_COUNTER_COUNT; i++)
+	{
+		counters[i].store(0, std::memory_order_relaxed);
+	}
+	for (int op = 0; op < REGION_STAT_OPERATION_COUNT; op++)
+	{
+		for (int bucket = 0; bucket < REGION_STAT_LATENCY_BUCKETS; bucket++)
+		{
+			latency[op][bucket].store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+RegionStatsSnapshot::RegionStatsSnapshot()
+{
+	for (int i = 0; i < REGION_STAT_COUNTER_COUNT; i++)
+	{
+		counters[i] = 0;
+	}
+	for (int op = 0; op < REGION_STAT_OPERATION_COUNT; op++)
+	{
+		for (int bucket = 0; bucket < REGION_STAT_LATENCY_BUCKETS; bucket++)
+		{
+			latency[op][bucket] = 0;
+		}
+	}
+}
+
+void RegionStatsSnapshot::Add(const RegionStatsSnapshot& other)
+{
+	for (int i = 0; i < REGION_STAT_COUNTER_COUNT; i++)
+	{
+		counters[i] += other.counters[i];
+	}
+	for (int op = 0; op < REGION_STAT_OPERATION_COUNT; op++)
+	{
+		for (int bucket = 0; bucket < REGION_STAT_LATENCY_BUCKETS; bucket++)
+		{
+			latency[op][bucket] += other.latency[op][bucket];
+		}
+	}
+}
+
+uint64_t RegionStatsSnapshot::GetOperationCount(RegionStatOperation operation) const
+{
+	uint64_t total = 0;
+	for (int bucket = 0; bucket < REGION_STAT_LATENCY_BUCKETS; bucket++)
+	{
+		total += latency[operation][bucket];
+	}
+	return total;
+}
+
+std::string RegionStatsSnapshot::ToText() const
+{
+	std::string text;
+	char buffer[64];
+	for (int i = 0; i < REGION_STAT_COUNTER_COUNT; i++)
+	{
+		snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)counters[i]);
+		text += RegionStats::GetCounterName((RegionStatCounter)i);
+		text += ": ";
+		text += buffer;
+		text += "\n";
+	}
+	//Each histogram line lists the non-empty buckets as "<upper limit in ns>:count"
+	for (int op = 0; op < REGION_STAT_OPERATION_COUNT; op++)
+	{
+		snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)GetOperationCount((RegionStatOperation)op));
+		text += RegionStats::GetOperationName((RegionStatOperation)op);
+		text += " latency: count ";
+		text += buffer;
+		for (int bucket = 0; bucket < REGION_STAT_LATENCY_BUCKETS; bucket++)
+		{
+			if (latency[op][bucket] != 0)
+			{
+				if (bucket == REGION_STAT_LATENCY_BUCKETS - 1)
+				{
+					snprintf(buffer, sizeof(buffer), " >=%llu:%llu", 1ULL << bucket, (unsigned long long)latency[op][bucket]);
+				}
+				else
+				{
+					snprintf(buffer, sizeof(buffer), " <%llu:%llu", 1ULL << (bucket + 1), (unsigned long long)latency[op][bucket]);
+				}
+				text += buffer;
+			}
+		}
+		text += "\n";
+	}
+	return text;
+}
+
+std::string RegionStatsSnapshot::ToJson() const
+{
+	std::string json = "{\"counters\":{";
+	char buffer[64];
+	for (int i = 0; i < REGION_STAT_COUNTER_COUNT; i++)
+	{
+		snprintf(buffer, sizeof(buffer), "%s\"%s\":%llu", i != 0 ? "," : "", RegionStats::GetCounterName((RegionStatCounter)i), (unsigned long long)counters[i]);
+		json += buffer;
+	}
+	//Histograms are arrays of all the bucket counts, bucket i is from 2^i to 2^(i+1) - 1 nanoseconds
+	json += "},\"latency_ns_log2\":{";
+	for (int op = 0; op < REGION_STAT_OPERATION_COUNT; op++)
+	{
+		snprintf(buffer, sizeof(buffer), "%s\"%s\":[", op != 0 ? "," : "", RegionStats::GetOperationName((RegionStatOperation)op));
+		json += buffer;
+		for (int bucket = 0; bucket < REGION_STAT_LATENCY_BUCKETS; bucket++)
+		{
+			snprintf(buffer, sizeof(buffer), "%s%llu", bucket != 0 ? "," : "", (unsigned long long)latency[op][bucket]);
+			json += buffer;
+		}
+		json += "]";
+	}
+	json += "}}";
+	return json;
+}
+
+/*static*/ RegionStatsSnapshot RegionStats::GetSnapshot()
+{
+	StatsRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	RegionStatsSnapshot snapshot = registry.exitedThreads;
+	for (size_t i = 0; i < registry.threads.size(); i++)
+	{
+		registry.threads[i]->AddTo(snapshot);
+	}
+	return snapshot;
+}
+
+/*static*/ RegionStatsSnapshot RegionStats::GetThreadSnapshot()
+{
+	RegionStatsSnapshot snapshot;
+	threadStats.AddTo(snapshot);
+	return snapshot;
+}
+
+/*static*/ void RegionStats::Reset()
+{
+	StatsRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	registry.exitedThreads = RegionStatsSnapshot();
+	for (size_t i = 0; i < registry.threads.size(); i++)
+	{
+		registry.threads[i]->Reset();
+	}
+}
+
+/*static*/ void RegionStats::Count(RegionStatCounter counter, uint64_t amount)
+{
+	AddRelaxed(threadStats.counters[counter], amount);
+}
+
+/*static*/ void RegionStats::RecordLatency(RegionStatOperation operation, uint64_t nanoseconds)
+{
+	int bucket = 0;
+	while (nanoseconds > 1 && bucket < REGION_STAT_LATENCY_BUCKETS - 1)
+	{
+		nanoseconds >>= 1;
+		bucket++;
+	}
+	AddRelaxed(threadStats.latency[operation][bucket], 1);
+}
+
+/*static*/ const char* RegionStats::GetCounterName(RegionStatCounter counter)
+{
+	static const char* const names[REGION_STAT_COUNTER_COUNT] =
+	{
+		"null_shortcut",
+		"covers_up",
+		"aligned_merge",
+		"aligned_cut",
+		"rect_intersect",
+		"clip",
+		"clip_input_rects",
+		"became_complex",
+		"complex_op",
+		"complex_op_input_rects",
+		"complex_op_output_rects",
+		"hrgn_conversion",
+	};
+	return names[counter];
+}
+
+/*static*/ const char* RegionStats::GetOperationName(RegionStatOperation operation)
+{
+	static const char* const names[REGION_STAT_OPERATION_COUNT] =
+	{
+		"union_rect",
+		"union_rects",
+		"union_region",
+		"intersect_rect",
+		"intersect_region",
+		"subtract_rect",
+		"subtract_region",
+		"xor_rect",
+		"xor_region",
+	};
+	return names[operation];
+}
+
+RegionStatsTimer::RegionStatsTimer(RegionStatOperation operation)
+{
+	this->operation = operation;
+	this->outermost = threadStats.timerDepth == 0;
+	threadStats.timerDepth++;
+	if (this->outermost)
+	{
+		this->start = std::chrono::steady_clock::now();
+	}
+}
+
+RegionStatsTimer::~RegionStatsTimer()
+{
+	threadStats.timerDepth--;
+	if (this->outermost)
+	{
+		std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - this->start;
+		RegionStats::RecordLatency(this->operation, (uint64_t)elapsed.count());
+	}
+}
+#endif
@@ -0,0 +1,123 @@
+#pragma once
+#include "Region.h"
+
+//Instrumentation for Region operations, enabled by defining REGION_USE_STATS to 1.
+//Each thread counts into its own counters, and a snapshot adds up the counters of every thread.
+//Region.cpp uses the REGION_STATS_* macros, which compile to nothing when REGION_USE_STATS is 0.
+
+#if REGION_USE_STATS
+#include <stdint.h>
+#include <chrono>
+#include <string>
+
+//Things that are counted
+enum RegionStatCounter
+{
+	//Result was known right away because one of the operands was empty or they didn't overlap
+	REGION_STAT_NULL_SHORTCUT,
+	//Result was known right away because one operand covers up the other
+	REGION_STAT_COVERS_UP,
+	//Union of two rectangles which line up and touch or overlap, result is one rectangle
+	REGION_STAT_ALIGNED_MERGE,
+	//Subtraction of a rectangle which cuts across a whole side of a rectangle, result is one rectangle
+	REGION_STAT_ALIGNED_CUT,
+	//Intersection of a rectangle with a rectangle
+	REGION_STAT_RECT_INTERSECT,
+	//Intersection of a complex region with a rectangle, done by clipping each rectangle instead of a band sweep
+	REGION_STAT_CLIP,
+	//Number of rectangles in the complex regions that were clipped
+	REGION_STAT_CLIP_INPUT_RECTS,
+	//Null or Simple region became a Complex region
+	REGION_STAT_BECAME_COMPLEX,
+	//Band sweeps over complex regions (the slow path)
+	REGION_STAT_COMPLEX_OP,
+	//Number of rectangles going into band sweeps
+	REGION_STAT_COMPLEX_OP_INPUT_RECTS,
+	//Number of rectangles coming out of band sweeps
+	REGION_STAT_COMPLEX_OP_OUTPUT_RECTS,
+	//Conversions from or to an HRGN (calls to the Win32 region API)
+	REGION_STAT_HRGN_CONVERSION,
+	REGION_STAT_COUNTER_COUNT
+};
+
+//Operations that are timed
+enum RegionStatOperation
+{
+	REGION_STAT_UNION_RECT,
+	REGION_STAT_UNION_RECTS,
+	REGION_STAT_UNION_REGION,
+	REGION_STAT_INTERSECT_RECT,
+	REGION_STAT_INTERSECT_REGION,
+	REGION_STAT_SUBTRACT_RECT,
+	REGION_STAT_SUBTRACT_REGION,
+	REGION_STAT_XOR_RECT,
+	REGION_STAT_XOR_REGION,
+	REGION_STAT_OPERATION_COUNT
+};
+
+//Number of buckets in a latency histogram.  Bucket i counts operations which took from 2^i to 2^(i+1) - 1 nanoseconds
+//(bucket 0 also counts 0 ns), and the last bucket counts everything slower.
+#define REGION_STAT_LATENCY_BUCKETS 32
+
+//A copy of the counters at one point in time
+struct RegionStatsSnapshot
+{
+	uint64_t counters[REGION_STAT_COUNTER_COUNT];
+	uint64_t latency[REGION_STAT_OPERATION_COUNT][REGION_STAT_LATENCY_BUCKETS];
+	//Creates a snapshot with every count at zero
+	RegionStatsSnapshot();
+	//Adds the counts of another snapshot to this one
+	void Add(const RegionStatsSnapshot& other);
+	//Returns the number of times an operation was timed (the sum of its histogram)
+	uint64_t GetOperationCount(RegionStatOperation operation) const;
+	//Returns the counters and histograms as readable text, one line per counter or operation
+	std::string ToText() const;
+	//Returns the counters and histograms as a JSON object
+	std::string ToJson() const;
+};
+
+//Reads and resets the counters
+class RegionStats
+{
+public:
+	//Returns the totals of every thread, including threads which have exited
+	static RegionStatsSnapshot GetSnapshot();
+	//Returns the counts of the calling thread
+	static RegionStatsSnapshot GetThreadSnapshot();
+	//Sets the counts of every thread back to zero.  Counts made by other threads while this runs may be lost.
+	static void Reset();
+	//Adds to a counter for the calling thread
+	static void Count(RegionStatCounter counter, uint64_t amount);
+	//Adds an operation which took this long to the calling thread's histogram
+	static void RecordLatency(RegionStatOperation operation, uint64_t nanoseconds);
+	//Returns the name used for a counter in the text and JSON output
+	static const char* GetCounterName(RegionStatCounter counter);
+	//Returns the name used for an operation in the text and JSON output
+	static const char* GetOperationName(RegionStatOperation operation);
+};
+
+//Times an operation from construction to destruction.
+//Operations called from inside of a timed operation (such as UnionWith(Region) calling UnionWith(RECT)) are not timed separately.
+class RegionStatsTimer
+{
+private:
+	RegionStatOperation operation;
+	std::chrono::steady_clock::time_point start;
+	//False if another timer on this thread was already running
+	bool outermost;
+	//Not copyable
+	RegionStatsTimer(const RegionStatsTimer& other);
+	RegionStatsTimer& operator=(const RegionStatsTimer& other);
+public:
+	RegionStatsTimer(RegionStatOperation operation);
+	~RegionStatsTimer();
+};
+
+#define REGION_STATS_COUNT(counter) RegionStats::Count(counter, 1)
+#define REGION_STATS_ADD(counter, amount) RegionStats::Count(counter, amount)
+#define REGION_STATS_TIME(operation) RegionStatsTimer regionStatsTimer(operation)
+#else
+#define REGION_STATS_COUNT(counter) ((void)0)
+#define REGION_STATS_ADD(counter, amount) ((void)0)
+#define REGION_STATS_TIME(operation) ((void)0)
+#endif
@@ -0,0 +1,150 @@
+#include "RegionThreadPool.h"
+
+RegionThreadPool::RegionThreadPool(int workerCount)
+{
+	stopping = false;
+	jobActive = false;
+	generation = 0;
+	participants = 0;
+	function = NULL;
+	context = NULL;
+	taskCount = 0;
+	nextTask = 0;
+	StartThreads(workerCount);
+}
+
+RegionThreadPool::~RegionThreadPool()
+{
+	StopThreads();
+}
+
+/*static*/ RegionThreadPool& RegionThreadPool::GetShared()
+{
+	static RegionThreadPool pool(std::thread::hardware_concurrency() > 1 ? (int)std::thread::hardware_concurrency() - 1 : 0);
+	return pool;
+}
+
+int RegionThreadPool::GetThreadCount() const
+{
+	return (int)threads.size() + 1;
+}
+
+void RegionThreadPool::SetWorkerCount(int workerCount)
+{
+	std::lock_guard<std::mutex> runLock(runMutex);
+	StopThreads();
+	StartThreads(workerCount);
+}
+
+void RegionThreadPool::StartThreads(int workerCount)
+{
+	stopping = false;
+	for (int i = 0; i < workerCount; i++)
+	{
+		threads.push_back(std::thread(&RegionThreadPool::WorkerLoop, this));
+	}
+}
+
+void RegionThreadPool::StopThreads()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+	threads.clear();
+}
+
+void RegionThreadPool::WorkerLoop()
+{
+	size_t seenGeneration = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		while (!stopping && !(jobActive && generation != seenGeneration))
+		{
+			wake.wait(lock);
+		}
+		if (stopping)
+		{
+			return;
+		}
+		seenGeneration = generation;
+		participants++;
+		lock.unlock();
+		RunTasks();
+		lock.lock();
+		participants--;
+		if (participants == 0)
+		{
+			finished.notify_all();
+		}
+	}
+}
+
+void RegionThreadPool::RunTasks()
+{
+	while (true)
+	{
+		size_t index = nextTask.fetch_add(1, std::memory_order_relaxed);
+		if (index >= taskCount)
+		{
+			return;
+		}
+		try
+		{
+			function(context, index);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!exception)
+			{
+				exception = std::current_exception();
+			}
+			//The job has failed, don't start the tasks which are left
+			nextTask.store(taskCount, std::memory_order_relaxed);
+		}
+	}
+}
+
+void RegionThreadPool::Run(size_t count, TaskFunction function, void* context)
+{
+	std::unique_lock<std::mutex> runLock(runMutex, std::try_to_lock);
+	if (!runLock.owns_lock() || threads.empty() || count <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			function(context, i);
+		}
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->function = function;
+		this->context = context;
+		this->taskCount = count;
+		this->nextTask = 0;
+		this->jobActive = true;
+		this->generation++;
+	}
+	wake.notify_all();
+	RunTasks();
+	//Every task has been handed out, wait for the workers still running one
+	std::unique_lock<std::mutex> lock(mutex);
+	jobActive = false;
+	while (participants != 0)
+	{
+		finished.wait(lock);
+	}
+	if (exception)
+	{
+		std::exception_ptr failure = exception;
+		exception = std::exception_ptr();
+		std::rethrow_exception(failure);
+	}
+}
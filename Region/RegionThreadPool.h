@@ -0,0 +1,72 @@
+#pragma once
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//A set of worker threads which run the parts of a large operation (such as combining two regions in stripes) in parallel.
+//The calling thread works too, and each thread takes the next part as soon as it finishes one, so slow parts don't hold up the rest.
+class RegionThreadPool
+{
+private:
+	typedef void(*TaskFunction)(void* context, size_t index);
+	std::vector<std::thread> threads;
+	//Held for the whole of ParallelFor, only one ParallelFor runs on the pool at a time
+	std::mutex runMutex;
+	//Protects the fields below
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	bool stopping;
+	//True while the calling thread of ParallelFor is still handing out tasks
+	bool jobActive;
+	//Increases for every ParallelFor, so a worker runs each job once
+	size_t generation;
+	//Number of worker threads working on the current job
+	int participants;
+	TaskFunction function;
+	void* context;
+	size_t taskCount;
+	std::atomic<size_t> nextTask;
+	//First exception thrown by a task of the current job, rethrown on the calling thread once every task has finished
+	std::exception_ptr exception;
+	//Main function of the worker threads
+	void WorkerLoop();
+	//Runs tasks of the current job until there are none left
+	void RunTasks();
+	void StartThreads(int workerCount);
+	void StopThreads();
+	void Run(size_t count, TaskFunction function, void* context);
+	template <class Body>
+	static void Invoke(void* context, size_t index)
+	{
+		(*(const Body*)context)(index);
+	}
+	//Not copyable
+	RegionThreadPool(const RegionThreadPool& other);
+	RegionThreadPool& operator=(const RegionThreadPool& other);
+public:
+	//Creates a pool with this many worker threads (the calling thread of ParallelFor is not counted)
+	explicit RegionThreadPool(int workerCount);
+	//Stops and joins the worker threads
+	~RegionThreadPool();
+	//Returns the pool used by Region operations, which has one thread per core (counting the calling thread)
+	static RegionThreadPool& GetShared();
+	//Returns the number of threads which work on a ParallelFor, including the calling thread
+	int GetThreadCount() const;
+	//Changes the number of worker threads.  Must not be called while a ParallelFor is running on the pool.
+	void SetWorkerCount(int workerCount);
+	//Calls body(index) for every index from 0 to count - 1, spread over the pool threads and the calling thread,
+	//and returns once every call has finished.  If the pool is already busy (such as when called from inside of a task),
+	//the calls all run on the calling thread.
+	//If a call throws, the calls which have not started yet are skipped, and the exception is rethrown on the calling thread
+	//after the calls already running have finished.
+	template <class Body>
+	void ParallelFor(size_t count, const Body& body)
+	{
+		Run(count, &Invoke<Body>, (void*)&body);
+	}
+};
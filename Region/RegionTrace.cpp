@@ -0,0 +1,559 @@
+#include "RegionTrace.h"
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string.h>
+
+#if REGION_USE_TRACE
+#include <atomic>
+#include <mutex>
+#endif
+
+//First bytes of a trace file, followed by the version
+static const char TraceMagic[8] = { 'R', 'G', 'N', 'T', 'R', 'A', 'C', 'E' };
+static const unsigned int TraceVersion = 1;
+
+//Reads the numbers written while recording (by WriteVarint, WriteSigned and WriteRect), and remembers if it ran past the end of the data
+struct TraceReader
+{
+	const byte* p;
+	const byte* pEnd;
+	bool failed;
+	TraceReader(const byte* p, const byte* pEnd) : p(p), pEnd(pEnd), failed(false) {}
+	bool AtEnd() const
+	{
+		return p == pEnd;
+	}
+	uint64_t ReadVarint()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (p == pEnd)
+			{
+				failed = true;
+				return 0;
+			}
+			byte b = *p++;
+			value |= (uint64_t)(b & 0x7F) << shift;
+			if ((b & 0x80) == 0)
+			{
+				return value;
+			}
+		}
+		failed = true;
+		return 0;
+	}
+	int64_t ReadSigned()
+	{
+		uint64_t value = ReadVarint();
+		return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+	}
+	RECT ReadRect()
+	{
+		RECT rect;
+		rect.left = (LONG)ReadSigned();
+		rect.top = (LONG)ReadSigned();
+		rect.right = (LONG)(rect.left + ReadSigned());
+		rect.bottom = (LONG)(rect.top + ReadSigned());
+		return rect;
+	}
+};
+
+#if REGION_USE_TRACE
+//Appends an unsigned LEB128 varint
+static void WriteVarint(vector<byte>& output, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		output.push_back((byte)(value | 0x80));
+		value >>= 7;
+	}
+	output.push_back((byte)value);
+}
+//Appends a signed number as a zigzag encoded varint (small negative numbers stay small)
+static void WriteSigned(vector<byte>& output, int64_t value)
+{
+	WriteVarint(output, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+static void WriteRect(vector<byte>& output, const RECT& rect)
+{
+	WriteSigned(output, rect.left);
+	WriteSigned(output, rect.top);
+	WriteSigned(output, (int64_t)rect.right - rect.left);
+	WriteSigned(output, (int64_t)rect.bottom - rect.top);
+}
+
+//State of the recording
+struct TraceRecorder
+{
+	std::mutex mutex;
+	std::ofstream file;
+	//Checked without the lock by every operation, so it's cheap when nothing is being recorded
+	std::atomic<bool> recording;
+	//Increases every time a recording starts, so ids from an older recording are not reused
+	DWORD generation;
+	DWORD nextId;
+	TraceRecorder() : recording(false), generation(0), nextId(1) {}
+};
+
+static TraceRecorder& GetRecorder()
+{
+	static TraceRecorder recorder;
+	return recorder;
+}
+
+//Number of RegionTraceOp objects running on this thread
+static thread_local int traceDepth = 0;
+
+/*static*/ bool RegionTrace::Start(const char* fileName)
+{
+	TraceRecorder& recorder = GetRecorder();
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	if (recorder.file.is_open())
+	{
+		recorder.file.close();
+	}
+	recorder.recording = false;
+	recorder.file.clear();
+	recorder.file.open(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!recorder.file.is_open())
+	{
+		return false;
+	}
+	vector<byte> header(TraceMagic, TraceMagic + sizeof(TraceMagic));
+	WriteVarint(header, TraceVersion);
+	recorder.file.write((const char*)&header[0], header.size());
+	recorder.generation++;
+	recorder.nextId = 1;
+	recorder.recording = true;
+	return true;
+}
+
+/*static*/ void RegionTrace::Stop()
+{
+	TraceRecorder& recorder = GetRecorder();
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	recorder.recording = false;
+	if (recorder.file.is_open())
+	{
+		recorder.file.close();
+	}
+}
+
+/*static*/ bool RegionTrace::IsRecording()
+{
+	return GetRecorder().recording.load(std::memory_order_relaxed);
+}
+
+/*static*/ DWORD RegionTrace::GetRegionId(const Region& region, bool define)
+{
+	TraceRecorder& recorder = GetRecorder();
+	if (region.traceId != 0 && region.traceGeneration == recorder.generation)
+	{
+		return region.traceId;
+	}
+	region.traceId = recorder.nextId++;
+	region.traceGeneration = recorder.generation;
+	if (define)
+	{
+		vector<byte> record;
+		record.push_back(REGION_TRACE_DEFINE);
+		WriteVarint(record, region.traceId);
+		WriteVarint(record, region.regionType);
+		size_t count;
+		const RECT* pRects = region.GetRegionRects(count);
+		WriteVarint(record, count);
+		for (size_t i = 0; i < count; i++)
+		{
+			WriteRect(record, pRects[i]);
+		}
+		WriteRecord(record, recorder.generation);
+	}
+	return region.traceId;
+}
+
+/*static*/ void RegionTrace::WriteRecord(const vector<byte>& record, DWORD generation)
+{
+	TraceRecorder& recorder = GetRecorder();
+	if (recorder.recording && recorder.generation == generation)
+	{
+		recorder.file.write((const char*)&record[0], record.size());
+	}
+}
+
+/*static*/ void RegionTrace::Destroy(Region& target)
+{
+	if (target.traceId == 0 || !IsRecording())
+	{
+		return;
+	}
+	Forget(target);
+}
+
+/*static*/ void RegionTrace::Forget(Region& target)
+{
+	TraceRecorder& recorder = GetRecorder();
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	if (target.traceId != 0 && target.traceGeneration == recorder.generation)
+	{
+		vector<byte> record;
+		record.push_back(REGION_TRACE_DESTROY);
+		WriteVarint(record, target.traceId);
+		WriteRecord(record, recorder.generation);
+	}
+	target.traceId = 0;
+}
+
+void RegionTraceOp::Begin(RegionTraceOpcode opcode, const Region* pOther)
+{
+	recording = RegionTrace::IsRecording() && traceDepth == 0;
+	traceDepth++;
+	if (!recording)
+	{
+		return;
+	}
+	TraceRecorder& recorder = GetRecorder();
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	generation = recorder.generation;
+	//A region being copied into is about to be overwritten, so its old contents don't need to be recorded
+	DWORD targetId = RegionTrace::GetRegionId(target, opcode != REGION_TRACE_COPY && opcode != REGION_TRACE_ASSIGN && opcode != REGION_TRACE_ASSIGN_RECT);
+	record.push_back((byte)opcode);
+	WriteVarint(record, targetId);
+	if (pOther != NULL)
+	{
+		WriteVarint(record, RegionTrace::GetRegionId(*pOther, true));
+	}
+}
+
+RegionTraceOp::RegionTraceOp(RegionTraceOpcode opcode, Region& target) : target(target)
+{
+	Begin(opcode, NULL);
+}
+
+RegionTraceOp::RegionTraceOp(RegionTraceOpcode opcode, Region& target, const RECT& rect) : target(target)
+{
+	Begin(opcode, NULL);
+	if (recording)
+	{
+		WriteRect(record, rect);
+	}
+}
+
+RegionTraceOp::RegionTraceOp(RegionTraceOpcode opcode, Region& target, const RECT* pRects, size_t count) : target(target)
+{
+	Begin(opcode, NULL);
+	if (recording)
+	{
+		WriteVarint(record, count);
+		for (size_t i = 0; i < count; i++)
+		{
+			WriteRect(record, pRects[i]);
+		}
+	}
+}
+
+RegionTraceOp::RegionTraceOp(RegionTraceOpcode opcode, Region& target, const Region& other) : target(target)
+{
+	Begin(opcode, &other);
+}
+
+RegionTraceOp::RegionTraceOp(RegionTraceOpcode opcode, Region& target, int value1, int value2, int value3) : target(target)
+{
+	Begin(opcode, NULL);
+	if (recording)
+	{
+		WriteSigned(record, value1);
+		WriteSigned(record, value2);
+		if (opcode == REGION_TRACE_SCALE)
+		{
+			WriteSigned(record, value3);
+		}
+	}
+}
+
+RegionTraceOp::~RegionTraceOp()
+{
+	traceDepth--;
+	if (!recording)
+	{
+		return;
+	}
+	record.push_back((byte)target.GetRegionType());
+	TraceRecorder& recorder = GetRecorder();
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	RegionTrace::WriteRecord(record, generation);
+}
+#endif
+
+//A decoded record, ready to replay
+struct ReplayRecord
+{
+	RegionTraceOpcode opcode;
+	DWORD targetId;
+	DWORD otherId;
+	//Rectangle operands are rects[rectStart] to rects[rectStart + rectCount - 1]
+	size_t rectStart;
+	size_t rectCount;
+	int values[3];
+	//Region type for Define records, or the recorded result type for operations
+	DWORD regionType;
+};
+
+//Decodes every record in a trace, returns false if the data is not a valid trace
+static bool DecodeTrace(const vector<byte>& data, vector<ReplayRecord>& records, vector<RECT>& rects)
+{
+	if (data.size() < sizeof(TraceMagic) || memcmp(&data[0], TraceMagic, sizeof(TraceMagic)) != 0)
+	{
+		return false;
+	}
+	TraceReader reader(&data[0] + sizeof(TraceMagic), &data[0] + data.size());
+	if (reader.ReadVarint() != TraceVersion)
+	{
+		return false;
+	}
+	while (!reader.AtEnd())
+	{
+		ReplayRecord record = {};
+		uint64_t opcode = reader.ReadVarint();
+		if (opcode >= REGION_TRACE_OPCODE_COUNT)
+		{
+			return false;
+		}
+		record.opcode = (RegionTraceOpcode)opcode;
+		record.targetId = (DWORD)reader.ReadVarint();
+		record.rectStart = rects.size();
+		bool needsOther = false;
+		switch (record.opcode)
+		{
+		case REGION_TRACE_DEFINE:
+		case REGION_TRACE_UNION_RECTS:
+			if (record.opcode == REGION_TRACE_DEFINE)
+			{
+				record.regionType = (DWORD)reader.ReadVarint();
+			}
+			record.rectCount = (size_t)reader.ReadVarint();
+			if (record.rectCount > (size_t)(reader.pEnd - reader.p))
+			{
+				//Each rectangle takes at least 4 bytes, so the count is bad
+				return false;
+			}
+			for (size_t i = 0; i < record.rectCount; i++)
+			{
+				rects.push_back(reader.ReadRect());
+			}
+			break;
+		case REGION_TRACE_DESTROY:
+		case REGION_TRACE_CLEAR:
+			break;
+		case REGION_TRACE_COPY:
+		case REGION_TRACE_ASSIGN:
+		case REGION_TRACE_SWAP:
+		case REGION_TRACE_UNION_REGION:
+		case REGION_TRACE_INTERSECT_REGION:
+		case REGION_TRACE_SUBTRACT_REGION:
+		case REGION_TRACE_XOR_REGION:
+			record.otherId = (DWORD)reader.ReadVarint();
+			needsOther = true;
+			break;
+		case REGION_TRACE_ASSIGN_RECT:
+		case REGION_TRACE_UNION_RECT:
+		case REGION_TRACE_INTERSECT_RECT:
+		case REGION_TRACE_SUBTRACT_RECT:
+		case REGION_TRACE_XOR_RECT:
+			rects.push_back(reader.ReadRect());
+			record.rectCount = 1;
+			break;
+		case REGION_TRACE_OFFSET:
+		case REGION_TRACE_SIMPLIFY:
+		case REGION_TRACE_SCALE:
+			record.values[0] = (int)reader.ReadSigned();
+			record.values[1] = (int)reader.ReadSigned();
+			if (record.opcode == REGION_TRACE_SCALE)
+			{
+				record.values[2] = (int)reader.ReadSigned();
+				if (record.values[0] < 0 || record.values[1] <= 0)
+				{
+					return false;
+				}
+			}
+			break;
+		default:
+			return false;
+		}
+		if (record.opcode != REGION_TRACE_DEFINE && record.opcode != REGION_TRACE_DESTROY)
+		{
+			record.regionType = (DWORD)reader.ReadVarint();
+		}
+		//Each record can bring in at most two new region ids, so larger ids mean the file is damaged
+		size_t maxId = 2 * (records.size() + 1);
+		if (reader.failed || record.targetId == 0 || record.targetId > maxId || (needsOther && (record.otherId == 0 || record.otherId > maxId)))
+		{
+			return false;
+		}
+		records.push_back(record);
+	}
+	return true;
+}
+
+//Returns the region with an id, creating it if it doesn't exist yet
+static Region& GetReplayRegion(vector<Region*>& regions, DWORD id)
+{
+	if (id >= regions.size())
+	{
+		regions.resize(id + 1, NULL);
+	}
+	if (regions[id] == NULL)
+	{
+		regions[id] = new Region();
+	}
+	return *regions[id];
+}
+
+//Adds a 64 bit value to an FNV-1a hash
+static uint64_t HashValue(uint64_t hash, uint64_t value)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		hash ^= (value >> (i * 8)) & 0xFF;
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+static const uint64_t HashStart = 0xCBF29CE484222325ULL;
+
+/*static*/ uint64_t RegionTrace::Checksum(const Region& region)
+{
+	uint64_t hash = HashValue(HashStart, region.GetRegionType());
+	size_t count;
+	const RECT* pRects = region.GetRegionRects(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		hash = HashValue(hash, (uint32_t)pRects[i].left | ((uint64_t)(uint32_t)pRects[i].top << 32));
+		hash = HashValue(hash, (uint32_t)pRects[i].right | ((uint64_t)(uint32_t)pRects[i].bottom << 32));
+	}
+	return hash;
+}
+
+/*static*/ bool RegionTrace::Replay(const char* fileName, int repeatCount, RegionReplayResult& result)
+{
+	memset(&result, 0, sizeof(result));
+	std::ifstream file(fileName, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	vector<byte> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	vector<ReplayRecord> records;
+	vector<RECT> rects;
+	if (!DecodeTrace(data, records, rects))
+	{
+		return false;
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	for (int repeat = 0; repeat < repeatCount; repeat++)
+	{
+		vector<Region*> regions;
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			const ReplayRecord& record = records[i];
+			const RECT* pRects = rects.empty() ? NULL : &rects[0] + record.rectStart;
+			if (record.opcode == REGION_TRACE_DESTROY)
+			{
+				if (record.targetId < regions.size())
+				{
+					delete regions[record.targetId];
+					regions[record.targetId] = NULL;
+				}
+				continue;
+			}
+			Region& target = GetReplayRegion(regions, record.targetId);
+			if (record.opcode == REGION_TRACE_DEFINE)
+			{
+				if (record.regionType == SIMPLEREGION && record.rectCount == 1)
+				{
+					target = pRects[0];
+				}
+				else
+				{
+					target.Clear();
+					target.UnionWith(pRects, record.rectCount);
+				}
+				continue;
+			}
+			Region* pOther = record.otherId != 0 ? &GetReplayRegion(regions, record.otherId) : NULL;
+			Clock::time_point start = Clock::now();
+			switch (record.opcode)
+			{
+			case REGION_TRACE_COPY:
+			case REGION_TRACE_ASSIGN: target = *pOther; break;
+			case REGION_TRACE_ASSIGN_RECT: target = pRects[0]; break;
+			case REGION_TRACE_SWAP: target.Swap(*pOther); break;
+			case REGION_TRACE_CLEAR: target.Clear(); break;
+			case REGION_TRACE_UNION_RECT: target.UnionWith(pRects[0]); break;
+			case REGION_TRACE_INTERSECT_RECT: target.IntersectWith(pRects[0]); break;
+			case REGION_TRACE_SUBTRACT_RECT: target.SubtractWith(pRects[0]); break;
+			case REGION_TRACE_XOR_RECT: target.XorWith(pRects[0]); break;
+			case REGION_TRACE_UNION_RECTS: target.UnionWith(pRects, record.rectCount); break;
+			case REGION_TRACE_UNION_REGION: target.UnionWith(*pOther); break;
+			case REGION_TRACE_INTERSECT_REGION: target.IntersectWith(*pOther); break;
+			case REGION_TRACE_SUBTRACT_REGION: target.SubtractWith(*pOther); break;
+			case REGION_TRACE_XOR_REGION: target.XorWith(*pOther); break;
+			case REGION_TRACE_OFFSET: target.OffsetBy(record.values[0], record.values[1]); break;
+			case REGION_TRACE_SCALE: target.ScaleBy(record.values[0], record.values[1], (RegionRounding)record.values[2]); break;
+			case REGION_TRACE_SIMPLIFY: target.Simplify((size_t)record.values[0], record.values[1]); break;
+			default: break;
+			}
+			double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+			result.totalNanoseconds += elapsed;
+			result.opcodeNanoseconds[record.opcode] += elapsed;
+			result.opcodeCounts[record.opcode]++;
+			result.operationCount++;
+			if (target.GetRegionType() != record.regionType)
+			{
+				result.mismatchCount++;
+			}
+		}
+
+		result.checksum = 0;
+		result.liveRegionCount = 0;
+		for (size_t id = 0; id < regions.size(); id++)
+		{
+			if (regions[id] != NULL)
+			{
+				result.checksum += Checksum(*regions[id]);
+				result.liveRegionCount++;
+				delete regions[id];
+			}
+		}
+	}
+	return true;
+}
+
+/*static*/ const char* RegionTrace::GetOpcodeName(RegionTraceOpcode opcode)
+{
+	static const char* const names[REGION_TRACE_OPCODE_COUNT] =
+	{
+		"define",
+		"destroy",
+		"copy",
+		"assign",
+		"assign_rect",
+		"swap",
+		"clear",
+		"union_rect",
+		"intersect_rect",
+		"subtract_rect",
+		"xor_rect",
+		"union_rects",
+		"union_region",
+		"intersect_region",
+		"subtract_region",
+		"xor_region",
+		"offset",
+		"scale",
+		"simplify",
+	};
+	return opcode < REGION_TRACE_OPCODE_COUNT ? names[opcode] : "unknown";
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include "Region.h"
+#include <stdint.h>
+
+//Recording of Region operations to a binary trace file, and replaying traces.
+//Recording needs REGION_USE_TRACE set to 1, replaying works in any build (see RegionReplay.cpp).
+//
+//Regions are identified by a number which is given out the first time a region appears in the trace.  At that point, a
+//Define record holds its contents, so operations on regions which were built before recording started (or built by
+//something which isn't recorded, such as AttachHrgn) still replay correctly.
+//
+//File format: the 8 bytes "RGNTRACE", a version number, then records until the end of the file.
+//Each record is an opcode byte and the target region id, followed by the operands for the opcode, and for operations which
+//change a region, the resulting region type.  Numbers are LEB128 varints, signed numbers are zigzag encoded,
+//and rectangles are stored as left, top, width, height.
+
+//Record types
+enum RegionTraceOpcode
+{
+	//Region contents: type, rectangle count, rectangles
+	REGION_TRACE_DEFINE,
+	//Region was destroyed: no operands
+	REGION_TRACE_DESTROY,
+	//Target is a new region copied from another: source region id
+	REGION_TRACE_COPY,
+	//operator=: source region id
+	REGION_TRACE_ASSIGN,
+	//operator= with a rectangle: rectangle
+	REGION_TRACE_ASSIGN_RECT,
+	//Swap (also used for moves): other region id
+	REGION_TRACE_SWAP,
+	//Clear: no operands
+	REGION_TRACE_CLEAR,
+	//Operations with a rectangle: rectangle
+	REGION_TRACE_UNION_RECT,
+	REGION_TRACE_INTERSECT_RECT,
+	REGION_TRACE_SUBTRACT_RECT,
+	REGION_TRACE_XOR_RECT,
+	//Union with an array of rectangles: rectangle count, rectangles
+	REGION_TRACE_UNION_RECTS,
+	//Operations with another region: other region id
+	REGION_TRACE_UNION_REGION,
+	REGION_TRACE_INTERSECT_REGION,
+	REGION_TRACE_SUBTRACT_REGION,
+	REGION_TRACE_XOR_REGION,
+	//OffsetBy: dx, dy
+	REGION_TRACE_OFFSET,
+	//ScaleBy: num, den, rounding
+	REGION_TRACE_SCALE,
+	//Simplify: maxRects, maxWastePercent
+	REGION_TRACE_SIMPLIFY,
+	REGION_TRACE_OPCODE_COUNT
+};
+
+//Results of replaying a trace
+struct RegionReplayResult
+{
+	//Number of operations replayed (not counting Define and Destroy records)
+	size_t operationCount;
+	//Number of operations whose result type was different from the recorded result type
+	size_t mismatchCount;
+	//Time taken by the operations, in nanoseconds, in total and for each opcode
+	double totalNanoseconds;
+	double opcodeNanoseconds[REGION_TRACE_OPCODE_COUNT];
+	//Number of operations for each opcode
+	size_t opcodeCounts[REGION_TRACE_OPCODE_COUNT];
+	//Sum of the checksums of every region that was still alive at the end of the trace
+	uint64_t checksum;
+	//Number of regions still alive at the end of the trace
+	size_t liveRegionCount;
+};
+
+class RegionTrace
+{
+public:
+#if REGION_USE_TRACE
+	//Starts recording every Region operation on every thread to a file (stops any recording which was already running).
+	//Returns false if the file couldn't be created.
+	static bool Start(const char* fileName);
+	//Stops recording, and closes the file
+	static void Stop();
+	//Returns true if a recording is running
+	static bool IsRecording();
+
+	//Hooks used by Region.cpp (through the REGION_TRACE macros)
+	static void Destroy(Region& target);
+	static void Forget(Region& target);
+#endif
+
+	//Replays a trace file.  Returns false if the file can't be read or is not a valid trace.
+	//Every operation is timed, and the whole trace is replayed repeatCount times (the result has the totals).
+	static bool Replay(const char* fileName, int repeatCount, RegionReplayResult& result);
+	//Returns a checksum of a region's type and rectangles, which is the same for equal regions in every build
+	static uint64_t Checksum(const Region& region);
+	//Returns a name for an opcode
+	static const char* GetOpcodeName(RegionTraceOpcode opcode);
+#if REGION_USE_TRACE
+private:
+	friend class RegionTraceOp;
+	//Returns the id of a region in the current recording.  If it doesn't have one yet, gives it one,
+	//and unless it's about to be overwritten (define is false), writes a Define record with its contents.
+	//Call with the recording lock held.
+	static DWORD GetRegionId(const Region& region, bool define);
+	//Writes a finished record to the file, if the recording it was made for is still running.  Call with the recording lock held.
+	static void WriteRecord(const vector<byte>& record, DWORD generation);
+#endif
+};
+
+#if REGION_USE_TRACE
+//Records an operation on a region.  Operands which are regions are given ids (and defined) when the operation starts,
+//and the record is written when the operation is finished, so it has the result type.
+//Operations called from inside of a recorded operation are not recorded.
+class RegionTraceOp
+{
+private:
+	Region& target;
+	//The record so far (written when the operation is finished)
+	vector<byte> record;
+	//False if not recording, or inside of another recorded operation
+	bool recording;
+	//Recording the operation started in
+	DWORD generation;
+	//Starts the record: gives ids to the target and the other region (if any), and writes the opcode and ids
+	void Begin(RegionTraceOpcode opcode, const Region* pOther);
+	//Not copyable
+	RegionTraceOp(const RegionTraceOp& other);
+	RegionTraceOp& operator=(const RegionTraceOp& other);
+public:
+	//Operation without operands (Clear)
+	RegionTraceOp(RegionTraceOpcode opcode, Region& target);
+	//Operation with a rectangle
+	RegionTraceOp(RegionTraceOpcode opcode, Region& target, const RECT& rect);
+	//Operation with an array of rectangles
+	RegionTraceOp(RegionTraceOpcode opcode, Region& target, const RECT* pRects, size_t count);
+	//Operation with another region
+	RegionTraceOp(RegionTraceOpcode opcode, Region& target, const Region& other);
+	//Operation with numbers (offset, scale, simplify)
+	RegionTraceOp(RegionTraceOpcode opcode, Region& target, int value1, int value2, int value3 = 0);
+	//Adds the result type, and writes the record
+	~RegionTraceOp();
+};
+
+#define REGION_TRACE(...) RegionTraceOp regionTraceOp(__VA_ARGS__)
+#define REGION_TRACE_DESTROY(target) RegionTrace::Destroy(target)
+#define REGION_TRACE_FORGET(target) RegionTrace::Forget(target)
+#else
+#define REGION_TRACE(...) ((void)0)
+#define REGION_TRACE_DESTROY(target) ((void)0)
+#define REGION_TRACE_FORGET(target) ((void)0)
+#endif
@@ -1,6 +1,20 @@
 #include "Region.h"
 #include "RectEquals.h"
+#include "RegionAccumulator.h"
+#include "RegionArena.h"
+#include "RegionDamageHistory.h"
+#include "RegionOpCache.h"
+#include "RegionSimd.h"
+#include "RegionStats.h"
+#include "RegionThreadPool.h"
+#include "RegionTrace.h"
+#include <algorithm>
 #include <assert.h>
+#include <limits.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <thread>
+#include <type_traits>
 
 bool RegionDataHeaderOkay(const vector<byte> &bytes, int rectCount, const RECT &boundingBox)
 {
@@ -14,6 +28,44 @@ bool RegionDataHeaderOkay(const vector<byte> &bytes, int rectCount, const RECT &
 	return true;
 }
 
+bool RegionSummaryOkay(const Region& region)
+{
+	vector<RECT> rects = region.GetRegionRects();
+	int64_t area = 0;
+	size_t bandCount = 0;
+	for (size_t i = 0; i < rects.size(); i++)
+	{
+		area += (int64_t)(rects[i].right - rects[i].left) * (rects[i].bottom - rects[i].top);
+		if (i == 0 || rects[i].top != rects[i - 1].top) bandCount++;
+	}
+	if (region.GetArea() != area) return false;
+	if (region.GetRectCount() != rects.size()) return false;
+	if (region.GetBandCount() != bandCount) return false;
+	//a region built from the same rectangles has the same hash
+	if (Region(rects.data(), rects.size()).GetHash() != region.GetHash()) return false;
+	//the region data header is kept up to date as the region changes
+	size_t size;
+	const RGNDATAHEADER* pHeader = region.GetRegionData(size);
+	vector<byte> bytes = region.GetRegionData();
+	if (size != bytes.size() || memcmp(pHeader, &bytes[0], size) != 0) return false;
+	return true;
+}
+
+//True if a region with other coordinates has the same rectangles as a Region
+template <class Coord>
+bool SameRects(const BasicRegion<Coord>& region, const Region& expected)
+{
+	size_t count, expectedCount;
+	const typename BasicRegion<Coord>::Rect* pRects = region.GetRegionRects(count);
+	const RECT* pExpected = expected.GetRegionRects(expectedCount);
+	if (count != expectedCount) return false;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (pRects[i].left != pExpected[i].left || pRects[i].top != pExpected[i].top || pRects[i].right != pExpected[i].right || pRects[i].bottom != pExpected[i].bottom) return false;
+	}
+	return region.GetRegionType() == expected.GetRegionType() && region.GetArea() == expected.GetArea();
+}
+
 int main()
 {
 	int regionType;
@@ -105,10 +157,6 @@ int main()
 	assert(RegionDataHeaderOkay(bytes, (int)rects.size(), empty1.GetBoundingBox()));
 
 
-	
-	//for coverage
-	FreeTempRegion();
-
 	//testing GetBoundingBox with 4 ints
 	int x, y, w, h;
 	C.GetBoundingBox(x, y, w, h);
@@ -159,6 +207,7 @@ int main()
 	R.UnionWith(C);
 	R.UnionWith(B);
 	R.Clear();
+#if REGION_USE_WIN32
 	//trigger GetHrgn for existing but not valid NULLREGION
 	HRGN dummyHrgn = R.DetachHrgn();
 	DeleteObject(dummyHrgn); dummyHrgn = NULL;
@@ -184,6 +233,7 @@ int main()
 	hrgnAD = (HRGN)0x12345678;
 	R.UnionWith(A);
 	R.IntersectWith(hrgnAD);
+#endif
 
 	//Test conditions inside of UnionRectWithRect
 	R.Clear();
@@ -224,11 +274,13 @@ int main()
 	//trigger Empty union Complex (copies bounding box instead of combining it)
 	R.UnionWith(R2);
 
+#if REGION_USE_WIN32
 	//test Union with HRGN
 	HRGN hrgnR2 = R2.DetachHrgn();
 	R.Clear();
 	R.UnionWith(hrgnR2);
 	DeleteObject(hrgnR2); hrgnR2 = NULL;
+#endif
 
 	//test Become Complex Region
 	R2.Clear();
@@ -251,12 +303,14 @@ int main()
 	R3 = &rectA;
 	R3 = R;
 	Region R4(0, 0, 50, 50);
+#if REGION_USE_WIN32
 	HRGN hrgnR3 = R3.DetachHrgn();
 	Region R5(hrgnR3);
 	DeleteObject(hrgnR3); hrgnR3 = NULL;
 	R3 = R;
 	hrgnR3 = R3.DetachHrgn();
 	Region R6(&hrgnR3);
+#endif
 	Region AB2(rectA, rectB);
 
 	//R value assignment and constructor
@@ -278,11 +332,13 @@ int main()
 	R3 = R3.Union(0, 0, 100, 100);
 	R3 = R;
 	R3 = R3.Union(0, 0, 100, 100);
+#if REGION_USE_WIN32
 	R3 = R;
 	hrgnR3 = R3.DetachHrgn();
 	R3 = R;
 	R3 = R3.Union(hrgnR3);
 	DeleteObject(hrgnR3); hrgnR3 = NULL;
+#endif
 
 	R3 = R;
 	R3.IntersectWith(A);
@@ -305,6 +361,7 @@ int main()
 	R3.UnionWith(A);
 	R3.IntersectWith(empty1);
 	R3.UnionWith(A);
+#if REGION_USE_WIN32
 	hrgnR3 = R3.DetachHrgn();
 	R3.Clear();
 	R3.UnionWith(A);
@@ -316,6 +373,7 @@ int main()
 	R3.Clear();
 	R3.IntersectWith(hrgnR3);
 	DeleteObject(hrgnR3); hrgnR3 = NULL;
+#endif
 	R3.Clear();
 	R3.IntersectWith(0, 0, 0, 0);
 	R3.IntersectWith(&rectA);
@@ -330,9 +388,11 @@ int main()
 	R3 = R.Intersect(R2);
 	R3 = R.Intersect(rectA);
 	R3 = R.Intersect(&rectA);
+#if REGION_USE_WIN32
 	hrgnR3 = R3.DetachHrgn();
 	R3 = R.Intersect(hrgnR3);
 	DeleteObject(hrgnR3); hrgnR3 = NULL;
+#endif
 	R3 = R.Intersect(0, 0, 50, 50);
 	R3.Clear();
 	R3.IntersectWith(A);
@@ -344,6 +404,1187 @@ int main()
 	R3 = R.Intersect(R3);
 	int dummy = 0;
 
+#if REGION_USE_WIN32
 	hrgnR3 = R.DetachHrgnCopy();
 	DeleteObject(hrgnR3); hrgnR3 = NULL;
+#endif
+
+	//band engine: L shape made of a wide band on top of a narrow band
+	R.Clear();
+	R.UnionWith(0, 0, 100, 50);
+	R.UnionWith(0, 50, 50, 50);
+	assert(R.GetRegionType() == COMPLEXREGION);
+	assert(R.GetBoundingBox() == rectABCD);
+	rects = R.GetRegionRects();
+	assert(rects.size() == 2);
+	assert(rects[0] == rectAB && rects[1] == rectC);
+	//building the same shape in a different order gives an identical region
+	R2.Clear();
+	R2.UnionWith(C);
+	R2.UnionWith(B);
+	R2.UnionWith(A);
+	assert(R2 == R);
+	//overlapping rectangles are split into bands
+	R.Clear();
+	R.UnionWith(0, 0, 20, 20);
+	R.UnionWith(10, 10, 20, 20);
+	rects = R.GetRegionRects();
+	assert(rects.size() == 3);
+	RECT overlap0 = { 0, 0, 20, 10 };
+	RECT overlap1 = { 0, 10, 30, 20 };
+	RECT overlap2 = { 10, 20, 30, 30 };
+	assert(rects[0] == overlap0 && rects[1] == overlap1 && rects[2] == overlap2);
+	//intersecting two complex regions
+	R2.Clear();
+	R2.UnionWith(5, 5, 20, 20);
+	R2.UnionWith(0, 25, 5, 5);
+	R3 = R.Intersect(R2);
+	rects = R3.GetRegionRects();
+	RECT intersect0 = { 5, 5, 20, 10 };
+	RECT intersect1 = { 5, 10, 25, 20 };
+	RECT intersect2 = { 10, 20, 25, 25 };
+	assert(rects.size() == 3);
+	assert(rects[0] == intersect0 && rects[1] == intersect1 && rects[2] == intersect2);
+	RECT intersectBounds = { 5, 5, 25, 25 };
+	assert(R3.GetBoundingBox() == intersectBounds);
+	//intersecting down to a single rectangle becomes a simple region
+	R3.IntersectWith(5, 5, 10, 10);
+	assert(R3.GetRegionType() == SIMPLEREGION);
+	RECT intersectSimple = { 5, 5, 15, 15 };
+	assert(R3.GetBoundingBox() == intersectSimple);
+	//empty rectangles add nothing
+	R3.UnionWith(rectEmpty);
+	assert(R3.GetBoundingBox() == intersectSimple);
+	Region emptyRect(0, 0, 0, 0);
+	assert(emptyRect.GetRegionType() == NULLREGION);
+
+	//subtract: rectangle covering us up leaves nothing
+	R = rectA;
+	R.SubtractWith(-1, -1, 52, 52);
+	assert(R.GetRegionType() == NULLREGION);
+	//subtract: full width slab off the top leaves a rectangle
+	R = rectABCD;
+	R.SubtractWith(rectAB);
+	assert(R.GetRegionType() == SIMPLEREGION);
+	assert(R.GetBoundingBox() == rectCD);
+	//subtract: full height slab off the left leaves a rectangle
+	R = rectABCD;
+	R.SubtractWith(-10, -10, 60, 200);
+	assert(R.GetRegionType() == SIMPLEREGION);
+	RECT rectBD = { 50, 0, 100, 100 };
+	assert(R.GetBoundingBox() == rectBD);
+	//subtract: non-overlapping rectangle changes nothing
+	R = rectA;
+	R.SubtractWith(rectD);
+	assert(R == A);
+	//subtract: hole in the middle
+	R = rectABCD;
+	R.SubtractWith(25, 25, 50, 50);
+	assert(R.GetRegionType() == COMPLEXREGION);
+	assert(R.GetBoundingBox() == rectABCD);
+	rects = R.GetRegionRects();
+	assert(rects.size() == 4);
+	//subtract: removing the pieces again gives back the rectangle with a hole
+	R2 = rectABCD;
+	R2.SubtractWith(R);
+	assert(R2 == Region(25, 25, 50, 50));
+	R3 = Region(rectABCD).Subtract(R);
+	assert(R3 == R2);
+	R3.SubtractWith(R3);
+	assert(R3.GetRegionType() == NULLREGION);
+	//subtract: complex minus complex
+	R = Region(A, D);
+	R2 = Region(B, D);
+	R3 = R.Subtract(R2);
+	assert(R3 == A);
+	R3 = R.Subtract(&rectD);
+	assert(R3 == A);
+	R3 = R.Subtract(50, 50, 50, 50);
+	assert(R3 == A);
+
+	//xor: same rectangle cancels out
+	R = rectA;
+	R.XorWith(&rectA);
+	assert(R.GetRegionType() == NULLREGION);
+	//xor: disjoint rectangles are the same as union
+	R = rectA;
+	R.XorWith(rectB);
+	assert(R == Region(rectAB));
+	//xor: overlapping rectangles
+	R = rectAB;
+	R.XorWith(25, 0, 50, 50);
+	rects = R.GetRegionRects();
+	assert(rects.size() == 2);
+	RECT xor0 = { 0, 0, 25, 50 };
+	RECT xor1 = { 75, 0, 100, 50 };
+	assert(rects[0] == xor0 && rects[1] == xor1);
+	//xor: checkerboard pieces
+	R = Region(A, D);
+	R2 = Region(B, C);
+	R3 = R.Xor(R2);
+	assert(R3 == Region(rectABCD));
+	R3.XorWith(R);
+	assert(R3 == R2);
+	R3 = R.Xor(rectABCD);
+	assert(R3 == R2);
+	R3 = R.Xor(0, 0, 100, 100);
+	assert(R3 == R2);
+	R3.XorWith(R3);
+	assert(R3.GetRegionType() == NULLREGION);
+
+	//bulk union: unsorted, overlapping and empty rectangles
+	RECT bulkRects[] = { rectD, rectEmpty, rectC, { 10, 10, 20, 20 }, rectB, rectA };
+	Region bulk(bulkRects, 6);
+	assert(bulk.GetRegionType() == SIMPLEREGION);
+	assert(bulk.GetBoundingBox() == rectABCD);
+	Region bulk2(bulkRects, 3);
+	assert(bulk2 == Region(rectD).Union(rectC));
+	//bulk union onto an existing region matches one at a time union
+	R = Region(A, D);
+	R.UnionWith(bulkRects, 3);
+	R2 = Region(A, D);
+	R2.UnionWith(rectD);
+	R2.UnionWith(rectC);
+	assert(R == R2);
+	R.UnionWith(bulkRects, 0);
+	assert(R == R2);
+
+	//small complex regions are stored inline, larger ones allocate: swapping and copying between the two
+	Region small(A, D);
+	Region large;
+	for (int i = 0; i < REGION_INLINE_RECT_COUNT + 4; i++)
+	{
+		large.UnionWith(i * 20, i * 20, 10, 10);
+	}
+	assert(large.GetRegionRects().size() == REGION_INLINE_RECT_COUNT + 4);
+	Region smallCopy(small);
+	Region largeCopy(large);
+	small.Swap(large);
+	assert(small == largeCopy && large == smallCopy);
+	small.Swap(large);
+	assert(small == smallCopy && large == largeCopy);
+	smallCopy = largeCopy;
+	assert(smallCopy == large);
+	smallCopy.IntersectWith(0, 0, 15, 15);
+	assert(smallCopy == Region(0, 0, 10, 10));
+	largeCopy = small;
+	assert(largeCopy == small);
+
+	//hit testing: rectangle with a hole in the middle
+	R = rectABCD;
+	R.SubtractWith(25, 25, 50, 50);
+	assert(R.ContainsPoint(0, 0) && R.ContainsPoint(99, 99) && R.ContainsPoint(24, 50));
+	assert(!R.ContainsPoint(50, 50) && !R.ContainsPoint(100, 0) && !R.ContainsPoint(0, 100) && !R.ContainsPoint(-1, 0));
+	assert(A.ContainsPoint(49, 49) && !A.ContainsPoint(50, 49) && !empty1.ContainsPoint(0, 0));
+	RECT topStrip = { 0, 0, 100, 25 };
+	RECT leftColumn = { 0, 0, 25, 100 };
+	RECT hole = { 25, 25, 75, 75 };
+	RECT acrossHole = { 20, 20, 30, 30 };
+	assert(R.ContainsRect(topStrip) && R.ContainsRect(&leftColumn));
+	assert(!R.ContainsRect(hole) && !R.ContainsRect(acrossHole) && !R.ContainsRect(rectABCD) && !R.ContainsRect(rectEmpty));
+	assert(A.ContainsRect(rectA) && !A.ContainsRect(rectAB));
+	assert(R.OverlapsRect(acrossHole) && R.OverlapsRect(&rectABCD) && !R.OverlapsRect(hole) && !R.OverlapsRect(rectEmpty));
+	assert(A.OverlapsRect(rectAB) && !A.OverlapsRect(rectD) && !empty1.OverlapsRect(rectA));
+	//checkerboard: touching corners do not make a rectangle contained
+	R = Region(A, D);
+	assert(!R.ContainsRect(rectABCD) && R.ContainsRect(rectD) && !R.OverlapsRect(rectB));
+
+	//offset moves every rectangle and the bounding box
+	R = Region(A, D);
+	R.OffsetBy(10, -5);
+	R2 = Region(10, -5, 50, 50);
+	R2.UnionWith(60, 45, 50, 50);
+	assert(R == R2);
+	R3 = rectA;
+	R3.OffsetBy(50, 50);
+	assert(R3 == D);
+	empty1.OffsetBy(5, 5);
+	assert(empty1.GetRegionType() == NULLREGION);
+	//scale a complex region up and back down again
+	R = Region(A, D);
+	R.ScaleBy(3, 2, REGION_ROUND_OUTWARD);
+	R2 = Region(0, 0, 75, 75);
+	R2.UnionWith(75, 75, 75, 75);
+	assert(R == R2);
+	R.ScaleBy(2, 3, REGION_ROUND_INWARD);
+	assert(R == Region(A, D));
+	//scale with rounding: 1/3 of 50 is not a whole number
+	R3 = rectA;
+	R3.ScaleBy(1, 3, REGION_ROUND_OUTWARD);
+	assert(R3 == Region(0, 0, 17, 17));
+	R3 = rectA;
+	R3.ScaleBy(1, 3, REGION_ROUND_INWARD);
+	assert(R3 == Region(0, 0, 16, 16));
+	//rounding outward makes rectangles overlap, the region gets rebuilt
+	R = Region(0, 0, 1, 1);
+	R.UnionWith(1, 1, 1, 1);
+	R.ScaleBy(1, 2, REGION_ROUND_OUTWARD);
+	assert(R == Region(0, 0, 1, 1));
+	//rounding inward makes rectangles vanish
+	R = Region(0, 0, 10, 1);
+	R.UnionWith(0, 1, 1, 9);
+	R.ScaleBy(1, 2, REGION_ROUND_INWARD);
+	assert(R.GetRegionType() == NULLREGION);
+
+	//arena: regions created inside of the scope allocate from the arena, regions created outside keep using the heap
+	RegionArena arena(256);
+	Region persistent;
+	for (int frame = 0; frame < 3; frame++)
+	{
+		{
+			RegionArenaScope scope(arena);
+			Region transient;
+			for (int i = 0; i < 20; i++)
+			{
+				transient.UnionWith(i * 20, 0, 10, 10);
+			}
+			assert(arena.GetLiveAllocations() == 1);
+			//the intersection doesn't change anything, so it shares the rectangles of the original
+			Region transient2 = transient.Intersect(0, 0, 1000, 15);
+			assert(arena.GetLiveAllocations() == 1);
+			Region transient3 = transient.Intersect(0, 0, 1000, 5);
+			assert(arena.GetLiveAllocations() == 2);
+			persistent = transient2;
+			assert(arena.GetLiveAllocations() == 2);
+			persistent.UnionWith(transient3);
+			assert(arena.GetLiveAllocations() == 2);
+			{
+				//nested scopes restore the previous arena
+				RegionArena innerArena;
+				RegionArenaScope innerScope(innerArena);
+				assert(RegionArena::GetCurrent() == &innerArena);
+			}
+			assert(RegionArena::GetCurrent() == &arena);
+		}
+		assert(RegionArena::GetCurrent() == NULL);
+		assert(arena.GetLiveAllocations() == 0);
+		arena.Reset();
+		assert(persistent.GetRegionRects().size() == 20);
+	}
+	//copies share their rectangles until one of them is modified
+	{
+		Region original;
+		for (int i = 0; i < 20; i++)
+		{
+			original.UnionWith(i * 20, i, 10, 10);
+		}
+		Region saved = original;
+		Region copy = original;
+		copy.OffsetBy(5, 5);
+		assert(original == saved);
+		copy.OffsetBy(-5, -5);
+		assert(copy == original);
+		copy = original;
+		copy.ScaleBy(2, 1, REGION_ROUND_OUTWARD);
+		assert(original == saved);
+		copy = original;
+		copy.UnionWith(1000, 0, 10, 10);
+		assert(original == saved);
+		assert(copy.ContainsPoint(1005, 5) && !original.ContainsPoint(1005, 5));
+		//sharing with a region that uses the same arena doesn't allocate
+		RegionArenaScope scope(arena);
+		Region transient = original.Intersect(0, 0, 1000, 15);
+		assert(arena.GetLiveAllocations() == 1);
+		Region transient2 = transient;
+		assert(arena.GetLiveAllocations() == 1);
+		transient2.OffsetBy(1, 1);
+		assert(arena.GetLiveAllocations() == 2);
+		assert(transient2 != transient);
+	}
+	arena.Reset();
+	//assigning or swapping a region made in an arena into a region which uses the heap copies the rectangles out of the arena
+	{
+		Region a, b;
+		for (int i = 0; i < 20; i++)
+		{
+			a.UnionWith(i * 20, 0, 10, 10);
+			b.UnionWith(i * 20 + 5, 5, 10, 10);
+		}
+		Region expected = a.Union(b);
+		Region longLived;
+		Region swapped = b;
+		{
+			RegionArenaScope scope(arena);
+			longLived = a.Union(b);
+			Region transient = a.Intersect(b);
+			//only transient is in the arena, longLived copied the union out of it
+			assert(arena.GetLiveAllocations() == 1);
+			swapped.Swap(transient);
+			Region moved(std::move(transient));
+			assert(moved == b && swapped == a.Intersect(b));
+			//a move constructed region takes the other region's arena along with its rectangles, so it never allocates
+			static_assert(std::is_nothrow_move_constructible<Region>::value, "moving a region doesn't throw");
+			size_t liveBefore = arena.GetLiveAllocations();
+			Region transient2 = a.Intersect(b);
+			assert(arena.GetLiveAllocations() == liveBefore + 1);
+			{
+				RegionArenaScope heapScope((RegionArena*)NULL);
+				Region moved2(std::move(transient2));
+				assert(arena.GetLiveAllocations() == liveBefore + 1);
+				assert(moved2 == a.Intersect(b) && transient2.GetRegionType() == NULLREGION);
+			}
+			assert(arena.GetLiveAllocations() == liveBefore);
+		}
+		assert(arena.GetLiveAllocations() == 0);
+		arena.Reset();
+		assert(longLived == expected && swapped == a.Intersect(b));
+	}
+	//simplify: fill in the gaps between rectangles, but only as much as the waste limit allows
+	R = Region(0, 0, 10, 10);
+	R.UnionWith(20, 0, 10, 10);
+	R2 = R;
+	R2.Simplify(1, 10);
+	assert(R2 == R);
+	R2.Simplify(1, 50);
+	assert(R2 == Region(0, 0, 30, 10));
+	//a grid of small rectangles becomes a few rectangles which cover all of them
+	R = Region();
+	for (int y = 0; y < 10; y++)
+	{
+		for (int x = 0; x < 10; x++)
+		{
+			R.UnionWith(x * 10 + (y & 1) * 3, y * 10, 6, 6);
+		}
+	}
+	R2 = R;
+	R2.Simplify(4, 1000);
+	assert(R2.GetRegionRects().size() <= 4);
+	assert(R.Subtract(R2).GetRegionType() == NULLREGION);
+	//regions which already have few enough rectangles are left alone
+	R2 = R;
+	R2.Simplify(1000, 0);
+	assert(R2 == R);
+	//views of the rectangles and region data don't copy anything, and stay correct after the region changes
+	{
+		size_t count;
+		size_t size;
+		R = Region(A, D);
+		const RECT* pRects = R.GetRegionRects(count);
+		assert(count == 2 && pRects[0] == rectA && pRects[1] == rectD);
+		const RGNDATAHEADER* pHeader = R.GetRegionData(size);
+		assert(size == R.GetRegionData().size() && memcmp(pHeader, &R.GetRegionData()[0], size) == 0);
+		assert((const RECT*)(pHeader + 1) == pRects);
+		R2 = R;
+		R2.OffsetBy(10, 0);
+		pHeader = R.GetRegionData(size);
+		assert(memcmp(pHeader, &R.GetRegionData()[0], size) == 0);
+		pHeader = R2.GetRegionData(size);
+		assert(memcmp(pHeader, &R2.GetRegionData()[0], size) == 0);
+		R = Region();
+		for (int i = 0; i < 20; i++)
+		{
+			R.UnionWith(i * 20, i, 10, 10);
+		}
+		pHeader = R.GetRegionData(size);
+		assert(size == R.GetRegionData().size() && memcmp(pHeader, &R.GetRegionData()[0], size) == 0);
+		R.UnionWith(1000, 0, 10, 10);
+		pHeader = R.GetRegionData(size);
+		assert(size == R.GetRegionData().size() && memcmp(pHeader, &R.GetRegionData()[0], size) == 0);
+		R = rectA;
+		pHeader = R.GetRegionData(size);
+		assert(RegionDataHeaderOkay(R.GetRegionData(), 1, rectA) && memcmp(pHeader, &R.GetRegionData()[0], size) == 0);
+		R = Region();
+		pHeader = R.GetRegionData(size);
+		assert(size == sizeof(RGNDATAHEADER) && pHeader->nCount == 0);
+	}
+	//region data header: written whenever the region changes, so reading it doesn't write to the region
+	{
+		Region inlineRegion = Region(A, D);
+		Region other = rectB;
+		assert(RegionSummaryOkay(inlineRegion) && RegionSummaryOkay(other));
+		inlineRegion.Swap(other);
+		assert(RegionSummaryOkay(inlineRegion) && RegionSummaryOkay(other));
+		inlineRegion.IntersectWith(60, 10, 20, 20);
+		assert(inlineRegion.GetRegionType() == SIMPLEREGION && RegionSummaryOkay(inlineRegion));
+		other.OffsetBy(5, -5);
+		assert(RegionSummaryOkay(other));
+		other.ScaleBy(2, 1, REGION_ROUND_OUTWARD);
+		assert(RegionSummaryOkay(other));
+		Region moved(std::move(other));
+		assert(RegionSummaryOkay(moved) && RegionSummaryOkay(other));
+		other = moved;
+		moved.Clear();
+		assert(RegionSummaryOkay(moved) && RegionSummaryOkay(other));
+		//reading the header doesn't change it, so it can be read from a const region on several threads
+		const Region& constRegion = other;
+		size_t size1, size2;
+		assert(constRegion.GetRegionData(size1) == constRegion.GetRegionData(size2) && size1 == size2);
+	}
+#if REGION_USE_STATS
+	//stats: count which paths were taken on this thread
+	{
+		RegionStats::Reset();
+		R = rectA;
+		R.UnionWith(rectB);
+		R.UnionWith(rectD);
+		R.IntersectWith(rectA);
+		R.SubtractWith(rectC);
+		RegionStatsSnapshot stats = RegionStats::GetThreadSnapshot();
+		assert(stats.counters[REGION_STAT_ALIGNED_MERGE] == 1);
+		assert(stats.counters[REGION_STAT_BECAME_COMPLEX] == 1);
+		assert(stats.counters[REGION_STAT_COMPLEX_OP] == 1);
+		assert(stats.counters[REGION_STAT_COMPLEX_OP_OUTPUT_RECTS] == 2);
+		assert(stats.counters[REGION_STAT_CLIP] == 1);
+		assert(stats.counters[REGION_STAT_CLIP_INPUT_RECTS] == 2);
+		assert(stats.counters[REGION_STAT_COVERS_UP] == 0);
+		assert(stats.counters[REGION_STAT_NULL_SHORTCUT] == 1);
+		assert(stats.GetOperationCount(REGION_STAT_UNION_RECT) == 2);
+		assert(stats.GetOperationCount(REGION_STAT_INTERSECT_RECT) == 1);
+		//operations inside of another operation are not timed separately
+		R.UnionWith(Region(rectA));
+		stats = RegionStats::GetThreadSnapshot();
+		assert(stats.GetOperationCount(REGION_STAT_UNION_REGION) == 1);
+		assert(stats.GetOperationCount(REGION_STAT_UNION_RECT) == 2);
+		assert(RegionStats::GetSnapshot().counters[REGION_STAT_COMPLEX_OP] >= 1);
+		assert(stats.ToText().find("became_complex: 1") != std::string::npos);
+		assert(stats.ToJson().find("\"became_complex\":1") != std::string::npos);
+		RegionStats::Reset();
+		assert(RegionStats::GetThreadSnapshot().counters[REGION_STAT_BECAME_COMPLEX] == 0);
+	}
+#endif
+#if REGION_USE_TRACE
+	//trace: record operations, then replay them and compare the results
+	{
+		const char* traceFile = "TestRegion.trace";
+		R = Region(A, D);
+		assert(RegionTrace::Start(traceFile));
+		Region R3 = R;
+		R3.UnionWith(rectB);
+		R3.XorWith(rectC);
+		R2 = rectA;
+		R2.SubtractWith(R);
+		R2.OffsetBy(5, 7);
+		{
+			Region temp(rectC);
+			temp.IntersectWith(R3);
+			R.UnionWith(temp);
+		}
+		R3.Swap(R2);
+		R3.ScaleBy(3, 2, REGION_ROUND_OUTWARD);
+		R3.Simplify(1, 100);
+		RegionTrace::Stop();
+		//not recorded
+		R.UnionWith(rectB);
+		R.SubtractWith(rectB);
+		RegionReplayResult result;
+		assert(RegionTrace::Replay(traceFile, 2, result));
+		assert(result.operationCount == 2 * 11);
+		assert(result.mismatchCount == 0);
+		assert(result.liveRegionCount == 3);
+		assert(result.checksum == RegionTrace::Checksum(R) + RegionTrace::Checksum(R2) + RegionTrace::Checksum(R3));
+		assert(result.opcodeCounts[REGION_TRACE_COPY] == 2 && result.opcodeCounts[REGION_TRACE_SWAP] == 2);
+		remove(traceFile);
+		assert(!RegionTrace::Replay(traceFile, 1, result));
+	}
+#endif
+	//clip: intersecting a complex region with a rectangle, with each instruction set
+	{
+		//a staircase of bands which only differ left of x = 40, and a grid of squares below them
+		Region stairs;
+		for (int i = 0; i < 20; i++)
+		{
+			RECT step = { i * 2, i * 5, 60, i * 5 + 5 };
+			stairs.UnionWith(step);
+		}
+		for (int y = 100; y < 200; y += 10)
+		{
+			for (int x = 0; x < 100; x += 10)
+			{
+				stairs.UnionWith(x, y, 5, 5);
+			}
+		}
+		RECT clips[] = { { 40, 10, 70, 150 }, { 3, 3, 47, 133 }, { -10, 98, 200, 103 }, { 6, 0, 9, 300 }, { 1, 101, 4, 104 } };
+		RegionSimdLevel defaultLevel = RegionSimd::GetLevel();
+		for (int level = REGION_SIMD_NONE; level < REGION_SIMD_LEVEL_COUNT; level++)
+		{
+			if (!RegionSimd::SetLevel((RegionSimdLevel)level))
+			{
+				continue;
+			}
+			for (size_t i = 0; i < sizeof(clips) / sizeof(clips[0]); i++)
+			{
+				R = stairs;
+				R.IntersectWith(clips[i]);
+				//same as removing everything outside of the rectangle
+				R2 = stairs;
+				R2.SubtractWith(stairs.Subtract(clips[i]));
+				assert(R == R2);
+				assert(R.GetBoundingBox() == R2.GetBoundingBox());
+				assert(Region(clips[i]).Intersect(stairs) == R2);
+			}
+			//the staircase becomes a single rectangle when only the part right of x = 40 is kept
+			R = stairs;
+			R.IntersectWith(clips[0]);
+			assert(R.GetRegionType() == COMPLEXREGION && R.Intersect(40, 10, 30, 90) == Region(40, 10, 20, 90));
+		}
+		RegionSimd::SetLevel(defaultLevel);
+		assert(RegionSimd::IsSupported(REGION_SIMD_NONE) && !RegionSimd::SetLevel(REGION_SIMD_LEVEL_COUNT));
+	}
+	//mask: regions built from 1bpp and 8bpp masks match the union of the runs of their rows
+	{
+		const int widths[] = { 1, 64, 150 };
+		const int height = 40;
+		for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+		{
+			int width = widths[w];
+			int stride1 = (width + 7) / 8 + 3;
+			vector<byte> alpha(width * height);
+			vector<byte> bits(stride1 * height);
+			vector<RECT> runs;
+			unsigned int seed = 1;
+			for (int y = 0; y < height; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					//groups of 4 rows are the same, except for the rows that change at x = 0 and x = width - 1
+					seed = seed * 1103515245 + 12345;
+					byte value = y > 0 && y % 4 != 0 ? alpha[(y - 1) * width + x] : (byte)(seed >> 16);
+					if ((x == 0 || x == width - 1) && y % 7 == 3) value = 255;
+					alpha[y * width + x] = value;
+					if (value >= 100)
+					{
+						bits[y * stride1 + x / 8] |= 0x80 >> (x % 8);
+						RECT pixel = { x, y, x + 1, y + 1 };
+						runs.push_back(pixel);
+					}
+				}
+			}
+			Region expected(runs.data(), runs.size());
+			RegionSimdLevel defaultLevel = RegionSimd::GetLevel();
+			for (int level = REGION_SIMD_NONE; level < REGION_SIMD_LEVEL_COUNT; level++)
+			{
+				if (RegionSimd::SetLevel((RegionSimdLevel)level))
+				{
+					R = Region(&alpha[0], width, height, width, REGION_MASK_8BPP, 100);
+					assert(R == expected && R.GetBoundingBox() == expected.GetBoundingBox());
+				}
+			}
+			RegionSimd::SetLevel(defaultLevel);
+			R = Region(&bits[0], width, height, stride1, REGION_MASK_1BPP, 0);
+			assert(R == expected && R.GetBoundingBox() == expected.GetBoundingBox());
+			//bottom-up, starting from the last row
+			R = Region(&bits[stride1 * (height - 1)], width, height, -stride1, REGION_MASK_1BPP, 0);
+			for (size_t i = 0; i < runs.size(); i++)
+			{
+				runs[i].top = height - 1 - runs[i].top;
+				runs[i].bottom = runs[i].top + 1;
+			}
+			assert(R == Region(runs.data(), runs.size()));
+		}
+		//a threshold of 0 takes every pixel, an empty mask gives an empty region
+		byte solid[3 * 5] = { 0 };
+		assert(Region(solid, 3, 5, 3, REGION_MASK_8BPP, 0) == Region(0, 0, 3, 5));
+		assert(Region(solid, 3, 5, 3, REGION_MASK_8BPP, 1).GetRegionType() == NULLREGION);
+		assert(Region(solid, 0, 5, 3, REGION_MASK_8BPP, 0).GetRegionType() == NULLREGION);
+	}
+	//spans: walking the spans of a region gives each row of each rectangle, clipped, in order
+	{
+		Region shapes[4];
+		shapes[1] = Region(5, 5, 3, 2);
+		//a ring next to a bar
+		shapes[2] = Region(0, 0, 10, 10);
+		shapes[2].SubtractWith(3, 3, 4, 4);
+		shapes[2].UnionWith(12, 2, 3, 8);
+		shapes[3] = shapes[2].Xor(0, 0, 7, 4);
+		RECT clips[] = { { -100, -100, 100, 100 }, { 3, 1, 12, 11 }, { 6, 6, 7, 7 }, { 0, 0, 0, 50 }, { 50, 50, 60, 60 } };
+		for (int i = 0; i < 4; i++)
+		{
+			vector<RECT> rects = shapes[i].GetRegionRects();
+			for (size_t c = 0; c < sizeof(clips) / sizeof(clips[0]); c++)
+			{
+				const RECT& clip = clips[c];
+				vector<RECT> expected;
+				for (size_t j = 0; j < rects.size(); j++)
+				{
+					for (int y = std::max(rects[j].top, clip.top); y < std::min(rects[j].bottom, clip.bottom); y++)
+					{
+						RECT span = { std::max(rects[j].left, clip.left), y, std::min(rects[j].right, clip.right), y + 1 };
+						if (span.left < span.right) expected.push_back(span);
+					}
+				}
+				std::sort(expected.begin(), expected.end(), [](const RECT& a, const RECT& b) { return a.top != b.top ? a.top < b.top : a.left < b.left; });
+				size_t count = 0;
+				for (const RegionSpan& span : shapes[i].GetSpans(clip))
+				{
+					assert(count < expected.size());
+					assert(span.y == expected[count].top && span.left == expected[count].left && span.right == expected[count].right);
+					count++;
+				}
+				assert(count == expected.size());
+			}
+		}
+		//a range of scanlines only
+		R = Region(0, 0, 10, 10);
+		R.SubtractWith(2, 0, 2, 10);
+		RegionSpans spans = R.GetSpans(3, 5);
+		RegionSpanIterator it = spans.begin();
+		assert(it->y == 3 && it->left == 0 && it->right == 2);
+		++it;
+		assert(it->y == 3 && it->left == 4 && it->right == 10);
+		it++;
+		assert(it->y == 4 && it->left == 0);
+		assert(std::distance(spans.begin(), spans.end()) == 4);
+		assert(Region().GetSpans(0, 10).begin() == Region().GetSpans(0, 10).end());
+	}
+	//damage history: the damage since a buffer age is the union of the damage of that many frames
+	{
+		RegionDamageHistory history(3);
+		assert(history.GetCapacity() == 3 && history.GetFrameCount() == 0);
+		assert(!history.GetDamageSince(1, R) && R.GetRegionType() == NULLREGION);
+		Region damage[5];
+		for (int i = 0; i < 5; i++)
+		{
+			damage[i] = Region(i * 10, 0, 15, 5 + i);
+			history.AddFrame(damage[i]);
+			int frameCount = i + 1 < 3 ? i + 1 : 3;
+			assert(history.GetFrameCount() == frameCount);
+			for (int age = 1; age <= frameCount; age++)
+			{
+				R2.Clear();
+				for (int j = i - age + 1; j <= i; j++)
+				{
+					R2.UnionWith(damage[j]);
+				}
+				assert(history.GetDamageSince(age, R) && R == R2);
+				assert(*history.GetDamageSince(age) == R2);
+			}
+			assert(history.GetDamageSince(0) == NULL && history.GetDamageSince(frameCount + 1) == NULL);
+		}
+		assert(history.GetDamageChange(0, R) && R.GetRegionType() == NULLREGION);
+		assert(history.GetDamageChange(2, R) && R == damage[4].Xor(damage[2]));
+		assert(!history.GetDamageChange(3, R));
+		history.Clear();
+		assert(history.GetFrameCount() == 0 && history.GetDamageSince(1) == NULL);
+		history.AddFrame(damage[0]);
+		assert(*history.GetDamageSince(1) == damage[0]);
+	}
+	//union and intersection of many regions at once match combining them one at a time
+	{
+		Region parts[6];
+		parts[0] = Region(0, 0, 20, 20);
+		parts[1] = Region(0, 0, 20, 20).Subtract(5, 5, 3, 3);
+		parts[2] = Region(2, 2, 30, 4).Union(2, 10, 30, 4);
+		parts[3] = Region(1, 0, 18, 18);
+		parts[4] = Region();
+		parts[5] = Region(10, 0, 4, 30).Xor(0, 12, 30, 4);
+		const Region* pParts[6];
+		for (int i = 0; i < 6; i++)
+		{
+			pParts[i] = &parts[i];
+		}
+		for (int first = 0; first < 6; first++)
+		{
+			for (int count = 0; first + count <= 6; count++)
+			{
+				R.Clear();
+				R2 = count > 0 ? parts[first] : Region();
+				for (int i = first; i < first + count; i++)
+				{
+					R.UnionWith(parts[i]);
+					R2.IntersectWith(parts[i]);
+				}
+				Region unionAll = Region::UnionAll(pParts + first, count);
+				Region intersectAll = Region::IntersectAll(pParts + first, count);
+				assert(unionAll == R && unionAll.GetBoundingBox() == R.GetBoundingBox());
+				assert(intersectAll == R2 && intersectAll.GetBoundingBox() == R2.GetBoundingBox());
+			}
+		}
+		//a rectangle covering everything else is the whole union
+		const Region* pCovered[3] = { &parts[1], &parts[0], &parts[3] };
+		assert(Region::UnionAll(pCovered, 3).GetRegionType() == SIMPLEREGION);
+	}
+	//accumulator: rectangles added from several threads at once, drained while they are still being added
+	{
+		RegionAccumulator accumulator;
+		const int threadCount = 4;
+		const int rectsPerThread = 1000;
+		vector<std::thread> threads;
+		for (int t = 0; t < threadCount; t++)
+		{
+			threads.push_back(std::thread([&accumulator, t]() {
+				for (int i = 0; i < rectsPerThread; i++)
+				{
+					RECT rect = { i * 3, t * 5, i * 3 + 2, t * 5 + 4 };
+					accumulator.Add(rect);
+				}
+			}));
+		}
+		R.Clear();
+		for (int i = 0; i < 10; i++)
+		{
+			accumulator.DrainInto(R);
+		}
+		for (int t = 0; t < threadCount; t++)
+		{
+			threads[t].join();
+		}
+		accumulator.DrainInto(R);
+		R2.Clear();
+		for (int t = 0; t < threadCount; t++)
+		{
+			for (int i = 0; i < rectsPerThread; i++)
+			{
+				R2.UnionWith(Region(i * 3, t * 5, 2, 4));
+			}
+		}
+		assert(R == R2);
+		//nothing is left after draining, and empty rectangles are ignored
+		Region empty;
+		accumulator.DrainInto(empty);
+		RECT emptyRect = { 5, 5, 5, 10 };
+		accumulator.Add(emptyRect);
+		accumulator.Add(Region(1, 1, 2, 2).Union(5, 5, 2, 2));
+		accumulator.DrainInto(empty);
+		assert(empty == Region(1, 1, 2, 2).Union(5, 5, 2, 2));
+	}
+	//accumulator: accumulators made after others are destroyed reuse their slots, without seeing their buffers
+	{
+		RegionAccumulator longLived;
+		longLived.Add(Region(0, 0, 1, 1));
+		for (int i = 0; i < 100; i++)
+		{
+			RegionAccumulator accumulator;
+			accumulator.Add(Region(i, 10, 1, 1));
+			std::thread([&accumulator, i]() { accumulator.Add(Region(i, 20, 1, 1)); }).join();
+			R.Clear();
+			accumulator.DrainInto(R);
+			assert(R == Region(i, 10, 1, 1).Union(i, 20, 1, 1));
+		}
+		R.Clear();
+		longLived.DrainInto(R);
+		assert(R == Region(0, 0, 1, 1));
+	}
+	//rectangle helpers are constexpr: checked at compile time
+	{
+		constexpr RECT outer = { 0, 0, 20, 20 };
+		constexpr RECT inner = { 5, 5, 10, 10 };
+		constexpr RECT right = { 20, 0, 30, 20 };
+		constexpr RECT below = { 0, 25, 20, 30 };
+		static_assert(RectCoversUpOther(outer, inner) && !RectCoversUpOther(inner, outer), "outer covers up inner");
+		static_assert(RectOverlaps(outer, inner) && !RectOverlaps(outer, right), "adjacent is not overlapping");
+		static_assert(RectEquals(outer, outer) && !RectEquals(outer, inner), "equal rectangles");
+		static_assert(RectIsEmpty(RECT{ 5, 5, 5, 10 }) && !RectIsEmpty(inner), "empty rectangles");
+		static_assert(RectUnionIsRect(outer, inner) && RectUnionIsRect(outer, right) && !RectUnionIsRect(outer, below) && !RectUnionIsRect(inner, right), "unions which are rectangles");
+		static_assert(RectEquals(RectUnion(outer, right), RECT{ 0, 0, 30, 20 }), "aligned rectangles merge");
+		constexpr RegionCoord16::Rect tile = { 0, 0, 16, 16 };
+		static_assert(RectEquals(RectUnion(tile, RegionCoord16::Rect{ 0, 16, 16, 32 }), RegionCoord16::Rect{ 0, 0, 16, 32 }), "works on BasicRect too");
+		//the same merge at run time
+		R = Region(outer);
+		R.UnionWith(right);
+		assert(R.GetRegionType() == SIMPLEREGION && R.GetBoundingBox() == RectUnion(outer, right));
+	}
+	//coordinate policies: 16-bit and 64-bit regions give the same results as Region for coordinates they all can hold
+	{
+		static_assert(sizeof(RegionCoord16::Rect) * 2 == sizeof(RECT), "16-bit rectangles are half the size");
+		typedef BasicRegion<RegionCoord16> Region16;
+		typedef BasicRegion<RegionCoord64> Region64;
+		srand(22);
+		for (int iteration = 0; iteration < 200; iteration++)
+		{
+			Region regions[2];
+			Region16 regions16[2];
+			Region64 regions64[2];
+			for (int r = 0; r < 2; r++)
+			{
+				int count = 1 + rand() % 12;
+				for (int i = 0; i < count; i++)
+				{
+					int x = rand() % 200 - 100, y = rand() % 200 - 100, w = 1 + rand() % 60, h = 1 + rand() % 60;
+					regions[r].UnionWith(x, y, w, h);
+					regions16[r].UnionWith(Region16((int16_t)x, (int16_t)y, (int16_t)w, (int16_t)h).GetBoundingBox());
+					regions64[r].UnionWith(Region64(x, y, w, h));
+				}
+				assert(SameRects(regions16[r], regions[r]) && SameRects(regions64[r], regions[r]));
+			}
+			assert(SameRects(regions16[0].Union(regions16[1]), regions[0].Union(regions[1])));
+			assert(SameRects(regions16[0].Intersect(regions16[1]), regions[0].Intersect(regions[1])));
+			assert(SameRects(regions16[0].Subtract(regions16[1]), regions[0].Subtract(regions[1])));
+			assert(SameRects(regions16[0].Xor(regions16[1]), regions[0].Xor(regions[1])));
+			assert(SameRects(regions64[0].Union(regions64[1]), regions[0].Union(regions[1])));
+			assert(SameRects(regions64[0].Intersect(regions64[1]), regions[0].Intersect(regions[1])));
+			assert(SameRects(regions64[0].Subtract(regions64[1]), regions[0].Subtract(regions[1])));
+			assert(SameRects(regions64[0].Xor(regions64[1]), regions[0].Xor(regions[1])));
+			int x = rand() % 200 - 100, y = rand() % 200 - 100;
+			assert(regions16[0].ContainsPoint((int16_t)x, (int16_t)y) == regions[0].ContainsPoint(x, y));
+			assert(regions64[0].ContainsPoint(x, y) == regions[0].ContainsPoint(x, y));
+			R = regions[0];
+			R.OffsetBy(7, -3);
+			regions16[0].OffsetBy(7, -3);
+			regions64[0].OffsetBy(7, -3);
+			assert(SameRects(regions16[0], R) && SameRects(regions64[0], R));
+			//building from an array of rectangles
+			vector<RECT> rects = regions[1].GetRegionRects();
+			vector<RegionCoord64::Rect> rects64;
+			for (size_t i = 0; i < rects.size(); i++)
+			{
+				RegionCoord64::Rect rect = { rects[i].left, rects[i].top, rects[i].right, rects[i].bottom };
+				rects64.push_back(rect);
+			}
+			std::reverse(rects64.begin(), rects64.end());
+			assert(rects64.empty() ? Region64(rects64.data(), 0) == Region64() : Region64(rects64.data(), rects64.size()) == regions64[1]);
+		}
+		//64-bit regions hold canvases past the end of 32-bit coordinates, where x + w would overflow an int
+		const int64_t giga = 3000000000LL;
+		Region64 canvas(giga, 0, giga, 10);
+		assert(canvas.GetBoundingBox().right == 2 * giga && canvas.GetArea() == 10 * giga);
+		canvas.UnionWith(Region64(-giga, 20, giga, 10));
+		assert(canvas.GetRegionType() == COMPLEXREGION && canvas.GetRectCount() == 2);
+		assert(canvas.ContainsPoint(giga + giga / 2, 5) && canvas.ContainsPoint(-1, 25) && !canvas.ContainsPoint(0, 5));
+		canvas.SubtractWith(Region64(-giga, 0, 3 * giga, 25));
+		assert(canvas == Region64(-giga, 25, giga, 5));
+		//edges past the end of the coordinate range are cut off, and rectangles moved entirely past it are left out
+		const int64_t maxCoordinate = INT64_MAX;
+		assert(Region64(maxCoordinate - 5, 0, 100, 10).GetBoundingBox().right == maxCoordinate);
+		Region64 moved = Region64(0, 0, 10, 10).Union(Region64(100, 20, 10, 10));
+		moved.OffsetBy(maxCoordinate - 105, 0);
+		assert(moved == Region64(maxCoordinate - 105, 0, 10, 10).Union(Region64(maxCoordinate - 5, 20, 5, 10)));
+		moved.OffsetBy(maxCoordinate, 0);
+		assert(moved.GetRegionType() == NULLREGION);
+		assert(Region64(INT64_MIN, INT64_MIN, INT64_MAX, INT64_MAX).GetArea() == INT64_MAX);
+		//16-bit regions cut off at 32767
+		Region16 tile(30000, 0, 10000, 10);
+		assert(tile.GetBoundingBox().right == 32767 && tile.GetArea() == 27670);
+		tile.OffsetBy(-30000, 0);
+		assert(tile == Region16(0, 0, 2767, 10));
+	}
+	//serialize: regions come back the same from the compact format, and data which is cut short or too long is rejected
+	{
+		Region shapes[5];
+		shapes[1] = Region(-5, -7, 3, 2);
+		shapes[2] = Region(0, 0, 100, 50).Subtract(10, 10, 5, 5).Union(-300, 60, 1000, 3);
+		shapes[3] = Region(0, 0, 20, 20).Xor(5, 5, 20, 20).Union(200000, -200000, 5, 5);
+		RECT huge = { -2147483647 - 1, -2147483647 - 1, 2147483647, 2147483647 };
+		shapes[4] = Region(huge).Subtract(0, 0, 1, 1);
+		for (int i = 0; i < 5; i++)
+		{
+			vector<byte> bytes;
+			shapes[i].Serialize(bytes);
+			assert(bytes.size() == shapes[i].GetSerializedSize());
+			R = Region(1, 1, 1, 1);
+			assert(R.Deserialize(bytes.data(), bytes.size()));
+			assert(R == shapes[i] && R.GetBoundingBox() == shapes[i].GetBoundingBox() && R.GetRegionType() == shapes[i].GetRegionType());
+			for (size_t size = 0; size < bytes.size(); size++)
+			{
+				assert(!R.Deserialize(bytes.data(), size));
+			}
+			bytes.push_back(0);
+			assert(!R.Deserialize(bytes.data(), bytes.size()));
+			assert(R == shapes[i]);
+		}
+		//touching bands with the same spans are joined, even though Serialize never writes them
+		const byte twoBands[] = { 2, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0 };
+		assert(R.Deserialize(twoBands, sizeof(twoBands)) && R == Region(0, 0, 1, 2) && R.GetRegionType() == SIMPLEREGION);
+		const byte repeatedBand[] = { 2, 0, 0, 1, 0, 0, 0, 0, 0 };
+		assert(R.Deserialize(repeatedBand, sizeof(repeatedBand)) && R == Region(0, 0, 1, 2) && R.GetRegionType() == SIMPLEREGION);
+		const byte repeatedFirstBand[] = { 1, 0, 0, 0 };
+		assert(!R.Deserialize(repeatedFirstBand, sizeof(repeatedFirstBand)));
+		//a few kilobytes of 2048 spans repeated in 2049 bands would be millions of rectangles, which is over the limit
+		vector<byte> hostile;
+		const int hostileSpans = 2048;
+		const int hostileBands = 2049;
+		hostile.push_back((byte)(0x80 | (hostileBands & 0x7F)));
+		hostile.push_back((byte)(hostileBands >> 7));
+		hostile.push_back(0);
+		hostile.push_back(0);
+		hostile.push_back((byte)(0x80 | (hostileSpans & 0x7F)));
+		hostile.push_back((byte)(hostileSpans >> 7));
+		for (int i = 0; i < hostileSpans * 2; i++)
+		{
+			hostile.push_back(0);
+		}
+		for (int i = 1; i < hostileBands; i++)
+		{
+			hostile.push_back(1);
+			hostile.push_back(0);
+			hostile.push_back(0);
+		}
+		assert(hostile.size() < 11000);
+		R = Region(1, 1, 1, 1);
+		assert(!R.Deserialize(hostile.data(), hostile.size()));
+		assert(R == Region(1, 1, 1, 1));
+		//a caller's limit below the rectangle count of the region fails
+		vector<byte> bytes;
+		shapes[2].Serialize(bytes);
+		size_t shapeRects = shapes[2].GetRectCount();
+		assert(R.Deserialize(bytes.data(), bytes.size(), shapeRects) && R == shapes[2]);
+		assert(!R.Deserialize(bytes.data(), bytes.size(), shapeRects - 1) && R == shapes[2]);
+		//a much smaller format than RGNDATA for a grid of squares (every band after the first repeats the first one)
+		vector<RECT> squares;
+		for (int y = 0; y < 20; y++)
+		{
+			for (int x = 0; x < 20; x++)
+			{
+				RECT square = { x * 8, y * 12, x * 8 + 6, y * 12 + 10 };
+				squares.push_back(square);
+			}
+		}
+		R = Region(squares.data(), squares.size());
+		assert(R.GetSerializedSize() * 8 < R.GetRegionData().size());
+	}
+	//rectangles near the end of the coordinate range: edges are cut off instead of wrapping around
+	{
+		Region R(INT_MAX - 5, 0, 100, 10);
+		assert(R.GetRegionType() == SIMPLEREGION);
+		int x, y, w, h;
+		R.GetBoundingBox(x, y, w, h);
+		assert(x == INT_MAX - 5 && w == 5 && h == 10);
+		R.UnionWith(INT_MAX - 20, 5, 1000, 10);
+		R.GetBoundingBox(x, y, w, h);
+		assert(x == INT_MAX - 20 && w == 20 && h == 15);
+		//a huge rectangle, wider than the largest int
+		RECT huge = { INT_MIN, INT_MIN, INT_MAX, INT_MAX };
+		R = Region(huge);
+		R.GetBoundingBox(x, y, w, h);
+		assert(x == INT_MIN && w == INT_MAX && h == INT_MAX);
+		//its area doesn't fit in an int64_t either
+		assert(R.GetArea() == INT64_MAX);
+		assert(R.Subtract(0, 0, 1, 1).GetArea() == INT64_MAX);
+		R.IntersectWith(huge);
+		assert(R.GetRegionType() == SIMPLEREGION);
+		R.IntersectWith(0, 0, INT_MAX, INT_MAX);
+		assert(R == Region(0, 0, INT_MAX, INT_MAX));
+		R.SubtractWith(10, 10, INT_MAX, INT_MAX);
+		assert(R.GetRegionType() == COMPLEXREGION);
+		R.XorWith(0, 0, INT_MAX, INT_MAX);
+		assert(R == Region(10, 10, INT_MAX, INT_MAX));
+		//offsetting past the end of the coordinate range cuts the region off there
+		R = Region(INT_MAX - 5, 0, 5, 10);
+		R.OffsetBy(3, 0);
+		assert(R == Region(INT_MAX - 2, 0, 2, 10));
+		R.OffsetBy(10, 0);
+		assert(R.GetRegionType() == NULLREGION);
+		R = Region(INT_MAX - 30, 0, 20, 10);
+		R.UnionWith(INT_MAX - 5, 20, 5, 10);
+		R.OffsetBy(10, 0);
+		assert(R == Region(INT_MAX - 20, 0, 20, 10));
+		//bands which become the same once cut off are joined
+		R = Region(INT_MAX - 30, 0, 10, 10);
+		R.UnionWith(INT_MAX - 30, 10, 20, 10);
+		R.OffsetBy(25, 0);
+		assert(R == Region(INT_MAX - 5, 0, 5, 20) && R.GetRegionType() == SIMPLEREGION);
+		R = Region(0, INT_MIN, 10, 10);
+		R.UnionWith(0, INT_MIN + 20, 20, 10);
+		R.OffsetBy(0, -15);
+		assert(R == Region(0, INT_MIN + 5, 20, 10));
+		assert(RegionSummaryOkay(R));
+	}
+	//fixed regions: same results as Region while they fit, then fail or become a bounding box
+	{
+		FixedRegion<64> F;
+		Region R;
+		const RECT steps[] = { { 0, 0, 40, 40 }, { 20, 20, 60, 60 }, { 10, 10, 30, 30 }, { 5, 50, 70, 55 }, { 0, 0, 100, 45 } };
+		for (int i = 0; i < 5; i++)
+		{
+			switch (i % 4)
+			{
+			case 0: assert(F.UnionWith(steps[i])); R.UnionWith(steps[i]); break;
+			case 1: assert(F.XorWith(steps[i])); R.XorWith(steps[i]); break;
+			case 2: assert(F.SubtractWith(steps[i])); R.SubtractWith(steps[i]); break;
+			case 3: assert(F.UnionWith(steps[i])); R.UnionWith(steps[i]); break;
+			}
+			assert(F.ToRegion() == R);
+			size_t count;
+			const RECT* pRects = R.GetRegionRects(count);
+			assert(F.GetRectCount() == count && 0 == memcmp(F.GetRects(), pRects, sizeof(RECT) * count));
+			assert(F.GetBoundingBox() == R.GetBoundingBox());
+		}
+		assert(F.ContainsPoint(35, 35) && F.ContainsPoint(50, 48) && !F.ContainsPoint(10, 48) && !F.ContainsPoint(80, 52));
+		RECT clip = { 12, 12, 58, 58 };
+		FixedRegion<8> G(clip);
+		assert(G.IntersectWith(F));
+		R.IntersectWith(clip);
+		assert(G.ToRegion() == R);
+		assert(F.IntersectWith(R) && F == G);
+		assert(F.SubtractWith(R) && F.IsEmpty());
+		//three separate squares don't fit in two rectangles
+		const RECT squares[] = { { 0, 0, 10, 10 }, { 20, 0, 30, 10 }, { 40, 0, 50, 10 } };
+		FixedRegion<2> Small(squares[0]);
+		assert(Small.UnionWith(squares[1]));
+		FixedRegion<2> Before = Small;
+		assert(!Small.UnionWith(squares[2]));
+		assert(Small == Before);
+		FixedRegion<2, FIXED_REGION_BOUNDING_BOX> Box(squares[0]);
+		assert(Box.UnionWith(squares[1]));
+		assert(!Box.UnionWith(squares[2]));
+		RECT expectedBox = { 0, 0, 50, 10 };
+		assert(Box.GetRectCount() == 1 && Box.GetBoundingBox() == expectedBox);
+		//overflowing an empty region gives the box around the other region only, not a box stretched out to the origin
+		Region farSquares(squares, 3);
+		farSquares.OffsetBy(1000, 2000);
+		RECT farBox = { 1000, 2000, 1050, 2010 };
+		FixedRegion<2, FIXED_REGION_BOUNDING_BOX> Empty;
+		assert(!Empty.UnionWith(farSquares));
+		assert(Empty.GetRectCount() == 1 && Empty.GetBoundingBox() == farBox && Empty.GetRects()[0] == farBox);
+		Empty.Clear();
+		assert(!Empty.XorWith(farSquares));
+		assert(Empty.GetRectCount() == 1 && Empty.GetBoundingBox() == farBox);
+	}
+	//area, rectangle count, band count and hash stay up to date as regions change
+	{
+		Region R;
+		assert(RegionSummaryOkay(R));
+		R.UnionWith(0, 0, 10, 10);
+		assert(RegionSummaryOkay(R));
+		assert(R.GetArea() == 100);
+		R.UnionWith(20, 5, 10, 10);
+		assert(RegionSummaryOkay(R));
+		assert(R.GetArea() == 200 && R.GetRectCount() == 4 && R.GetBandCount() == 3);
+		R.SubtractWith(5, 0, 30, 2);
+		assert(RegionSummaryOkay(R));
+		R.OffsetBy(7, -3);
+		assert(RegionSummaryOkay(R));
+		R.ScaleBy(2, 1, REGION_ROUND_OUTWARD);
+		assert(RegionSummaryOkay(R));
+		Region S(R);
+		assert(RegionSummaryOkay(S));
+		assert(S == R && S.GetHash() == R.GetHash());
+		vector<byte> bytes;
+		R.Serialize(bytes);
+		Region D;
+		assert(D.Deserialize(bytes.data(), bytes.size()));
+		assert(RegionSummaryOkay(D));
+		assert(D == R);
+		//the same area built in a different order gives the same hash
+		Region T(50, 50, 5, 5);
+		T.XorWith(R);
+		T.XorWith(50, 50, 5, 5);
+		assert(T == R && T.GetHash() == R.GetHash());
+		//regions with the same rectangle count and bounding box, which differ inside
+		Region A(0, 0, 30, 10);
+		A.SubtractWith(10, 0, 5, 5);
+		Region B(0, 0, 30, 10);
+		B.SubtractWith(12, 0, 5, 5);
+		assert(A.GetRectCount() == B.GetRectCount() && A.GetHash() != B.GetHash() && A != B);
+		A.Swap(S);
+		assert(RegionSummaryOkay(A));
+		assert(RegionSummaryOkay(S));
+	}
+	//op cache: repeated operations are lookups, results share their rectangles, and the cache stays under its size
+	{
+		RegionOpCache cache(1000);
+		//a window with holes cut out by its siblings, clipped by its parent
+		Region window(0, 0, 200, 200);
+		for (int i = 0; i < 8; i++)
+		{
+			window.SubtractWith(i * 25, i * 20, 10, 10);
+		}
+		Region clip(5, 5, 150, 150);
+		Region visible1 = cache.Intersect(window, clip);
+		assert(cache.GetMissCount() == 1 && cache.GetHitCount() == 0);
+		assert(visible1 == window.Intersect(clip));
+		Region visible2 = cache.Intersect(window, clip);
+		assert(cache.GetHitCount() == 1 && visible2 == visible1);
+		size_t count1, count2;
+		assert(visible1.GetRegionRects(count1) == visible2.GetRegionRects(count2));
+		//the operands are compared, not just their hashes, and the operation is part of the key
+		assert(cache.Subtract(window, clip) == window.Subtract(clip));
+		assert(cache.Union(window, clip) == window.Union(clip));
+		assert(cache.Xor(window, clip) == window.Xor(clip));
+		assert(cache.Intersect(clip, window) == visible1);
+		assert(cache.GetMissCount() == 5 && cache.GetEntryCount() == 5);
+		//an equal region built some other way can share the cached rectangles
+		vector<RECT> rects = visible1.GetRegionRects();
+		Region rebuilt(rects.data(), rects.size());
+		assert(rebuilt.GetRegionRects(count2) != visible1.GetRegionRects(count1));
+		assert(cache.Intern(rebuilt));
+		assert(rebuilt.GetRegionRects(count2) == visible1.GetRegionRects(count1) && rebuilt == visible1);
+		Region elsewhere(window);
+		elsewhere.OffsetBy(1000, 0);
+		assert(!cache.Intern(elsewhere));
+		//results made while an arena is current stay valid after the arena is reset
+		RegionArena arena;
+		{
+			RegionArenaScope scope(arena);
+			Region moved(window);
+			moved.OffsetBy(3, 4);
+			Region result = cache.Subtract(moved, clip);
+			assert(result == moved.Subtract(clip));
+		}
+		arena.Reset();
+		Region moved(window);
+		moved.OffsetBy(3, 4);
+		size_t hits = cache.GetHitCount();
+		assert(cache.Subtract(moved, clip) == moved.Subtract(clip) && cache.GetHitCount() == hits + 1);
+		//old results are forgotten to stay under the size
+		for (int i = 0; i < 50; i++)
+		{
+			Region shifted(window);
+			shifted.OffsetBy(i, 0);
+			assert(cache.Intersect(shifted, clip) == shifted.Intersect(clip));
+			assert(cache.GetRectCount() <= 1000);
+		}
+		assert(cache.GetEntryCount() < 50);
+		cache.Clear();
+		assert(cache.GetEntryCount() == 0 && cache.GetRectCount() == 0);
+	}
+#if REGION_USE_THREADS
+	//parallel combine: regions big enough to be combined in stripes on several threads give the same results as on one thread
+	{
+		RegionThreadPool& pool = RegionThreadPool::GetShared();
+		int defaultWorkerCount = pool.GetThreadCount() - 1;
+		//two grids of squares, the second one shifted and with uneven rows
+		const int n = 256;
+		vector<RECT> squares;
+		vector<RECT> shifted;
+		for (int y = 0; y < n; y++)
+		{
+			for (int x = 0; x < n; x++)
+			{
+				RECT square = { x * 4, y * 4, x * 4 + 3, y * 4 + 3 };
+				squares.push_back(square);
+				RECT other = { x * 4 + 2, y * 4 + 1 + x % 3, x * 4 + 5, y * 4 + 3 + x % 3 };
+				shifted.push_back(other);
+			}
+		}
+		Region A, B;
+		A.UnionWith(&squares[0], squares.size());
+		B.UnionWith(&shifted[0], shifted.size());
+		RECT all = { 0, 0, n * 4, n * 4 };
+		Region expected[5];
+		for (int pass = 0; pass < 2; pass++)
+		{
+			pool.SetWorkerCount(pass == 0 ? 0 : 3);
+			Region results[5] = { A.Union(B), A.Intersect(B), A.Subtract(B), A.Xor(B), Region(all).Subtract(A) };
+			for (int i = 0; i < 5; i++)
+			{
+				if (pass == 0)
+				{
+					expected[i] = results[i];
+				}
+				else
+				{
+					assert(results[i] == expected[i]);
+					assert(results[i].GetBoundingBox() == expected[i].GetBoundingBox());
+				}
+			}
+			//the bands of the mesh around the squares go across the stripes, and must be joined back into a single rectangle
+			R = results[4];
+			R.UnionWith(A);
+			assert(R.GetRegionType() == SIMPLEREGION && R.GetBoundingBox() == all);
+			assert(A.Xor(A).GetRegionType() == NULLREGION);
+		}
+		//an exception thrown by a task on any thread comes out of ParallelFor on the calling thread, and the pool keeps working
+		std::atomic<int> calls(0);
+		bool caught = false;
+		try
+		{
+			pool.ParallelFor(100, [&](size_t i) {
+				calls++;
+				if (i == 37)
+				{
+					throw std::runtime_error("task failed");
+				}
+			});
+		}
+		catch (const std::runtime_error&)
+		{
+			caught = true;
+		}
+		assert(caught && calls <= 100);
+		calls = 0;
+		pool.ParallelFor(100, [&](size_t) { calls++; });
+		assert(calls == 100);
+		pool.SetWorkerCount(defaultWorkerCount);
+	}
+#endif
 }